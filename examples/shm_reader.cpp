@@ -0,0 +1,140 @@
+// Reads frames from the shared memory ring vrviz publishes with --shm, the
+// way an overlay in another process would, and reports how long each frame
+// took to arrive. Frames are looked at where they are, without copying.
+//
+//   vrviz --headless 3000 --auto-increment --shm /vrviz &
+//   shm_reader /vrviz
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "shm_ring.h"
+
+static long long
+nanoseconds_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline void
+spin_pause()
+{
+#if defined(__SSE2__)
+	_mm_pause();
+#endif
+}
+
+// Wait for vrviz to make the ring, then map it
+static shm_ring_header*
+open_ring(const char *name, double timeout_seconds)
+{
+	const long long give_up = nanoseconds_now() +
+		(long long)(timeout_seconds * 1e9);
+	int fd;
+	while ((fd = shm_open(name, O_RDONLY, 0)) < 0) {
+		if (nanoseconds_now() > give_up)
+			return 0;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	struct stat info;
+	void *memory = MAP_FAILED;
+	if (!fstat(fd, &info) && (size_t)info.st_size >= SHM_RING_HEADER_SIZE)
+		memory = mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED)
+		return 0;
+	shm_ring_header *header = (shm_ring_header*)memory;
+	if (header->magic != SHM_RING_MAGIC ||
+		header->version != SHM_RING_VERSION) {
+		fprintf(stderr, "%s isn't a vrviz frame ring\n", name);
+		return 0;
+	}
+	return header;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *name = argc > 1 ? argv[1] : "/vrviz";
+	const long long max_frames = argc > 2 ? atoll(argv[2]) : 0;
+	shm_ring_header *header = open_ring(name, 10.0);
+	if (!header) {
+		fprintf(stderr, "couldn't open %s\n", name);
+		return 1;
+	}
+	printf("reading %dx%d frames from %s\n", header->width, header->height,
+		name);
+
+	std::vector<double> latencies;
+	long long torn = 0;
+	long long skipped = 0;
+	long long lit_pixels = 0;
+	uint64_t last_seen = header->published.load(std::memory_order_acquire);
+	int64_t last_frame = -1;
+	int32_t last_digits[SHM_RING_MAX_DIGITS] = {0};
+	while (!max_frames || (long long)latencies.size() < max_frames) {
+		// Spin on the published count, no system calls
+		const uint64_t published =
+			header->published.load(std::memory_order_acquire);
+		if (published == last_seen) {
+			if (header->closed.load(std::memory_order_acquire))
+				break;
+			spin_pause();
+			continue;
+		}
+		const long long now = nanoseconds_now();
+		skipped += published - last_seen - 1;
+		last_seen = published;
+		const shm_ring_slot *slot = shm_ring_get_slot(header, published - 1);
+		const uint64_t state = slot->state.load(std::memory_order_acquire);
+		if (state != 2 * published) {
+			++torn;
+			continue;
+		}
+		// Use the frame in place: count the lit pixels down the middle
+		const unsigned char *pixels = shm_ring_get_pixels(slot, header);
+		const int x = header->width / 2;
+		for (int y = 0 ; y < header->height ; ++y)
+			lit_pixels += pixels[(y * header->width + x) * 3] > 128;
+		const int64_t frame = slot->frame;
+		const int64_t published_at = slot->publish_nanoseconds;
+		int32_t digits[SHM_RING_MAX_DIGITS];
+		std::copy(slot->digits, slot->digits + SHM_RING_MAX_DIGITS, digits);
+		// If it changed while we were reading, it was overwritten
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot->state.load(std::memory_order_relaxed) != state) {
+			++torn;
+			continue;
+		}
+		latencies.push_back((now - published_at) / 1e3);
+		last_frame = frame;
+		std::copy(digits, digits + SHM_RING_MAX_DIGITS, last_digits);
+	}
+	if (latencies.empty()) {
+		printf("no frames\n");
+		return 1;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	const size_t n = latencies.size();
+	printf("%zu frames read, %lld skipped, %lld overwritten while reading, "
+		"%lld lit pixels seen\n", n, skipped, torn, lit_pixels);
+	printf("publish to read latency: min %.1f us, median %.1f us, "
+		"99%% %.1f us, max %.1f us\n", latencies[0], latencies[n / 2],
+		latencies[std::min(n - 1, n * 99 / 100)], latencies[n - 1]);
+	printf("last frame %lld, score ", (long long)last_frame);
+	for (int i = 0 ; i < header->num_digits ; ++i)
+		printf("%d", last_digits[i]);
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,18 @@
+#version 110
+
+// Same colours as line.frag, with the digit coming from the instance
+varying float shape;
+
+void main()
+{
+	int digit = int(shape + 0.5);
+	vec3 color;
+	if (digit <= 2)
+		color = vec3(float(2-digit)*0.5, float(digit)*0.5, 1.0);
+	else if (digit <= 5)
+		color = vec3(1.0, float(5-digit)*0.5, float(digit-3)*0.5);
+	else if (digit <= 8)
+		color = vec3(float(digit-6)*0.5, float(8-digit)*0.5, 1.0);
+
+	gl_FragColor = vec4(color, 1.0);
+}
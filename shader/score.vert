@@ -0,0 +1,54 @@
+#version 110
+
+// Draws every digit of a score in one instanced draw. Each instance is one
+// digit, and fetches its shape's lines from a texture. Must animate the
+// same way as line.vert.
+
+// Set once
+uniform float aspect;
+// One row per shape, one texel per line holding both ends as x0,y0,x1,y1
+uniform sampler2D segments;
+uniform vec2 segments_size;
+// Set every frame
+uniform float frame;
+
+// Per vertex: which line (x) and which end of it (y)
+attribute vec2 corner;
+// Per instance
+attribute float index;
+attribute float digit;
+
+varying float shape;
+
+#define PI 3.14159265359
+
+void main()
+{
+	vec4 segment = texture2DLod(segments,
+		vec2((corner.x + 0.5) / segments_size.x,
+			(digit + 0.5) / segments_size.y), 0.0);
+	float x = corner.y < 0.5 ? segment.x : segment.z;
+	float y = corner.y < 0.5 ? segment.y : segment.w;
+
+	const float rotate_interval = 70.0;
+	float theta_offset = index * 0.1;
+	float theta = (frame / rotate_interval - theta_offset) * PI;
+
+	const float orbit_interval = 200.0;
+	const float orbit_x = 0.8;
+	const float orbit_y = 0.6;
+	float phi_offset = -index * 0.15;
+	float phi = (frame / orbit_interval - phi_offset) * PI;
+	vec4 offset = vec4( orbit_x * cos(phi), orbit_y * sin(phi), 0.0, 0.0 );
+
+	float size = 0.05 + ((sin(phi)+1.0)*0.015);
+
+	gl_Position =
+		vec4(
+			(x*cos(theta) + y*sin(theta)) * size,
+			(-x*sin(theta) + y*cos(theta)) * size * aspect,
+			0.0, 1.0)
+		+
+		offset;
+	shape = digit;
+}
@@ -0,0 +1,12 @@
+#version 110
+
+// Set once
+uniform sampler2D fontTexture;
+
+varying vec2 UV;
+varying vec4 Color;
+
+void main()
+{
+	gl_FragColor = Color * texture2D(fontTexture, UV);
+}
@@ -0,0 +1,18 @@
+#version 110
+
+// Set every frame, to go from pixels to clip space
+uniform vec2 scale;
+
+attribute vec2 position;
+attribute vec2 uv;
+attribute vec4 color;
+
+varying vec2 UV;
+varying vec4 Color;
+
+void main()
+{
+	gl_Position = vec4(position * scale + vec2(-1.0, 1.0), 0.0, 1.0);
+	UV = uv;
+	Color = color;
+}
@@ -0,0 +1,50 @@
+#version 110
+
+// Draws a whole wall of scores as one line list, built once per list of
+// scores. Each score animates the same way as line.vert, ahead by its own
+// phase, in its own cell of the wall.
+
+// Set once
+uniform float aspect;		// of one cell
+uniform vec2 cell_scale;	// half a cell's width and height, in clip space
+// Set every frame
+uniform float frame;
+
+// Per vertex
+attribute vec2 point;		// on the digit's shape
+attribute vec3 glyph;		// digit index, digit and phase in frames
+attribute vec2 cell;		// centre of the score's cell, in clip space
+
+varying float shape;
+
+#define PI 3.14159265359
+
+void main()
+{
+	float index = glyph.x;
+	float time = frame + glyph.z;
+	float x = point.x;
+	float y = point.y;
+
+	const float rotate_interval = 70.0;
+	float theta_offset = index * 0.1;
+	float theta = (time / rotate_interval - theta_offset) * PI;
+
+	const float orbit_interval = 200.0;
+	const float orbit_x = 0.8;
+	const float orbit_y = 0.6;
+	float phi_offset = -index * 0.15;
+	float phi = (time / orbit_interval - phi_offset) * PI;
+	vec2 offset = vec2( orbit_x * cos(phi), orbit_y * sin(phi) );
+
+	float size = 0.05 + ((sin(phi)+1.0)*0.015);
+
+	vec2 position =
+		vec2(
+			(x*cos(theta) + y*sin(theta)) * size,
+			(-x*sin(theta) + y*cos(theta)) * size * aspect)
+		+
+		offset;
+	gl_Position = vec4(cell + position * cell_scale, 0.0, 1.0);
+	shape = glyph.y;
+}
@@ -0,0 +1,965 @@
+// glew
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <float.h>
+#include <functional>
+#include <iostream>
+#include <math.h>
+#include <random>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "bench.h"
+#include "decoder.h"
+#include "farm.h"
+#include "font_atlas.h"
+#include "headless.h"
+#include "imgui.h"
+#include "line_transform.h"
+#include "packed_score.h"
+#include "raster.h"
+#include "render.h"
+#include "render_server.h"
+#include "score.h"
+#include "shader.h"
+#include "shape_library.h"
+#include "shapes.h"
+#include "sim_clock.h"
+#include "startup_cache.h"
+#include "time_histogram.h"
+#include "ui_render.h"
+#include "wall.h"
+
+// The game runs at 60 frames per second
+static const double REAL_TIME_FPS = 60.0;
+
+// One measurement, by a name that stays the same between releases so they
+// can be compared
+struct bench_result {
+	std::string name;
+	double value;
+	const char *unit;
+};
+
+static std::vector<bench_result> results;
+// What the GL benchmarks ran on, if any did
+static std::string gl_renderer;
+
+static void
+record(const std::string& name, double value, const char *unit)
+{
+	bench_result result = {name, value, unit};
+	results.push_back(result);
+}
+
+static void
+note_gl_renderer()
+{
+	gl_renderer = (const char*)glGetString(GL_RENDERER);
+}
+
+// Call "body" until at least "min_seconds" have passed. Returns the number of
+// calls per second.
+static double
+calls_per_second(const std::function<void()>& body, double min_seconds = 0.5)
+{
+	const auto start = std::chrono::steady_clock::now();
+	long long calls = 0;
+	double seconds = 0.0;
+	do {
+		body();
+		++calls;
+		seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	} while (seconds < min_seconds);
+	return calls / seconds;
+}
+
+// Frames of random scores at random points in the animation
+struct sample_frames {
+	int width;
+	int height;
+	std::vector<unsigned char> pixels;
+	std::vector<int> digits;
+	std::vector<int> frames;
+};
+
+static void
+make_sample_frames(sample_frames& samples, int count, int width, int height)
+{
+	std::mt19937 rng(1234);
+	cpu_rasterizer rasterizer;
+	init_cpu_rasterizer(rasterizer, width, height, 0);
+	const int frame_size = width * height * 3;
+	samples.width = width;
+	samples.height = height;
+	samples.pixels.resize(count * frame_size);
+	samples.digits.resize(count * NUM_DIGITS);
+	samples.frames.resize(count);
+	for (int i = 0 ; i < count ; ++i) {
+		int *digits = &samples.digits[i * NUM_DIGITS];
+		for (int j = 0 ; j < NUM_DIGITS ; ++j)
+			digits[j] = rng() % NUM_SHAPES;
+		samples.frames[i] = rng() % ANIMATION_PERIOD;
+		rasterize_score(rasterizer, digits, NUM_DIGITS, samples.frames[i],
+			&samples.pixels[i * frame_size]);
+	}
+}
+
+static void
+bench_decode()
+{
+	const int count = 256;
+	sample_frames samples;
+	make_sample_frames(samples, count, 300, 150);
+	score_decoder decoder;
+	init_score_decoder(decoder, samples.width, samples.height);
+	const int frame_size = samples.width * samples.height * 3;
+
+	for (int estimate = 0 ; estimate < 2 ; ++estimate) {
+		int correct = 0;
+		for (int i = 0 ; i < count ; ++i) {
+			decode_result result;
+			decode_score(decoder, &samples.pixels[i * frame_size],
+				estimate ? -1 : samples.frames[i], result);
+			if (!memcmp(result.digits, &samples.digits[i * NUM_DIGITS],
+				sizeof(result.digits)))
+				++correct;
+		}
+		int next = 0;
+		const double fps = calls_per_second([&]{
+			decode_result result;
+			decode_score(decoder, &samples.pixels[next * frame_size],
+				estimate ? -1 : samples.frames[next], result);
+			next = (next + 1) % count;
+		});
+		std::cout << "decode (" << (estimate ? "estimated" : "known")
+			<< " frame): " << fps << " frames/sec, "
+			<< fps / REAL_TIME_FPS << "x real time, "
+			<< 100.0 * correct / count << "% of scores right\n";
+		const std::string name = estimate ? "decode.estimated_frame" :
+			"decode.known_frame";
+		record(name, 1000.0 / fps, "ms");
+		record(name + ".right", 100.0 * correct / count, "%");
+	}
+}
+
+// How the offline frame farm scales with threads, throwing frames away
+static void
+bench_farm(int threads)
+{
+	const int most_threads = threads > 0 ? threads :
+		std::max((int)std::thread::hardware_concurrency(), 1);
+	farm_job job = farm_job();
+	job.auto_increment = true;
+	job.num_frames = 3000;
+	job.width = 300;
+	job.height = 150;
+	double one_thread_rate = 0.0;
+	for (int count = 1 ; count <= most_threads ;
+		count = count < most_threads ? std::min(count * 2, most_threads)
+			: count + 1) {
+		job.threads = count;
+		null_sink sink;
+		farm_stats stats;
+		std::string errors;
+		run_farm(job, sink, stats, errors);
+		const double rate = stats.frames / stats.seconds;
+		if (count == 1)
+			one_thread_rate = rate;
+		std::cout << "farm (" << count << " threads): " << rate
+			<< " frames/sec, " << rate / one_thread_rate << "x one thread, "
+			<< rate / REAL_TIME_FPS << "x real time\n";
+		record("farm.threads_" + std::to_string(count), rate, "frames/s");
+	}
+}
+
+// Vertices per second through the line.vert transform on the CPU, a vertex
+// at a time and batched over a whole animation
+static void
+bench_transform()
+{
+	const int digits[NUM_DIGITS] = {0, 1, 2, 3, 4, 5, 8};
+	const float aspect = 2.f;
+	shape_segments shapes;
+	build_shape_segments(shapes);
+	int vertices_per_frame = 0;
+	for (int digit : digits)
+		vertices_per_frame += shapes.segment_counts[digit] * 2;
+
+	float sink = 0.f;
+	const double scalar_rate = calls_per_second([&]{
+		for (int frame = 0 ; frame < ANIMATION_PERIOD ; ++frame) {
+			for (int i = 0 ; i < NUM_DIGITS ; ++i) {
+				const digit_transform t =
+					get_digit_transform(i, (float)frame);
+				const int first = shapes.first_segment[digits[i]];
+				for (int j = 0 ; j < shapes.segment_counts[digits[i]] ; ++j) {
+					float x0, y0, x1, y1;
+					apply_digit_transform(t, aspect, shapes.x0[first + j],
+						shapes.y0[first + j], x0, y0);
+					apply_digit_transform(t, aspect, shapes.x1[first + j],
+						shapes.y1[first + j], x1, y1);
+					sink += x0 + y0 + x1 + y1;
+				}
+			}
+		}
+	}) * ANIMATION_PERIOD * vertices_per_frame;
+	score_segments out;
+	const double batch_rate = calls_per_second([&]{
+		transform_score(shapes, digits, NUM_DIGITS, 0, ANIMATION_PERIOD,
+			aspect, out);
+		sink += out.x0[0];
+	}) * ANIMATION_PERIOD * vertices_per_frame;
+	std::cout << "transform: " << scalar_rate / 1e6
+		<< "M vertices/sec a vertex at a time, " << batch_rate / 1e6
+		<< "M vertices/sec batched (" << batch_rate / scalar_rate << "x)"
+		<< (sink == 0.f ? " " : "") << "\n";
+	record("transform.scalar", 1e9 / scalar_rate, "ns/vertex");
+	record("transform.batched", 1e9 / batch_rate, "ns/vertex");
+}
+
+// Step an int array score and a packed one on together, checking they
+// agree, then time each the way the viewer uses them: increment and clamp
+template <int Digits>
+static void
+bench_score_digits()
+{
+	typedef packed_score<Digits, NUM_SHAPES> packed;
+	const int steps = 200000;
+	int digits[Digits] = {};
+	packed score = packed();
+	bool agree = true;
+	for (int i = 0 ; i < steps && agree ; ++i) {
+		increment_score(digits, Digits);
+		for (int& digit : digits)
+			digit = std::max(std::min(digit, NUM_SHAPES-1), 0);
+		score.increment();
+		score.clamp();
+		int unpacked[Digits];
+		score.to_digits(unpacked);
+		agree = !memcmp(unpacked, digits, sizeof(digits));
+	}
+
+	const double int_rate = calls_per_second([&]{
+		for (int i = 0 ; i < 1000 ; ++i) {
+			increment_score(digits, Digits);
+			for (int& digit : digits)
+				digit = std::max(std::min(digit, NUM_SHAPES-1), 0);
+		}
+	}) * 1000;
+	const double packed_rate = calls_per_second([&]{
+		for (int i = 0 ; i < 1000 ; ++i) {
+			score.increment();
+			score.clamp();
+		}
+	}) * 1000;
+	std::cout << "score (" << Digits << " digits): increment and clamp "
+		<< int_rate / 1e6 << "M/sec as ints, " << packed_rate / 1e6
+		<< "M/sec packed (" << packed_rate / int_rate << "x), "
+		<< (agree ? "same scores" : "SCORES DIFFER") << " over " << steps
+		<< " steps\n";
+	const std::string name = "score.digits_" + std::to_string(Digits);
+	record(name + ".increment_score", 1e9 / int_rate, "ns");
+	record(name + ".packed", 1e9 / packed_rate, "ns");
+	record(name + ".agree", agree, "bool");
+}
+
+static void
+bench_score()
+{
+	bench_score_digits<NUM_DIGITS>();
+	bench_score_digits<16>();
+	bench_score_digits<24>();
+}
+
+// How the time to draw a wall of scores grows with the number of scores,
+// on a headless GL context
+static void
+bench_wall()
+{
+	std::string errors;
+	if (!init_headless_gl(errors)) {
+		std::cout << "wall: no headless GL\n" << errors;
+		return;
+	}
+	score_wall wall;
+	if (!init_score_wall(wall, 1920, 1080, 2.f, errors)) {
+		std::cout << "wall: failed to init\n" << errors;
+		shutdown_headless_gl();
+		return;
+	}
+	std::cout << "wall at 1920x1080 with " << glGetString(GL_RENDERER)
+		<< "\n";
+	note_gl_renderer();
+	const int counts[] = {1, 10, 100, 1000, 10000, 20000, 50000};
+	for (int count : counts) {
+		score_list scores;
+		random_score_list(scores, count, 1234);
+		set_wall_scores(wall, scores);
+		int frame = 0;
+		render_wall(wall, frame++);
+		glFinish();
+		const double fps = calls_per_second([&]{
+			render_wall(wall, frame++);
+			glFinish();
+		});
+		std::cout << "wall of " << count << " scores ("
+			<< (wall.use_points ? "points" : "lines") << "): "
+			<< 1000.0 / fps << " ms/frame, " << fps << " frames/sec, "
+			<< count * fps / 1e6 << "M scores/sec\n";
+		record("wall.scores_" + std::to_string(count), 1000.0 / fps, "ms");
+	}
+	shutdown_headless_gl();
+}
+
+// Lists like the Info window's: a few windows, mostly text, clipped to the
+// window and to the odd child region. Pushing and popping a clip rectangle
+// can leave commands in a row clipped the same.
+static void
+make_sample_ui(std::vector<ImDrawList>& lists)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	lists.resize(4);
+	for (size_t n = 0 ; n < lists.size() ; ++n) {
+		ImDrawList& list = lists[n];
+		const float left = 20.f + n * 300.f;
+		static const int clips[] = {0, 1, 1, 0, 0, 2, 2, 0};
+		for (int c : clips) {
+			ImDrawCmd cmd;
+			// Glyph quads as two triangles each
+			cmd.vtx_count = 6 * (40 + (int)(unit(rng) * 200.f));
+			cmd.clip_rect = ImVec4(left, 20.f + c * 5.f, left + 280.f,
+				600.f - c * 5.f);
+			const size_t first = list.vtx_buffer.size();
+			list.vtx_buffer.resize(first + cmd.vtx_count);
+			static const float corners[6][2] = {
+				{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+			for (size_t v = first ; v < list.vtx_buffer.size() ; v += 6) {
+				const float x = left + unit(rng) * 272.f;
+				const float y = 20.f + unit(rng) * 567.f;
+				for (int k = 0 ; k < 6 ; ++k) {
+					ImDrawVert& vertex = list.vtx_buffer[v + k];
+					vertex.pos = ImVec2(x + corners[k][0] * 7.f,
+						y + corners[k][1] * 13.f);
+					vertex.uv = ImVec2(corners[k][0], corners[k][1]);
+					vertex.col = 0xe0ffffff;
+				}
+			}
+			list.commands.push_back(cmd);
+		}
+	}
+}
+
+static void
+bench_ui()
+{
+	std::string errors;
+	if (!init_headless_gl(errors)) {
+		std::cout << "ui: no headless GL\n" << errors;
+		return;
+	}
+	const int width = 1280, height = 720;
+	GLuint frame_buffer, target;
+	GLuint font_texture;
+	const unsigned char white[4] = {255, 255, 255, 255};
+	glGenTextures(1, &font_texture);
+	glBindTexture(GL_TEXTURE_2D, font_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+		GL_UNSIGNED_BYTE, white);
+	ui_renderer renderer;
+	if (!create_render_target(width, height, frame_buffer, target, errors) ||
+		!init_ui_renderer(renderer, font_texture, errors)) {
+		std::cout << "ui: failed to init\n" << errors;
+		shutdown_headless_gl();
+		return;
+	}
+	glViewport(0, 0, width, height);
+	std::vector<ImDrawList> lists;
+	make_sample_ui(lists);
+	std::vector<ImDrawList*> pointers;
+	for (ImDrawList& list : lists)
+		pointers.push_back(&list);
+	std::cout << "ui at " << width << "x" << height << " with "
+		<< glGetString(GL_RENDERER) << "\n";
+	note_gl_renderer();
+	for (int way = 0 ; way < 2 ; ++way) {
+		const bool fixed = way == 0;
+		ui_render_stats stats;
+		double cpu_seconds = 0.0;
+		long long frames = 0;
+		const double fps = calls_per_second([&]{
+			if (fixed) {
+				render_ui_lists_fixed(&pointers[0], (int)pointers.size(),
+					(float)width, (float)height, font_texture, stats);
+			}
+			else {
+				render_ui_lists(renderer, &pointers[0], (int)pointers.size(),
+					(float)width, (float)height);
+				stats = renderer.stats;
+			}
+			cpu_seconds += stats.seconds;
+			++frames;
+			glFinish();
+		});
+		std::cout << (fixed ? "fixed function" : renderer.persistent ?
+			"collated, persistent ring" : "collated, orphaned") << ": "
+			<< stats.draw_calls << " draws, " << stats.scissor_changes
+			<< " scissors, " << stats.vertices << " vertices, "
+			<< 1000.0 * cpu_seconds / frames << " ms/frame issuing, "
+			<< 1000.0 / fps << " ms/frame drawn\n";
+		const std::string name = fixed ? "ui.fixed_function" : "ui.collated";
+		record(name + ".issue", 1000.0 * cpu_seconds / frames, "ms");
+		record(name + ".drawn", 1000.0 / fps, "ms");
+	}
+	shutdown_headless_gl();
+}
+
+// What the window's frame time histograms cost a frame: a lap for each
+// of its five times, and reading their percentiles back for the Info window
+static void
+bench_histogram()
+{
+	std::mt19937 rng(1234);
+	// Mostly 16.7 ms, with a tail of hitches
+	std::lognormal_distribution<double> frame_times(log(0.0167), 0.2);
+	std::vector<double> samples(1 << 16);
+	for (double& sample : samples)
+		sample = frame_times(rng);
+	std::vector<time_histogram> times(5);
+	for (time_histogram& histogram : times)
+		init_time_histogram(histogram, "frame");
+	size_t next = 0;
+	const double add_rate = calls_per_second([&]{
+		for (time_histogram& histogram : times)
+			add_time(histogram, samples[next++ % samples.size()]);
+	});
+	float sink = 0.f;
+	const double read_rate = calls_per_second([&]{
+		for (const time_histogram& histogram : times)
+			sink += window_percentile(histogram, 50.0) +
+				window_percentile(histogram, 95.0) +
+				window_percentile(histogram, 99.0) + window_max(histogram);
+	});
+	// Against exact percentiles of the last window of samples
+	const time_histogram& histogram = times[0];
+	std::vector<float> window(histogram.recent,
+		histogram.recent + histogram.window_size);
+	std::sort(window.begin(), window.end());
+	float worst_error = 0.f;
+	for (double percentile : {50.0, 95.0, 99.0}) {
+		const float exact = window[std::max(0, (int)ceil(percentile / 100.0 *
+			window.size()) - 1)];
+		worst_error = std::max(worst_error,
+			fabsf(window_percentile(histogram, percentile) - exact) / exact);
+	}
+	const double frame_us = 1e6 / add_rate + 1e6 / read_rate;
+	std::cout << "histograms: " << 1e9 / add_rate / times.size()
+		<< " ns to add a time, " << 1e6 / read_rate << " us to read "
+		<< times.size() << " histograms' percentiles, " << frame_us
+		<< " us/frame in all (" << frame_us / 1e4 * REAL_TIME_FPS
+		<< "% of a 60 fps frame), percentiles within "
+		<< worst_error * 100.f << "%" << (sink < 0.f ? " " : "") << "\n";
+	record("histogram.add_time", 1e9 / add_rate / times.size(), "ns");
+	record("histogram.frame", frame_us, "us");
+}
+
+// The programs the window makes as it starts
+static const char *const STARTUP_PROGRAMS[][2] = {
+	{"score.vert", "score.frag"},
+	{"line.vert", "line.frag"},
+	{"wall.vert", "score.frag"},
+	{"quad.vert", "quad.frag"},
+	{"ui.vert", "ui.frag"},
+};
+
+static void
+make_startup_programs()
+{
+	for (const auto& files : STARTUP_PROGRAMS) {
+		GLuint program;
+		std::string errors;
+		if (make_shader_program(files[0], files[1], program, errors))
+			glDeleteProgram(program);
+		else
+			std::cout << errors;
+	}
+	glFinish();
+}
+
+// What the startup cache saves: decoding the font, and compiling and
+// linking the window's shader programs, against reading them back. The
+// driver may keep a shader cache of its own, which makes compiling look
+// cheaper than on a real first run.
+static void
+bench_startup()
+{
+	std::string errors;
+	if (!init_headless_gl(errors)) {
+		std::cout << "startup: no headless GL\n" << errors;
+		return;
+	}
+	const std::string dir = default_cache_dir();
+	if (dir.empty()) {
+		std::cout << "startup: nowhere to keep a cache\n";
+		shutdown_headless_gl();
+		return;
+	}
+	font_atlas atlas;
+	set_cache_dir("");
+	const double decode_rate = calls_per_second([&]{
+		load_font_atlas(atlas, errors);
+	});
+	set_cache_dir(dir);
+	load_font_atlas(atlas, errors);
+	const double font_cache_rate = calls_per_second([&]{
+		load_font_atlas(atlas, errors);
+	});
+	std::cout << "startup: font " << atlas.width << "x" << atlas.height
+		<< " decoded in " << 1000.0 / decode_rate << " ms, "
+		<< (atlas.cached ? "from the cache in " : "not cached, ")
+		<< 1000.0 / font_cache_rate << " ms\n";
+	record("startup.font_decode", 1000.0 / decode_rate, "ms");
+	record("startup.font_cached", 1000.0 / font_cache_rate, "ms");
+	set_cache_dir("");
+	const double compile_rate = calls_per_second(make_startup_programs);
+	set_cache_dir(dir);
+	make_startup_programs();
+	const shader_program_stats before = shader_stats;
+	const double binary_rate = calls_per_second(make_startup_programs);
+	const int programs = sizeof(STARTUP_PROGRAMS) / sizeof(STARTUP_PROGRAMS[0]);
+	std::cout << "startup: " << programs << " shader programs with "
+		<< glGetString(GL_RENDERER) << " compiled in "
+		<< 1000.0 / compile_rate << " ms, ";
+	note_gl_renderer();
+	record("startup.shaders_compiled", 1000.0 / compile_rate, "ms");
+	if (shader_stats.cached > before.cached) {
+		std::cout << "from cached binaries in " << 1000.0 / binary_rate
+			<< " ms (" << binary_rate / compile_rate << "x)\n";
+		record("startup.shaders_cached", 1000.0 / binary_rate, "ms");
+	}
+	else
+		std::cout << "not cached (GL can't hand programs back)\n";
+	shutdown_headless_gl();
+}
+
+// Text for "count" random closed shapes of 3 to 64 vertices
+static std::string
+make_sample_shapes(int count)
+{
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> sizes(3, 64);
+	std::uniform_real_distribution<float> radii(0.2f, 1.f);
+	std::ostringstream text;
+	for (int i = 0 ; i < count ; ++i) {
+		const int size = sizes(rng);
+		text << "shape random_" << i << "\n";
+		for (int j = 0 ; j < size ; ++j) {
+			const float angle = 6.2831853f * j / size;
+			const float radius = radii(rng);
+			text << "v " << radius * cosf(angle) << " " << radius * sinf(angle)
+				<< "\n";
+		}
+		text << "loop";
+		for (int j = 0 ; j < size ; ++j)
+			text << " " << j;
+		text << "\n";
+	}
+	return text.str();
+}
+
+// Compiling, mapping and swapping glyph sets from libraries of thousands of
+// shapes, and what they take in memory
+static void
+bench_shapes()
+{
+	std::string errors;
+	const bool have_gl = init_headless_gl(errors);
+	score_renderer renderer;
+	const bool use_gl = have_gl &&
+		init_score_renderer(renderer, 300, 150, errors);
+	const char *path = "shapes_bench.vrshapes";
+	const int counts[] = {900, 9000, 90000};
+	for (int count : counts) {
+		const std::string text = make_sample_shapes(count);
+		std::vector<unsigned char> bytes;
+		const auto compile_start = std::chrono::steady_clock::now();
+		if (!compile_shape_library(text, "sample", bytes, errors)) {
+			std::cout << "shapes: failed to compile\n" << errors;
+			break;
+		}
+		const double compile_seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - compile_start).count();
+		FILE *out = fopen(path, "wb");
+		if (!out || fwrite(&bytes[0], 1, bytes.size(), out) != bytes.size()) {
+			std::cout << "shapes: couldn't write " << path << "\n";
+			if (out)
+				fclose(out);
+			break;
+		}
+		fclose(out);
+		shape_library library;
+		const auto open_start = std::chrono::steady_clock::now();
+		if (!open_shape_library(library, path, errors)) {
+			std::cout << "shapes: failed to open\n" << errors;
+			break;
+		}
+		const double open_seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - open_start).count();
+		// The same shapes kept the way a shape_arena keeps them
+		size_t vertices = 0, indices = 0;
+		for (int i = 0 ; i < library.num_shapes ; ++i) {
+			const shape_geometry shape = library_shape(library, i);
+			vertices += shape.num_vertices;
+			indices += shape.num_indices;
+		}
+		const size_t arena_bytes = vertices * 3 * sizeof(float) +
+			indices * sizeof(unsigned) +
+			library.num_shapes * 2 * sizeof(int);
+		const int sets = num_shape_sets(library);
+		int set = 0;
+		const double swap_rate = calls_per_second([&]{
+			use_shape_set(library, set++ % sets);
+			if (use_gl) {
+				update_score_shapes(renderer);
+				glFinish();
+			}
+		}, 0.2);
+		std::cout << "shapes: " << library.num_shapes << " ("
+			<< indices / 2 << " lines) compiled in "
+			<< compile_seconds * 1000.0 << " ms, mapped and checked in "
+			<< open_seconds * 1000.0 << " ms, " << library.size / 1024.0
+			<< " KB (" << (double)library.size / library.num_shapes
+			<< " bytes/shape, " << arena_bytes / 1024.0
+			<< " KB as an arena), " << 1e6 / swap_rate << " us to swap a set"
+			<< (use_gl ? " and upload it" : "") << "\n";
+		const std::string name = "shapes.shapes_" + std::to_string(count);
+		record(name + ".compile", compile_seconds * 1000.0, "ms");
+		record(name + ".map", open_seconds * 1000.0, "ms");
+		record(name + ".bytes_per_shape",
+			(double)library.size / library.num_shapes, "bytes");
+		record(name + ".swap", 1e6 / swap_rate, "us");
+		use_builtin_shapes();
+		close_shape_library(library);
+	}
+	remove(path);
+	if (have_gl)
+		shutdown_headless_gl();
+}
+
+// The headless loop's frame: step the score, draw it and read it back,
+// both with instancing and a digit at a time
+static void
+bench_frame()
+{
+	std::string errors;
+	if (!init_headless_gl(errors)) {
+		std::cout << "frame: no headless GL\n" << errors;
+		return;
+	}
+	const int width = 300, height = 150;
+	score_renderer renderer;
+	if (!init_score_renderer(renderer, width, height, errors)) {
+		std::cout << "frame: failed to init\n" << errors;
+		shutdown_headless_gl();
+		return;
+	}
+	note_gl_renderer();
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	std::vector<unsigned char> pixels(width * height * 3);
+	for (int way = 0 ; way < 2 ; ++way) {
+		const bool instanced = way == 0;
+		if (instanced && !renderer.can_instance)
+			continue;
+		renderer.use_instancing = instanced;
+		int digits[NUM_DIGITS] = {};
+		long long frame = 0;
+		const double fps = calls_per_second([&]{
+			step_score(digits, frame, true);
+			render_score(renderer, digits, NUM_DIGITS,
+				(float)(frame % ANIMATION_PERIOD));
+			glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+				&pixels[0]);
+			++frame;
+		});
+		std::cout << "frame (" << (instanced ? "instanced" : "per digit")
+			<< ") at " << width << "x" << height << " with "
+			<< glGetString(GL_RENDERER) << ": " << 1000.0 / fps
+			<< " ms/frame, " << fps << " frames/sec\n";
+		record(instanced ? "frame.instanced" : "frame.per_digit",
+			1000.0 / fps, "ms");
+	}
+	shutdown_headless_gl();
+}
+
+static int imgui_vertices;
+
+static void
+count_ui_vertices(ImDrawList** const lists, int count)
+{
+	imgui_vertices = 0;
+	for (int i = 0 ; i < count ; ++i)
+		imgui_vertices += (int)lists[i]->vtx_buffer.size();
+}
+
+// Building a frame of UI like the window's Info window, up to the lists
+// ImGui hands over to be drawn, which are only counted
+static void
+bench_imgui()
+{
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2(600.f, 300.f);
+	io.DeltaTime = 1.f / 60.f;
+	io.IniFilename = NULL;
+	io.RenderDrawListsFn = count_ui_vertices;
+	int digits[NUM_DIGITS] = {0, 1, 2, 3, 4, 5, 6};
+	bool auto_increment = true, paused = false, instanced = true;
+	std::vector<float> recent(HISTOGRAM_WINDOW);
+	for (size_t i = 0 ; i < recent.size() ; ++i)
+		recent[i] = 16.f + (float)(i % 7);
+	const double fps = calls_per_second([&]{
+		ImGui::NewFrame();
+		ImGui::Begin("Info");
+		for (int i = 0 ; i < NUM_DIGITS ; ++i) {
+			char label[2] = {(char)('0' + i), 0};
+			ImGui::InputInt(label, digits + i);
+		}
+		ImGui::Button("increment");
+		int value = score_to_int(digits);
+		ImGui::InputInt("score", &value);
+		ImGui::Checkbox("auto increment", &auto_increment);
+		ImGui::Checkbox("paused", &paused);
+		ImGui::Checkbox("instanced", &instanced);
+		for (int i = 0 ; i < 10 ; ++i)
+			ImGui::Text("line %d: %.2f ms, %d draws, %.1f%%", i, 16.67, 3,
+				12.5);
+		ImGui::PlotLines("frame", &recent[0], (int)recent.size(), 0,
+			"16.67 ms", 0.f, FLT_MAX, ImVec2(0, 40));
+		ImGui::End();
+		ImGui::Render();
+	});
+	std::cout << "imgui: Info window frame built in " << 1e6 / fps
+		<< " us, " << imgui_vertices << " vertices\n";
+	record("imgui.info_window", 1e6 / fps, "us");
+	ImGui::Shutdown();
+}
+
+// Connect to the render server on "path", or give -1
+static int
+connect_to_server(const char *path)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, (const sockaddr*)&address, sizeof(address))) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Send "line" and read the reply's body into "body". Returns false if the
+// server failed it or went away.
+static bool
+ask_server(int fd, const std::string& line, std::vector<char>& body)
+{
+	const std::string request = line + "\n";
+	if (write(fd, request.data(), request.size()) != (ssize_t)request.size())
+		return false;
+	std::string header;
+	char c;
+	while (read(fd, &c, 1) == 1 && c != '\n')
+		header += c;
+	if (header.compare(0, 3, "ok "))
+		return false;
+	body.resize(strtoul(header.c_str() + 3, 0, 10));
+	for (size_t got = 0 ; got < body.size() ; ) {
+		const ssize_t n = read(fd, &body[got], body.size() - got);
+		if (n <= 0)
+			return false;
+		got += n;
+	}
+	return true;
+}
+
+// Clients each asking the render server for one frame at a time, as a web
+// backend would: first frames it has to render, then the same ones again
+// from its cache
+static void
+bench_serve()
+{
+	const char *path = "vrviz_bench.sock";
+	server_job job = {path, 300, 150, 256, true};
+	server_stats stats;
+	std::string errors;
+	std::atomic<bool> finished(false);
+	std::thread server([&]{
+		run_render_server(job, stats, errors);
+		finished = true;
+	});
+	int probe = -1;
+	while (!finished && (probe = connect_to_server(path)) < 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	if (probe < 0) {
+		server.join();
+		std::cout << "serve: no server\n" << errors;
+		return;
+	}
+	close(probe);
+	const int requests_each = 200;
+	for (int clients : {1, 8}) {
+		std::mt19937 rng(clients);
+		std::vector<std::string> lines(clients * requests_each);
+		for (std::string& line : lines) {
+			std::ostringstream text;
+			text << "render ";
+			for (int i = 0 ; i < NUM_DIGITS ; ++i)
+				text << rng() % NUM_SHAPES;
+			text << " frame " << rng() % ANIMATION_PERIOD;
+			line = text.str();
+		}
+		for (int pass = 0 ; pass < 2 ; ++pass) {
+			std::vector<double> latencies(lines.size());
+			std::atomic<int> failures(0);
+			const auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> threads;
+			for (int c = 0 ; c < clients ; ++c)
+				threads.push_back(std::thread([&, c]{
+					const int fd = connect_to_server(path);
+					std::vector<char> body;
+					for (int i = c * requests_each ;
+						i < (c + 1) * requests_each ; ++i) {
+						const auto sent = std::chrono::steady_clock::now();
+						if (fd < 0 || !ask_server(fd, lines[i], body))
+							++failures;
+						latencies[i] = std::chrono::duration<double>(
+							std::chrono::steady_clock::now() - sent).count();
+					}
+					if (fd >= 0)
+						close(fd);
+				}));
+			for (std::thread& thread : threads)
+				thread.join();
+			const double seconds = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+			std::sort(latencies.begin(), latencies.end());
+			const double rate = lines.size() / seconds;
+			const double p50 = latencies[latencies.size() / 2] * 1000.0;
+			const double p99 = latencies[latencies.size() * 99 / 100] * 1000.0;
+			const char *kind = pass ? "cached" : "rendered";
+			std::cout << "serve (" << clients << " clients, " << kind
+				<< "): " << rate << " requests/sec, p50 " << p50
+				<< " ms, p99 " << p99 << " ms"
+				<< (failures ? ", SOME FAILED" : "") << "\n";
+			const std::string name = "serve.clients_" +
+				std::to_string(clients) + "." + kind;
+			record(name + ".requests_per_second", rate, "requests/s");
+			record(name + ".p50", p50, "ms");
+			record(name + ".p99", p99, "ms");
+		}
+	}
+	stop_render_server();
+	server.join();
+	std::cout << "serve: " << stats.frames_rendered << " frames rendered in "
+		<< stats.batches << " passes\n";
+}
+
+bool
+write_bench_results(const char *path, std::string& errors)
+{
+	FILE *out = fopen(path, "w");
+	if (!out) {
+		errors.append(std::string("failed to open ") + path + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	// Names and renderers are only letters, digits and punctuation that
+	// needs no escaping, bar the odd quote
+	std::string renderer = gl_renderer;
+	std::replace(renderer.begin(), renderer.end(), '"', '\'');
+	fprintf(out, "{\n  \"gl_renderer\": \"%s\",\n  \"results\": {",
+		renderer.c_str());
+	for (size_t i = 0 ; i < results.size() ; ++i)
+		fprintf(out, "%s\n    \"%s\": {\"value\": %.6g, \"unit\": \"%s\"}",
+			i ? "," : "", results[i].name.c_str(), results[i].value,
+			results[i].unit);
+	fprintf(out, "\n  }\n}\n");
+	if (fclose(out)) {
+		errors.append(std::string("failed to write ") + path + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	return true;
+}
+
+bool
+run_benchmarks(const char *name, int threads)
+{
+	const bool all = !strcmp(name, "all");
+	bool found = false;
+	if (all || !strcmp(name, "decode")) {
+		bench_decode();
+		found = true;
+	}
+	if (all || !strcmp(name, "farm")) {
+		bench_farm(threads);
+		found = true;
+	}
+	if (all || !strcmp(name, "transform")) {
+		bench_transform();
+		found = true;
+	}
+	if (all || !strcmp(name, "score")) {
+		bench_score();
+		found = true;
+	}
+	if (all || !strcmp(name, "wall")) {
+		bench_wall();
+		found = true;
+	}
+	if (all || !strcmp(name, "ui")) {
+		bench_ui();
+		found = true;
+	}
+	if (all || !strcmp(name, "histogram")) {
+		bench_histogram();
+		found = true;
+	}
+	if (all || !strcmp(name, "startup")) {
+		bench_startup();
+		found = true;
+	}
+	if (all || !strcmp(name, "shapes")) {
+		bench_shapes();
+		found = true;
+	}
+	if (all || !strcmp(name, "frame")) {
+		bench_frame();
+		found = true;
+	}
+	if (all || !strcmp(name, "imgui")) {
+		bench_imgui();
+		found = true;
+	}
+	if (all || !strcmp(name, "serve")) {
+		bench_serve();
+		found = true;
+	}
+	return found;
+}
@@ -0,0 +1,20 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+
+// Run the benchmark called "name", or all of them for "all", printing the
+// results. Work that can be spread out uses "threads" threads (0 means one
+// per hardware thread). Returns false if there's no benchmark by that name.
+bool
+run_benchmarks(const char *name, int threads);
+
+// Write what the benchmarks run so far measured to "path" as JSON: an object
+// of results by name, each with a value and its unit, and the GL renderer
+// they ran on. Names stay the same between releases, so runs can be
+// compared. Returns false and gives error messages in "errors" if it
+// couldn't be written.
+bool
+write_bench_results(const char *path, std::string& errors);
+
+#endif
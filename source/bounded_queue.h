@@ -0,0 +1,79 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// A first-in first-out queue for handing work between threads. Pushing
+// waits while it's full, so a slow consumer holds the producer back rather
+// than letting the queue grow.
+template <typename T>
+class bounded_queue {
+public:
+	explicit bounded_queue(size_t capacity)
+		: capacity(capacity), closed(false) {}
+
+	// Wait for room and add "item". Returns false if the queue was closed.
+	bool push(const T& item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		not_full.wait(lock, [this]{ return closed || items.size() < capacity; });
+		if (closed)
+			return false;
+		items.push_back(item);
+		not_empty.notify_one();
+		return true;
+	}
+
+	// Wait for an item and take it. Returns false once the queue is closed
+	// and everything in it has been taken.
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		not_empty.wait(lock, [this]{ return closed || !items.empty(); });
+		if (items.empty())
+			return false;
+		item = items.front();
+		items.pop_front();
+		not_full.notify_one();
+		return true;
+	}
+
+	// Take an item if there is one, without waiting
+	bool try_pop(T& item)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (items.empty())
+			return false;
+		item = items.front();
+		items.pop_front();
+		not_full.notify_one();
+		return true;
+	}
+
+	// Stop accepting items and wake anyone waiting
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		not_empty.notify_all();
+		not_full.notify_all();
+	}
+
+	size_t size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return items.size();
+	}
+
+private:
+	const size_t capacity;
+	bool closed;
+	std::deque<T> items;
+	std::mutex mutex;
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+};
+
+#endif
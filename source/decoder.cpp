@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "decoder.h"
+
+// Glyphs are at most 12 pixels across from their centre in a 300x150 frame,
+// so with a pixel of slack for matching they fit in a 32x32 window, stored
+// as one 32-bit word per row so it can be compared 32 pixels at a time
+static const int WINDOW_SIZE = 32;
+typedef uint32_t glyph_window[WINDOW_SIZE];
+
+static inline int
+popcount(uint32_t bits)
+{
+#if defined(__GNUC__)
+	return __builtin_popcount(bits);
+#else
+	bits = bits - ((bits >> 1) & 0x55555555);
+	bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+	return (((bits + (bits >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+#endif
+}
+
+static int
+count_bits(const glyph_window bits)
+{
+	int count = 0;
+	for (int row = 0 ; row < WINDOW_SIZE ; ++row)
+		count += popcount(bits[row]);
+	return count;
+}
+
+static int
+count_common_bits(const glyph_window a, const glyph_window b)
+{
+	int count = 0;
+	for (int row = 0 ; row < WINDOW_SIZE ; ++row)
+		count += popcount(a[row] & b[row]);
+	return count;
+}
+
+// Grow every set pixel into its 3x3 neighbourhood
+static void
+dilate(const glyph_window in, glyph_window out)
+{
+	glyph_window wide;
+	for (int row = 0 ; row < WINDOW_SIZE ; ++row)
+		wide[row] = in[row] | (in[row] << 1) | (in[row] >> 1);
+	for (int row = 0 ; row < WINDOW_SIZE ; ++row)
+		out[row] = wide[row] |
+			(row > 0 ? wide[row-1] : 0) |
+			(row+1 < WINDOW_SIZE ? wide[row+1] : 0);
+}
+
+void
+init_score_decoder(score_decoder& decoder, int width, int height)
+{
+	decoder.width = width;
+	decoder.height = height;
+
+	// Digits that line.frag gives the same colour share a class, leaving
+	// only the shape to tell them apart
+	float class_colors[NUM_SHAPES+1][3];
+	decoder.num_classes = 1;
+	for (int digit = 0 ; digit < NUM_SHAPES ; ++digit) {
+		float rgb[3];
+		shape_color(digit, rgb);
+		int c = 1;
+		while (c < decoder.num_classes && memcmp(rgb, class_colors[c],
+			sizeof(rgb)))
+			++c;
+		if (c == decoder.num_classes) {
+			memcpy(class_colors[c], rgb, sizeof(rgb));
+			++decoder.num_classes;
+		}
+		decoder.digit_class[digit] = c;
+	}
+	// Anti-aliasing and video compression change brightness more than hue,
+	// so pick the nearest class colour after normalising the brightness
+	for (int i = 0 ; i < 16*16*16 ; ++i) {
+		const float rgb[3] = {
+			float(i >> 8) + 0.5f, float((i >> 4) & 15) + 0.5f, float(i & 15) + 0.5f
+		};
+		const float brightest = std::max(std::max(rgb[0], rgb[1]), rgb[2]);
+		decoder.class_lut[i] = 0;
+		if (brightest * 16.f <= 96.f)
+			continue;
+		float best_distance = 1e9f;
+		for (int c = 1 ; c < decoder.num_classes ; ++c) {
+			float distance = 0.f;
+			for (int j = 0 ; j < 3 ; ++j) {
+				const float d = rgb[j] / brightest - class_colors[c][j];
+				distance += d * d;
+			}
+			if (distance < best_distance) {
+				best_distance = distance;
+				decoder.class_lut[i] = (unsigned char)c;
+			}
+		}
+	}
+
+	// Glyph positions and sizes only depend on the orbit
+	decoder.places.resize(ORBIT_PERIOD * NUM_DIGITS);
+	for (int frame = 0 ; frame < ORBIT_PERIOD ; ++frame) {
+		for (int i = 0 ; i < NUM_DIGITS ; ++i) {
+			const digit_transform t = get_digit_transform(i, (float)frame);
+			glyph_place& place = decoder.places[frame * NUM_DIGITS + i];
+			place.x = (t.offset_x + 1.f) * 0.5f * width;
+			place.y = (t.offset_y + 1.f) * 0.5f * height;
+			place.radius = t.size * 0.5f * width;
+		}
+	}
+	decoder.lit_sum.resize((width + 1) * (height + 1));
+}
+
+static inline unsigned char
+pixel_class(const score_decoder& d, const unsigned char *p)
+{
+	return d.class_lut[((p[0] >> 4) << 8) | ((p[1] >> 4) << 4) | (p[2] >> 4)];
+}
+
+// Fill in the summed area table of lit pixels
+static void
+sum_lit_pixels(score_decoder& d, const unsigned char *rgb)
+{
+	const int w = d.width;
+	for (int y = 0 ; y < d.height ; ++y) {
+		const unsigned char *in = rgb + y * w * 3;
+		const int *sum_above = &d.lit_sum[y * (w + 1)];
+		int *sum = &d.lit_sum[(y + 1) * (w + 1)];
+		int row_count = 0;
+		sum[0] = 0;
+		for (int x = 0 ; x < w ; ++x, in += 3) {
+			row_count += pixel_class(d, in) != 0;
+			sum[x + 1] = sum_above[x + 1] + row_count;
+		}
+	}
+}
+
+// Lit pixels in the square of pixels around a glyph
+static int
+lit_around(const score_decoder& d, const glyph_place& place)
+{
+	const int w = d.width;
+	const int x0 = std::max((int)(place.x - place.radius), 0);
+	const int y0 = std::max((int)(place.y - place.radius), 0);
+	const int x1 = std::min((int)(place.x + place.radius) + 1, d.width);
+	const int y1 = std::min((int)(place.y + place.radius) + 1, d.height);
+	if (x0 >= x1 || y0 >= y1)
+		return 0;
+	return d.lit_sum[y1 * (w + 1) + x1] - d.lit_sum[y0 * (w + 1) + x1] -
+		d.lit_sum[y1 * (w + 1) + x0] + d.lit_sum[y0 * (w + 1) + x0];
+}
+
+// The point in the orbit where the lit pixels best cover all the glyphs
+static int
+estimate_orbit_frame(const score_decoder& d)
+{
+	int best_frame = 0;
+	int best_count = -1;
+	for (int frame = 0 ; frame < ORBIT_PERIOD ; ++frame) {
+		int count = 0;
+		for (int i = 0 ; i < NUM_DIGITS ; ++i)
+			count += lit_around(d, d.places[frame * NUM_DIGITS + i]);
+		if (count > best_count) {
+			best_count = count;
+			best_frame = frame;
+		}
+	}
+	return best_frame;
+}
+
+// Draw the lines a shape would have at transform "t" into a window whose
+// bottom left pixel is (ox, oy)
+static void
+draw_template(const score_decoder& d,
+			  const shape_geometry& shape,
+			  const digit_transform& t,
+			  int ox,
+			  int oy,
+			  glyph_window bits)
+{
+	const float w = (float)d.width;
+	const float h = (float)d.height;
+	const float aspect = w / h;
+	memset(bits, 0, sizeof(glyph_window));
+	for (int j = 0 ; j + 1 < shape.num_indices ; j += 2) {
+		const float *v0 = shape.vertices + shape.indices[j] * 3;
+		const float *v1 = shape.vertices + shape.indices[j+1] * 3;
+		float x0, y0, x1, y1;
+		apply_digit_transform(t, aspect, v0[0], v0[1], x0, y0);
+		apply_digit_transform(t, aspect, v1[0], v1[1], x1, y1);
+		x0 = (x0 + 1.f) * 0.5f * w - ox;
+		y0 = (y0 + 1.f) * 0.5f * h - oy;
+		x1 = (x1 + 1.f) * 0.5f * w - ox;
+		y1 = (y1 + 1.f) * 0.5f * h - oy;
+		const int steps = (int)(std::max(fabsf(x1 - x0), fabsf(y1 - y0)) * 2.f)
+			+ 1;
+		for (int k = 0 ; k <= steps ; ++k) {
+			const float a = (float)k / steps;
+			const int x = (int)floorf(x0 + (x1 - x0) * a);
+			const int y = (int)floorf(y0 + (y1 - y0) * a);
+			if (x >= 0 && x < WINDOW_SIZE && y >= 0 && y < WINDOW_SIZE)
+				bits[y] |= 1u << x;
+		}
+	}
+}
+
+// Work out which digit is at "index" by matching the lit pixels around it
+// against every shape of the right colour. Returns the match score, or a
+// negative number if nothing is there.
+static float
+match_glyph(const score_decoder& d,
+			const unsigned char *rgb,
+			int index,
+			int frame,
+			int& digit)
+{
+	const glyph_place& place =
+		d.places[(frame % ORBIT_PERIOD) * NUM_DIGITS + index];
+	const int ox = (int)floorf(place.x) - WINDOW_SIZE/2;
+	const int oy = (int)floorf(place.y) - WINDOW_SIZE/2;
+
+	// Split the pixels near the glyph up by colour. Stay inside its radius
+	// so neighbouring glyphs don't get in the way.
+	glyph_window observed[NUM_SHAPES+1];
+	memset(observed, 0, sizeof(observed));
+	const float reach = place.radius + 1.5f;
+	for (int row = 0 ; row < WINDOW_SIZE ; ++row) {
+		const int y = oy + row;
+		const float dy = y + 0.5f - place.y;
+		if (y < 0 || y >= d.height || fabsf(dy) > reach)
+			continue;
+		const float half_width = sqrtf(reach * reach - dy * dy);
+		const int x0 = std::max((int)ceilf(place.x - half_width - 0.5f), ox);
+		const int x1 = std::min((int)floorf(place.x + half_width - 0.5f),
+			std::min(ox + WINDOW_SIZE - 1, d.width - 1));
+		const unsigned char *in = rgb + y * d.width * 3;
+		for (int x = std::max(x0, 0) ; x <= x1 ; ++x)
+			observed[pixel_class(d, in + x * 3)][row] |= 1u << (x - ox);
+	}
+	int best_class = 0;
+	int best_votes = 0;
+	for (int c = 1 ; c < d.num_classes ; ++c) {
+		const int votes = count_bits(observed[c]);
+		if (votes > best_votes) {
+			best_votes = votes;
+			best_class = c;
+		}
+	}
+	if (best_votes == 0)
+		return -1.f;
+
+	// Score each candidate by how much of what's there it explains and how
+	// much of it is there, allowing lines to be out by a pixel
+	const uint32_t *seen = observed[best_class];
+	glyph_window seen_wide;
+	dilate(seen, seen_wide);
+	const digit_transform t = get_digit_transform(index, (float)frame);
+	float best_score = -1.f;
+	for (int candidate = 0 ; candidate < NUM_SHAPES ; ++candidate) {
+		if (d.digit_class[candidate] != best_class)
+			continue;
+		glyph_window expected, expected_wide;
+		draw_template(d, shapes[candidate], t, ox, oy, expected);
+		dilate(expected, expected_wide);
+		const int expected_count = count_bits(expected);
+		if (expected_count == 0)
+			continue;
+		const float precision =
+			(float)count_common_bits(seen, expected_wide) / best_votes;
+		const float recall =
+			(float)count_common_bits(expected, seen_wide) / expected_count;
+		const float score = precision + recall > 0.f ?
+			2.f * precision * recall / (precision + recall) : 0.f;
+		if (score > best_score) {
+			best_score = score;
+			digit = candidate;
+		}
+	}
+	return best_score;
+}
+
+// Match every glyph assuming the animation is at "frame". Returns the total
+// match score, or a negative number if some glyph is missing.
+static float
+decode_at_frame(const score_decoder& d,
+				const unsigned char *rgb,
+				int frame,
+				decode_result& result)
+{
+	float total = 0.f;
+	float worst = 1.f;
+	for (int i = 0 ; i < NUM_DIGITS ; ++i) {
+		result.digits[i] = 0;
+		const float score = match_glyph(d, rgb, i, frame, result.digits[i]);
+		total += score;
+		worst = std::min(worst, score);
+	}
+	result.frame = frame;
+	result.confidence = worst;
+	return worst < 0.f ? -1.f : total;
+}
+
+bool
+decode_score(score_decoder& decoder,
+			 const unsigned char *rgb,
+			 int known_frame,
+			 decode_result& result)
+{
+	if (known_frame >= 0)
+		return decode_at_frame(decoder, rgb, known_frame, result) >= 0.f;
+
+	// The glyph positions give the frame modulo the orbit period, then the
+	// rotation picks between the frames in the full animation with that orbit
+	sum_lit_pixels(decoder, rgb);
+	const int orbit_frame = estimate_orbit_frame(decoder);
+	float best = -2.f;
+	for (int frame = orbit_frame ; frame < ANIMATION_PERIOD ;
+		frame += ORBIT_PERIOD) {
+		decode_result candidate;
+		const float score = decode_at_frame(decoder, rgb, frame, candidate);
+		if (score > best) {
+			best = score;
+			result = candidate;
+		}
+	}
+	// Lit pixel counts only get the orbit to within a frame or two, so let
+	// the glyph matches settle the last bit
+	const int coarse_frame = result.frame;
+	for (int delta = -2 ; delta <= 2 ; ++delta) {
+		if (delta == 0)
+			continue;
+		const int frame = (coarse_frame + delta + ANIMATION_PERIOD) %
+			ANIMATION_PERIOD;
+		decode_result candidate;
+		const float score = decode_at_frame(decoder, rgb, frame, candidate);
+		if (score > best) {
+			best = score;
+			result = candidate;
+		}
+	}
+	return best >= 0.f;
+}
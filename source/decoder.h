@@ -0,0 +1,49 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "line_transform.h"
+#include "shapes.h"
+
+// Where a digit's glyph sits in the frame at some point of the animation
+struct glyph_place {
+	float x;
+	float y;
+	float radius;	// in pixels
+};
+
+// Reads scores back out of rendered frames: the reverse of render_score.
+// Holds lookup tables and per-frame scratch space, so make one per thread.
+struct score_decoder {
+	int width;
+	int height;
+	int num_classes;
+	int digit_class[NUM_SHAPES];		// colour class of each digit
+	unsigned char class_lut[16*16*16];	// 4-bit RGB to colour class
+	std::vector<glyph_place> places;	// ORBIT_PERIOD*NUM_DIGITS of them
+	std::vector<int> lit_sum;			// summed area table of lit pixels
+};
+
+struct decode_result {
+	int digits[NUM_DIGITS];
+	int frame;			// animation frame the glyphs matched best at
+	float confidence;	// worst glyph's match, from 0 to 1
+};
+
+// Set up a decoder for frames of "width" by "height" pixels
+void
+init_score_decoder(score_decoder& decoder, int width, int height);
+
+// Find the score shown in "rgb" (bottom row first, like glReadPixels).
+// If "known_frame" is negative the animation frame is estimated, and the
+// result's frame is only known modulo ANIMATION_PERIOD. Returns false if
+// some glyph couldn't be found at all.
+bool
+decode_score(score_decoder& decoder,
+             const unsigned char *rgb,
+             int known_frame,
+             decode_result& result);
+
+#endif
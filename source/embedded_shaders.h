@@ -0,0 +1,14 @@
+#ifndef EMBEDDED_SHADERS_H
+#define EMBEDDED_SHADERS_H
+
+// A file from shader/, built into the program
+struct embedded_shader {
+	const char *name;
+	const char *source;
+};
+
+// Every shader, ending with one with a null name. The Makefile writes these
+// out from shader/ as generated/embedded_shaders.cpp.
+extern const embedded_shader EMBEDDED_SHADERS[];
+
+#endif
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "farm.h"
+#include "line_transform.h"
+#include "raster.h"
+#include "score.h"
+#include "sim_clock.h"
+
+// Frames a worker takes at once, so it only works out the score from
+// scratch once per run
+static const int RUN_FRAMES = 8;
+// Runs per thread that can be in flight, which fixes the memory used
+static const int RUNS_IN_FLIGHT = 3;
+
+// Frames finished but not yet written, in slots by frame number
+struct frame_window {
+	std::mutex mutex;
+	std::condition_variable slot_free;
+	std::condition_variable frame_ready;
+	std::vector< std::vector<unsigned char> > slots;
+	std::vector<long long> slot_frames;	// which frame each slot holds
+	long long next_to_write;
+	bool stopping;
+};
+
+static void
+farm_worker(const farm_job& job,
+			frame_window& window,
+			std::atomic<long long>& next_run)
+{
+	cpu_rasterizer rasterizer;
+	init_cpu_rasterizer(rasterizer, job.width, job.height, 0);
+	const long long num_slots = (long long)window.slots.size();
+	const long long end = job.first_frame + job.num_frames;
+	for (;;) {
+		const long long run_start = job.first_frame +
+			next_run.fetch_add(1) * RUN_FRAMES;
+		if (run_start >= end)
+			return;
+		const long long run_end = std::min(run_start + RUN_FRAMES, end);
+		// The score the viewer would show at the start of the run
+		int digits[NUM_DIGITS];
+		memcpy(digits, job.digits, sizeof(digits));
+		if (job.auto_increment)
+			advance_score(digits, run_start / INCREMENT_FRAMES);
+		for (long long frame = run_start ; frame < run_end ; ++frame) {
+			if (job.auto_increment && frame > run_start &&
+				frame % INCREMENT_FRAMES == 0)
+				advance_score(digits, 1);
+			const int slot = (int)(frame % num_slots);
+			{
+				std::unique_lock<std::mutex> lock(window.mutex);
+				window.slot_free.wait(lock, [&]{
+					return window.stopping ||
+						frame < window.next_to_write + num_slots;
+				});
+				if (window.stopping)
+					return;
+			}
+			rasterize_score(rasterizer, digits, NUM_DIGITS,
+				(int)(frame % ANIMATION_PERIOD), &window.slots[slot][0]);
+			{
+				std::lock_guard<std::mutex> lock(window.mutex);
+				window.slot_frames[slot] = frame;
+			}
+			window.frame_ready.notify_one();
+		}
+	}
+}
+
+bool
+run_farm(const farm_job& job,
+		 frame_sink& sink,
+		 farm_stats& stats,
+		 std::string& errors)
+{
+	const int threads = job.threads > 0 ? job.threads :
+		std::max((int)std::thread::hardware_concurrency(), 1);
+	frame_window window;
+	const int num_slots = threads * RUN_FRAMES * RUNS_IN_FLIGHT;
+	window.slots.assign(num_slots,
+		std::vector<unsigned char>(job.width * job.height * 3));
+	window.slot_frames.assign(num_slots, -1);
+	window.next_to_write = job.first_frame;
+	window.stopping = false;
+	std::atomic<long long> next_run(0);
+
+	stats = farm_stats();
+	stats.threads = threads;
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int i = 0 ; i < threads ; ++i)
+		workers.push_back(std::thread(farm_worker, std::cref(job),
+			std::ref(window), std::ref(next_run)));
+
+	// Write frames in order as they turn up
+	bool success = true;
+	const long long end = job.first_frame + job.num_frames;
+	for (long long frame = job.first_frame ; frame < end ; ++frame) {
+		const int slot = (int)(frame % num_slots);
+		{
+			const auto wait_start = std::chrono::steady_clock::now();
+			std::unique_lock<std::mutex> lock(window.mutex);
+			window.frame_ready.wait(lock, [&]{
+				return window.slot_frames[slot] == frame;
+			});
+			stats.writer_wait_seconds += std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - wait_start).count();
+		}
+		if (!sink.write_frame(&window.slots[slot][0], job.width, job.height,
+			frame, errors)) {
+			success = false;
+			break;
+		}
+		++stats.frames;
+		{
+			std::lock_guard<std::mutex> lock(window.mutex);
+			window.next_to_write = frame + 1;
+		}
+		window.slot_free.notify_all();
+	}
+	{
+		std::lock_guard<std::mutex> lock(window.mutex);
+		window.stopping = true;
+	}
+	window.slot_free.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	if (success)
+		success = sink.finish(errors);
+	stats.seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	return success;
+}
@@ -0,0 +1,38 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include <string>
+
+#include "frame_sink.h"
+#include "shapes.h"
+
+// What to render offline
+struct farm_job {
+	int digits[NUM_DIGITS];		// score at frame 0
+	bool auto_increment;		// count up every 30 frames like the viewer
+	long long first_frame;
+	long long num_frames;
+	int width;
+	int height;
+	int threads;				// 0 means one per hardware thread
+};
+
+struct farm_stats {
+	long long frames;
+	int threads;
+	double seconds;
+	double writer_wait_seconds;	// time the writer sat waiting for frames
+};
+
+// Render every frame of "job" with a CPU rasterizer per thread, each
+// taking runs of frames and working out the score at the start of the run
+// from the frame number alone. Frames go to "sink" in order, from the
+// calling thread, with a fixed window of frames in flight. Returns false
+// and gives error messages in "errors" if the sink fails.
+bool
+run_farm(const farm_job& job,
+         frame_sink& sink,
+         farm_stats& stats,
+         std::string& errors);
+
+#endif
@@ -0,0 +1,50 @@
+#include <string.h>
+
+#include "font_atlas.h"
+#include "imgui.h"
+#include "startup_cache.h"
+#include "stb_image.h"
+
+// The cache file holds the size, then the pixels
+static const char FONT_CACHE_NAME[] = "font.rgba";
+
+bool
+load_font_atlas(font_atlas& atlas, std::string& errors)
+{
+	const void *png_data;
+	unsigned int png_size;
+	ImGui::GetDefaultFontData(NULL, NULL, &png_data, &png_size);
+	const uint64_t key = hash_bytes(png_data, png_size, HASH_START);
+	std::vector<unsigned char> bytes;
+	int size[2];
+	if (read_cache_file(FONT_CACHE_NAME, key, bytes) &&
+		bytes.size() >= sizeof(size)) {
+		memcpy(size, &bytes[0], sizeof(size));
+		if (size[0] > 0 && size[1] > 0 &&
+			bytes.size() == sizeof(size) + (size_t)size[0] * size[1] * 4) {
+			atlas.width = size[0];
+			atlas.height = size[1];
+			atlas.pixels.assign(bytes.begin() + sizeof(size), bytes.end());
+			atlas.cached = true;
+			return true;
+		}
+	}
+	int components;
+	unsigned char *pixels = stbi_load_from_memory(
+		(const unsigned char*)png_data, (int)png_size, &atlas.width,
+		&atlas.height, &components, 4);
+	if (!pixels) {
+		errors.append("couldn't decode the font\n");
+		return false;
+	}
+	atlas.pixels.assign(pixels, pixels + atlas.width * atlas.height * 4);
+	stbi_image_free(pixels);
+	atlas.cached = false;
+	size[0] = atlas.width;
+	size[1] = atlas.height;
+	bytes.resize(sizeof(size));
+	memcpy(&bytes[0], size, sizeof(size));
+	bytes.insert(bytes.end(), atlas.pixels.begin(), atlas.pixels.end());
+	write_cache_file(FONT_CACHE_NAME, key, &bytes[0], bytes.size());
+	return true;
+}
@@ -0,0 +1,22 @@
+#ifndef FONT_ATLAS_H
+#define FONT_ATLAS_H
+
+#include <string>
+#include <vector>
+
+// ImGui's default font as RGBA pixels, ready to upload
+struct font_atlas {
+	int width;
+	int height;
+	std::vector<unsigned char> pixels;
+	bool cached;		// came decoded from the startup cache
+};
+
+// Decode ImGui's default font, which it keeps as a PNG. The pixels are
+// kept in the startup cache under a hash of the PNG, so after the first run
+// they're read back as they are instead. Returns false and gives error
+// messages in "errors" if the PNG couldn't be decoded.
+bool
+load_font_atlas(font_atlas& atlas, std::string& errors);
+
+#endif
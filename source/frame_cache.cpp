@@ -0,0 +1,112 @@
+#include <algorithm>
+
+#include "frame_cache.h"
+#include "line_transform.h"
+#include "packed_score.h"
+#include "shapes.h"
+
+uint64_t
+frame_key(const int *digits, int frame)
+{
+	const packed_score<NUM_DIGITS, NUM_SHAPES> score =
+		packed_score<NUM_DIGITS, NUM_SHAPES>::from_digits(digits);
+	const int phase = (frame % ANIMATION_PERIOD + ANIMATION_PERIOD) %
+		ANIMATION_PERIOD;
+	return score.words[0] << 12 | (uint64_t)phase;
+}
+
+static void
+unlink_slot(frame_cache& cache, int slot)
+{
+	const int newer = cache.newer[slot];
+	const int older = cache.older[slot];
+	if (newer >= 0)
+		cache.older[newer] = older;
+	else
+		cache.newest = older;
+	if (older >= 0)
+		cache.newer[older] = newer;
+	else
+		cache.oldest = newer;
+}
+
+static void
+make_newest(frame_cache& cache, int slot)
+{
+	cache.newer[slot] = -1;
+	cache.older[slot] = cache.newest;
+	if (cache.newest >= 0)
+		cache.newer[cache.newest] = slot;
+	cache.newest = slot;
+	if (cache.oldest < 0)
+		cache.oldest = slot;
+}
+
+void
+init_frame_cache(frame_cache& cache, int frame_size, size_t budget_bytes)
+{
+	cache.frame_size = frame_size;
+	cache.max_frames = (int)std::max(budget_bytes / frame_size, (size_t)1);
+	cache.slots.clear();
+	cache.slots.reserve(cache.max_frames);
+	cache.pixels.clear();
+	cache.keys.clear();
+	cache.newer.clear();
+	cache.older.clear();
+	cache.newest = -1;
+	cache.oldest = -1;
+	cache.stats = frame_cache_stats();
+}
+
+const unsigned char *
+find_frame(frame_cache& cache, const int *digits, int frame)
+{
+	const auto found = cache.slots.find(frame_key(digits, frame));
+	if (found == cache.slots.end()) {
+		++cache.stats.misses;
+		return 0;
+	}
+	++cache.stats.hits;
+	const int slot = found->second;
+	if (slot != cache.newest) {
+		unlink_slot(cache, slot);
+		make_newest(cache, slot);
+	}
+	return &cache.pixels[slot][0];
+}
+
+unsigned char *
+store_frame(frame_cache& cache, const int *digits, int frame)
+{
+	const uint64_t key = frame_key(digits, frame);
+	int slot;
+	const auto found = cache.slots.find(key);
+	if (found != cache.slots.end()) {
+		slot = found->second;
+		unlink_slot(cache, slot);
+	}
+	else if ((int)cache.pixels.size() < cache.max_frames) {
+		slot = (int)cache.pixels.size();
+		cache.pixels.push_back(std::vector<unsigned char>(cache.frame_size));
+		cache.keys.push_back(key);
+		cache.newer.push_back(-1);
+		cache.older.push_back(-1);
+		cache.slots[key] = slot;
+	}
+	else {
+		slot = cache.oldest;
+		unlink_slot(cache, slot);
+		cache.slots.erase(cache.keys[slot]);
+		cache.keys[slot] = key;
+		cache.slots[key] = slot;
+		++cache.stats.evictions;
+	}
+	make_newest(cache, slot);
+	return &cache.pixels[slot][0];
+}
+
+size_t
+frame_cache_bytes(const frame_cache& cache)
+{
+	return cache.pixels.size() * (size_t)cache.frame_size;
+}
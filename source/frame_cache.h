@@ -0,0 +1,58 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+struct frame_cache_stats {
+	long long hits;
+	long long misses;
+	long long evictions;
+};
+
+// Rendered frames kept by score and point in the animation, which repeats
+// every ANIMATION_PERIOD frames, so showing the same score again is a copy
+// rather than a render. The least recently used frame makes room for new
+// ones once the memory budget is full.
+struct frame_cache {
+	int frame_size;			// bytes in one frame
+	int max_frames;			// how many frames fit in the budget
+	std::unordered_map<uint64_t, int> slots;	// key to slot
+	std::vector<std::vector<unsigned char> > pixels;	// one frame per slot
+	std::vector<uint64_t> keys;
+	// Slots from most to least recently used, as a linked list
+	std::vector<int> newer;
+	std::vector<int> older;
+	int newest;
+	int oldest;
+	frame_cache_stats stats;
+};
+
+// What "digits" at animation frame "frame" are cached under: the packed
+// digits above the frame within the animation
+uint64_t
+frame_key(const int *digits, int frame);
+
+// Set up "cache" for frames of "frame_size" bytes, using at most
+// "budget_bytes" of memory for them (at least one frame)
+void
+init_frame_cache(frame_cache& cache, int frame_size, size_t budget_bytes);
+
+// The cached frame for "digits" at animation frame "frame", or 0 if it
+// isn't cached. Counts a hit or a miss. The pointer is good until the next
+// store_frame.
+const unsigned char *
+find_frame(frame_cache& cache, const int *digits, int frame);
+
+// Space to render the frame for "digits" at "frame" into, evicting the
+// least recently used frame if the cache is full
+unsigned char *
+store_frame(frame_cache& cache, const int *digits, int frame);
+
+// Bytes of frames held right now
+size_t
+frame_cache_bytes(const frame_cache& cache);
+
+#endif
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "frame_sink.h"
+
+stream_sink::stream_sink(FILE *out,
+						 stream_format format,
+						 int frames_per_second) :
+	out(out),
+	format(format),
+	frames_per_second(frames_per_second),
+	width(0),
+	height(0)
+{
+}
+
+bool
+stream_sink::write_frame(const unsigned char *rgb,
+						 int frame_width,
+						 int frame_height,
+						 long long frame,
+						 std::string& errors)
+{
+	if (!width) {
+		width = frame_width;
+		height = frame_height;
+		if (format == STREAM_Y4M) {
+			char header[128];
+			const int length = snprintf(header, sizeof(header),
+				"YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height,
+				frames_per_second);
+			batch.insert(batch.end(), header, header + length);
+		}
+	}
+	else if (frame_width != width || frame_height != height) {
+		errors.append("frame " + std::to_string(frame) + " isn't the size "
+			"of the first\n");
+		return false;
+	}
+	const size_t start = batch.size();
+	if (format == STREAM_RGB) {
+		const size_t row_size = width * 3;
+		batch.resize(start + row_size * height);
+		unsigned char *to = &batch[start];
+		for (int row = height - 1 ; row >= 0 ; --row, to += row_size)
+			memcpy(to, rgb + row * row_size, row_size);
+	}
+	else {
+		static const char marker[] = "FRAME\n";
+		batch.insert(batch.end(), marker, marker + 6);
+		const size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+		batch.resize(start + 6 + (size_t)width * height + 2 * chroma);
+		rgb_to_yuv420(rgb, width, height, &batch[start + 6]);
+	}
+	if (batch.size() >= STREAM_BATCH_BYTES)
+		return write_batch(errors);
+	return true;
+}
+
+bool
+stream_sink::write_batch(std::string& errors)
+{
+	// Flushed straight away so a live reader isn't left a batch behind
+	if ((!batch.empty() &&
+		fwrite(&batch[0], 1, batch.size(), out) != batch.size()) ||
+		fflush(out)) {
+		errors.append(std::string("failed to write frames: ") +
+			strerror(errno) + "\n");
+		return false;
+	}
+	batch.clear();
+	return true;
+}
+
+bool
+stream_sink::finish(std::string& errors)
+{
+	return write_batch(errors);
+}
+
+// BT.601 limited range in 8-bit fixed point, as most y4m readers expect.
+// Every sum stays within 0-65535, so the 16-bit lanes below can wrap in
+// between and still come out exact.
+static const int Y_R = 66, Y_G = 129, Y_B = 25, Y_BIAS = 128 + (16 << 8);
+static const int U_R = 38, U_G = 74, U_B = 112;
+static const int V_R = 112, V_G = 94, V_B = 18;
+static const int UV_BIAS = 128 + (128 << 8);
+
+static void
+luma_row(const uint16_t *r,
+		 const uint16_t *g,
+		 const uint16_t *b,
+		 int n,
+		 unsigned char *y)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i kr = _mm_set1_epi16(Y_R), kg = _mm_set1_epi16(Y_G);
+	const __m128i kb = _mm_set1_epi16(Y_B), bias = _mm_set1_epi16(Y_BIAS);
+	for ( ; i + 8 <= n ; i += 8) {
+		const __m128i sum = _mm_add_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(_mm_loadu_si128((const __m128i*)(r + i)), kr),
+			_mm_mullo_epi16(_mm_loadu_si128((const __m128i*)(g + i)), kg)),
+			_mm_add_epi16(
+			_mm_mullo_epi16(_mm_loadu_si128((const __m128i*)(b + i)), kb),
+			bias));
+		const __m128i value = _mm_srli_epi16(sum, 8);
+		_mm_storel_epi64((__m128i*)(y + i), _mm_packus_epi16(value, value));
+	}
+#endif
+	for ( ; i < n ; ++i)
+		y[i] = (unsigned char)((Y_R*r[i] + Y_G*g[i] + Y_B*b[i] + Y_BIAS) >> 8);
+}
+
+static void
+chroma_row(const uint16_t *r,
+		   const uint16_t *g,
+		   const uint16_t *b,
+		   int n,
+		   unsigned char *u,
+		   unsigned char *v)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i ur = _mm_set1_epi16(U_R), ug = _mm_set1_epi16(U_G);
+	const __m128i ub = _mm_set1_epi16(U_B), vr = _mm_set1_epi16(V_R);
+	const __m128i vg = _mm_set1_epi16(V_G), vb = _mm_set1_epi16(V_B);
+	const __m128i bias = _mm_set1_epi16((short)UV_BIAS);
+	for ( ; i + 8 <= n ; i += 8) {
+		const __m128i cr = _mm_loadu_si128((const __m128i*)(r + i));
+		const __m128i cg = _mm_loadu_si128((const __m128i*)(g + i));
+		const __m128i cb = _mm_loadu_si128((const __m128i*)(b + i));
+		const __m128i u_sum = _mm_sub_epi16(
+			_mm_add_epi16(_mm_mullo_epi16(cb, ub), bias),
+			_mm_add_epi16(_mm_mullo_epi16(cr, ur), _mm_mullo_epi16(cg, ug)));
+		const __m128i v_sum = _mm_sub_epi16(
+			_mm_add_epi16(_mm_mullo_epi16(cr, vr), bias),
+			_mm_add_epi16(_mm_mullo_epi16(cg, vg), _mm_mullo_epi16(cb, vb)));
+		const __m128i u_value = _mm_srli_epi16(u_sum, 8);
+		const __m128i v_value = _mm_srli_epi16(v_sum, 8);
+		_mm_storel_epi64((__m128i*)(u + i), _mm_packus_epi16(u_value, u_value));
+		_mm_storel_epi64((__m128i*)(v + i), _mm_packus_epi16(v_value, v_value));
+	}
+#endif
+	for ( ; i < n ; ++i) {
+		u[i] = (unsigned char)((U_B*b[i] + UV_BIAS - U_R*r[i] - U_G*g[i]) >> 8);
+		v[i] = (unsigned char)((V_R*r[i] + UV_BIAS - V_G*g[i] - V_B*b[i]) >> 8);
+	}
+}
+
+void
+rgb_to_yuv420(const unsigned char *rgb,
+			  int width,
+			  int height,
+			  unsigned char *yuv)
+{
+	const int chroma_width = (width + 1) / 2;
+	const int chroma_height = (height + 1) / 2;
+	unsigned char *y_plane = yuv;
+	unsigned char *u_plane = y_plane + (size_t)width * height;
+	unsigned char *v_plane = u_plane + (size_t)chroma_width * chroma_height;
+	// One row split into channels, then each 2x2 block summed
+	std::vector<uint16_t> scratch(3 * width + 3 * chroma_width);
+	uint16_t *r = &scratch[0], *g = r + width, *b = g + width;
+	uint16_t *sum_r = b + width, *sum_g = sum_r + chroma_width;
+	uint16_t *sum_b = sum_g + chroma_width;
+	for (int cy = 0 ; cy < chroma_height ; ++cy) {
+		std::fill(sum_r, sum_r + 3 * chroma_width, 0);
+		// Odd sizes repeat the last row and column into the last block
+		for (int pass = 0 ; pass < 2 ; ++pass) {
+			const int y = std::min(cy * 2 + pass, height - 1);
+			const unsigned char *row = rgb + (size_t)(height - 1 - y) *
+				width * 3;
+			for (int x = 0 ; x < width ; ++x) {
+				r[x] = row[x * 3];
+				g[x] = row[x * 3 + 1];
+				b[x] = row[x * 3 + 2];
+			}
+			if (pass == 0 || cy * 2 + 1 < height)
+				luma_row(r, g, b, width, y_plane + (size_t)y * width);
+			for (int x = 0 ; x < width ; ++x) {
+				sum_r[x / 2] += r[x];
+				sum_g[x / 2] += g[x];
+				sum_b[x / 2] += b[x];
+			}
+			if (width & 1) {
+				sum_r[chroma_width - 1] += r[width - 1];
+				sum_g[chroma_width - 1] += g[width - 1];
+				sum_b[chroma_width - 1] += b[width - 1];
+			}
+		}
+		for (int x = 0 ; x < 3 * chroma_width ; ++x)
+			sum_r[x] = (sum_r[x] + 2) >> 2;
+		chroma_row(sum_r, sum_g, sum_b, chroma_width,
+			u_plane + (size_t)cy * chroma_width,
+			v_plane + (size_t)cy * chroma_width);
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef FRAME_SINK_H
+#define FRAME_SINK_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Somewhere rendered frames go, one after another in frame order. Frames
+// are 8-bit RGB, bottom row first as glReadPixels and the CPU rasterizer
+// give them.
+class frame_sink {
+public:
+	virtual ~frame_sink() {}
+
+	// Take frame number "frame" of "width" by "height". Returns false and
+	// gives error messages in "errors" if it couldn't be written.
+	virtual bool write_frame(const unsigned char *rgb,
+	                         int width,
+	                         int height,
+	                         long long frame,
+	                         std::string& errors) = 0;
+
+	// The score shown in frame "frame", for sinks that pass it on. Called
+	// when the frame is rendered, which can be a few frames before it's
+	// written.
+	virtual void note_score(long long frame,
+	                        const int *digits,
+	                        int num_digits) {}
+
+	// Called once after the last frame
+	virtual bool finish(std::string& errors) { return true; }
+};
+
+enum stream_format {
+	STREAM_RGB,		// raw 8-bit RGB, top row first, like --timeline rgb reads
+	STREAM_Y4M,		// YUV4MPEG2 4:2:0, BT.601 limited range
+};
+
+static const size_t STREAM_BATCH_BYTES = 256 << 10;
+
+// Frames streamed to a file, pipe or stdout. Frames are gathered into
+// writes of about STREAM_BATCH_BYTES, and each write blocks until it's
+// taken, so a slow reader holds up rendering instead of frames piling up.
+class stream_sink : public frame_sink {
+public:
+	stream_sink(FILE *out, stream_format format, int frames_per_second);
+
+	bool write_frame(const unsigned char *rgb,
+	                 int width,
+	                 int height,
+	                 long long frame,
+	                 std::string& errors);
+	bool finish(std::string& errors);
+
+private:
+	bool write_batch(std::string& errors);
+
+	FILE *out;
+	stream_format format;
+	int frames_per_second;
+	int width;		// of the first frame, which every frame has to match
+	int height;
+	std::vector<unsigned char> batch;
+};
+
+// Throws frames away, for measuring how fast they're made
+class null_sink : public frame_sink {
+public:
+	bool write_frame(const unsigned char *rgb,
+	                 int width,
+	                 int height,
+	                 long long frame,
+	                 std::string& errors) { return true; }
+};
+
+// Convert a bottom row first RGB frame to the planes of a 4:2:0 y4m frame,
+// top row first: Y, then U and V at half size rounded up
+void
+rgb_to_yuv420(const unsigned char *rgb,
+              int width,
+              int height,
+              unsigned char *yuv);
+
+#endif
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gif.h"
+#include "profiler.h"
+#include "shapes.h"
+#include "thread_pool.h"
+
+// Black, then each digit's colour
+static const int PALETTE_SIZE = 16;
+static const int TRANSPARENT_INDEX = PALETTE_SIZE - 1;
+// Frames compressed together, per thread
+static const int FRAMES_PER_THREAD = 4;
+// LZW codes start at 4 bits for the 16 colours, and go up to 12
+static const int MIN_CODE_SIZE = 4;
+static const int CLEAR_CODE = 1 << MIN_CODE_SIZE;
+static const int END_CODE = CLEAR_CODE + 1;
+static const int MAX_CODES = 4096;
+
+static void
+get_palette(unsigned char (&palette)[PALETTE_SIZE][3])
+{
+	memset(palette, 0, sizeof(palette));
+	for (int digit = 0 ; digit < NUM_SHAPES ; ++digit) {
+		float rgb[3];
+		shape_color(digit, rgb);
+		for (int c = 0 ; c < 3 ; ++c)
+			palette[digit + 1][c] = (unsigned char)(rgb[c] * 255.f + 0.5f);
+	}
+}
+
+// Packs variable width codes into bytes, least significant bit first
+struct code_writer {
+	std::vector<unsigned char>& bytes;
+	uint32_t bits;
+	int num_bits;
+
+	explicit code_writer(std::vector<unsigned char>& bytes) :
+		bytes(bytes), bits(0), num_bits(0) {}
+
+	void write(int code, int size)
+	{
+		bits |= (uint32_t)code << num_bits;
+		num_bits += size;
+		while (num_bits >= 8) {
+			bytes.push_back((unsigned char)bits);
+			bits >>= 8;
+			num_bits -= 8;
+		}
+	}
+
+	void flush()
+	{
+		if (num_bits)
+			bytes.push_back((unsigned char)bits);
+		bits = 0;
+		num_bits = 0;
+	}
+};
+
+// Compress a frame's indices into GIF image data: the minimum code size,
+// then the LZW codes in sub-blocks of up to 255 bytes, then an empty one
+static void
+encode_frame(gif_frame& frame)
+{
+	profile_scope scope("encode GIF frame");
+	// For each string so far, the code of that string followed by each
+	// colour, or 0 if there isn't one yet
+	static thread_local std::vector<uint16_t> next_codes;
+	next_codes.assign(MAX_CODES * PALETTE_SIZE, 0);
+	std::vector<unsigned char> codes;
+	codes.reserve(frame.indices.size() / 2 + 16);
+	code_writer writer(codes);
+	int code_size = MIN_CODE_SIZE + 1;
+	int next_code = END_CODE + 1;
+	writer.write(CLEAR_CODE, code_size);
+	const unsigned char *pixels = &frame.indices[0];
+	const size_t count = frame.indices.size();
+	int prefix = pixels[0];
+	for (size_t i = 1 ; i < count ; ++i) {
+		const int colour = pixels[i];
+		uint16_t& next = next_codes[prefix * PALETTE_SIZE + colour];
+		if (next) {
+			prefix = next;
+			continue;
+		}
+		writer.write(prefix, code_size);
+		if (next_code == MAX_CODES) {
+			// Full, so start again
+			writer.write(CLEAR_CODE, code_size);
+			std::fill(next_codes.begin(), next_codes.end(), 0);
+			code_size = MIN_CODE_SIZE + 1;
+			next_code = END_CODE + 1;
+		}
+		else {
+			// The reader widens its codes a code behind
+			if (next_code == 1 << code_size)
+				++code_size;
+			next = (uint16_t)next_code++;
+		}
+		prefix = colour;
+	}
+	writer.write(prefix, code_size);
+	if (next_code == 1 << code_size && code_size < 12)
+		++code_size;
+	writer.write(END_CODE, code_size);
+	writer.flush();
+
+	frame.encoded.clear();
+	frame.encoded.reserve(codes.size() + codes.size() / 255 + 3);
+	frame.encoded.push_back(MIN_CODE_SIZE);
+	for (size_t at = 0 ; at < codes.size() ; at += 255) {
+		const size_t block = std::min(codes.size() - at, (size_t)255);
+		frame.encoded.push_back((unsigned char)block);
+		frame.encoded.insert(frame.encoded.end(), codes.begin() + at,
+			codes.begin() + at + block);
+	}
+	frame.encoded.push_back(0);
+}
+
+static void
+put_short(unsigned char *to, int value)
+{
+	to[0] = (unsigned char)value;
+	to[1] = (unsigned char)(value >> 8);
+}
+
+gif_sink::gif_sink(FILE *out, int frames_per_second, int threads) :
+	out(out),
+	delay(std::max(2, (100 + frames_per_second / 2) / frames_per_second)),
+	threads(threads),
+	width(0),
+	height(0),
+	batch_size(0),
+	stats()
+{
+	unsigned char palette[PALETTE_SIZE][3];
+	get_palette(palette);
+	for (int i = 0 ; i < 32 * 32 * 32 ; ++i) {
+		const int rgb[3] = {
+			(i >> 10) * 255 / 31, ((i >> 5) & 31) * 255 / 31,
+			(i & 31) * 255 / 31 };
+		int best = 0, best_distance = 1 << 30;
+		for (int p = 0 ; p <= NUM_SHAPES ; ++p) {
+			int distance = 0;
+			for (int c = 0 ; c < 3 ; ++c)
+				distance += (rgb[c] - palette[p][c]) * (rgb[c] - palette[p][c]);
+			if (distance < best_distance) {
+				best = p;
+				best_distance = distance;
+			}
+		}
+		palette_lookup[i] = (unsigned char)best;
+	}
+}
+
+gif_sink::~gif_sink()
+{
+}
+
+bool
+gif_sink::write_bytes(const void *bytes, size_t size, std::string& errors)
+{
+	if (fwrite(bytes, 1, size, out) != size) {
+		errors.append(std::string("failed to write GIF: ") + strerror(errno) +
+			"\n");
+		return false;
+	}
+	stats.bytes += size;
+	return true;
+}
+
+bool
+gif_sink::write_frame(const unsigned char *rgb,
+					  int frame_width,
+					  int frame_height,
+					  long long frame,
+					  std::string& errors)
+{
+	const auto start = std::chrono::steady_clock::now();
+	if (!width) {
+		width = frame_width;
+		height = frame_height;
+		pool.reset(new thread_pool(threads));
+		batch.resize(pool->size() * FRAMES_PER_THREAD);
+		// Nothing matches the first frame, so all of it is stored
+		previous.assign(width * height, 0xff);
+		current.resize(width * height);
+		// Header, screen descriptor with the palette, and looping forever
+		unsigned char header[13 + PALETTE_SIZE * 3 + 19] = {
+			'G', 'I', 'F', '8', '9', 'a'};
+		put_short(header + 6, width);
+		put_short(header + 8, height);
+		header[10] = 0x80 | 0x30 | 3;	// palette of 2^(3+1) 8-bit colours
+		unsigned char palette[PALETTE_SIZE][3];
+		get_palette(palette);
+		memcpy(header + 13, palette, sizeof(palette));
+		static const unsigned char loop[19] = {
+			0x21, 0xff, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.',
+			'0', 3, 1, 0, 0, 0};
+		memcpy(header + 13 + sizeof(palette), loop, sizeof(loop));
+		if (!write_bytes(header, sizeof(header), errors))
+			return false;
+	}
+	else if (frame_width != width || frame_height != height) {
+		errors.append("frame " + std::to_string(frame) + " isn't the size "
+			"of the first\n");
+		return false;
+	}
+	// Map to the palette, top row first, and find what changed
+	int left = width, right = -1, top = height, bottom = -1;
+	for (int y = 0 ; y < height ; ++y) {
+		const unsigned char *row = rgb + (size_t)(height - 1 - y) * width * 3;
+		unsigned char *indices = &current[(size_t)y * width];
+		const unsigned char *before = &previous[(size_t)y * width];
+		int row_left = width, row_right = -1;
+		for (int x = 0 ; x < width ; ++x) {
+			const unsigned char *p = row + x * 3;
+			indices[x] = palette_lookup[(p[0] >> 3) << 10 |
+				(p[1] >> 3) << 5 | p[2] >> 3];
+			if (indices[x] != before[x]) {
+				row_left = std::min(row_left, x);
+				row_right = x;
+			}
+		}
+		if (row_right >= 0) {
+			left = std::min(left, row_left);
+			right = std::max(right, row_right);
+			top = std::min(top, y);
+			bottom = y;
+		}
+	}
+	gif_frame& pending = batch[batch_size++];
+	if (right < 0) {
+		// Nothing changed, but the frame still has to take its time
+		pending.left = pending.top = 0;
+		pending.width = pending.height = 1;
+		pending.indices.assign(1, TRANSPARENT_INDEX);
+	}
+	else {
+		pending.left = left;
+		pending.top = top;
+		pending.width = right - left + 1;
+		pending.height = bottom - top + 1;
+		pending.indices.resize((size_t)pending.width * pending.height);
+		unsigned char *to = &pending.indices[0];
+		for (int y = top ; y <= bottom ; ++y) {
+			const unsigned char *now = &current[(size_t)y * width];
+			const unsigned char *before = &previous[(size_t)y * width];
+			for (int x = left ; x <= right ; ++x)
+				*to++ = now[x] == before[x] ? TRANSPARENT_INDEX : now[x];
+		}
+	}
+	stats.changed_pixels += (long long)pending.width * pending.height;
+	++stats.frames;
+	previous.swap(current);
+	bool success = true;
+	if (batch_size == batch.size())
+		success = write_batch(errors);
+	stats.seconds += std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	return success;
+}
+
+bool
+gif_sink::write_batch(std::string& errors)
+{
+	pool->parallel_for((int)batch_size, [&](int i) {
+		encode_frame(batch[i]);
+	});
+	for (size_t i = 0 ; i < batch_size ; ++i) {
+		const gif_frame& frame = batch[i];
+		// Graphic control (leave the frame in place, with a transparent
+		// colour) and image descriptor, no local palette
+		unsigned char header[8 + 10] = {
+			0x21, 0xf9, 4, 1 << 2 | 1, 0, 0, TRANSPARENT_INDEX, 0,
+			0x2c};
+		put_short(header + 4, delay);
+		put_short(header + 9, frame.left);
+		put_short(header + 11, frame.top);
+		put_short(header + 13, frame.width);
+		put_short(header + 15, frame.height);
+		if (!write_bytes(header, sizeof(header), errors) ||
+			!write_bytes(&frame.encoded[0], frame.encoded.size(), errors))
+			return false;
+	}
+	batch_size = 0;
+	return true;
+}
+
+bool
+gif_sink::finish(std::string& errors)
+{
+	if (!width) {
+		errors.append("no frames to make a GIF of\n");
+		return false;
+	}
+	const auto start = std::chrono::steady_clock::now();
+	const unsigned char trailer = 0x3b;
+	const bool success = write_batch(errors) &&
+		write_bytes(&trailer, 1, errors);
+	stats.seconds += std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	if (success && fflush(out)) {
+		errors.append(std::string("failed to write GIF: ") + strerror(errno) +
+			"\n");
+		return false;
+	}
+	return success;
+}
@@ -0,0 +1,70 @@
+#ifndef GIF_H
+#define GIF_H
+
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "frame_sink.h"
+
+class thread_pool;
+
+struct gif_stats {
+	long long frames;
+	long long bytes;			// written so far, header and all
+	long long changed_pixels;	// in the rectangles that were encoded
+	double seconds;				// spent in the sink, mapping and encoding
+};
+
+// One frame's changed rectangle, palette indexed, and its GIF image data
+struct gif_frame {
+	int left;
+	int top;
+	int width;
+	int height;
+	std::vector<unsigned char> indices;
+	std::vector<unsigned char> encoded;
+};
+
+// Writes frames as a looping animated GIF. Frames only ever hold black and
+// the shape colours, so they use that as a fixed 16 entry palette, with
+// each pixel taking the nearest colour in it (which only changes the
+// anti-aliased edges of CPU rasterizer frames). After the first frame only
+// the rectangle that changed is stored, with pixels inside it that didn't
+// change left transparent. Frames are compressed a batch at a time on a
+// pool of "threads" threads (0 for one per hardware thread) and written in
+// order.
+class gif_sink : public frame_sink {
+public:
+	gif_sink(FILE *out, int frames_per_second, int threads);
+	~gif_sink();
+
+	bool write_frame(const unsigned char *rgb,
+	                 int width,
+	                 int height,
+	                 long long frame,
+	                 std::string& errors);
+	bool finish(std::string& errors);
+
+	const gif_stats& get_stats() const { return stats; }
+
+private:
+	bool write_batch(std::string& errors);
+	bool write_bytes(const void *bytes, size_t size, std::string& errors);
+
+	FILE *out;
+	int delay;			// between frames, in hundredths of a second
+	int threads;
+	std::unique_ptr<thread_pool> pool;	// made with the first frame
+	int width;
+	int height;
+	unsigned char palette_lookup[32 * 32 * 32];	// 5 bits of each channel
+	std::vector<unsigned char> previous;		// indices, top row first
+	std::vector<unsigned char> current;
+	std::vector<gif_frame> batch;
+	size_t batch_size;
+	gif_stats stats;
+};
+
+#endif
@@ -0,0 +1,129 @@
+// glew
+#define GLEW_STATIC
+#include <GL/glew.h>
+#ifdef VRVIZ_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstring>
+
+#include "headless.h"
+
+#ifdef VRVIZ_HAVE_EGL
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+static EGLSurface surface = EGL_NO_SURFACE;
+
+static EGLDisplay
+get_display()
+{
+	// Prefer Mesa's surfaceless platform, which needs neither X nor a GPU
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)
+		eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (get_platform_display) {
+		EGLDisplay d = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+			EGL_DEFAULT_DISPLAY, NULL);
+		if (d != EGL_NO_DISPLAY)
+			return d;
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool
+init_headless_gl(std::string& errors)
+{
+	display = get_display();
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, 0, 0)) {
+		errors.append("couldn't initialize an EGL display\n");
+		return false;
+	}
+	// The shaders and the ImGui renderer rely on the compatibility profile,
+	// so ask for desktop OpenGL rather than GLES
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		errors.append("EGL display doesn't support desktop OpenGL\n");
+		return false;
+	}
+	const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint num_configs = 0;
+	if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) ||
+		num_configs == 0) {
+		errors.append("no suitable EGL config\n");
+		return false;
+	}
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+	if (context == EGL_NO_CONTEXT) {
+		errors.append("couldn't create an EGL context\n");
+		return false;
+	}
+	// Everything is drawn into our own framebuffer objects, so only make a
+	// (tiny) surface if the implementation can't do without one
+	const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+	const bool surfaceless = extensions &&
+		strstr(extensions, "EGL_KHR_surfaceless_context");
+	if (!surfaceless) {
+		const EGLint pbuffer_attribs[] = {
+			EGL_WIDTH, 1,
+			EGL_HEIGHT, 1,
+			EGL_NONE
+		};
+		surface = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+		if (surface == EGL_NO_SURFACE) {
+			errors.append("couldn't create an EGL pbuffer surface\n");
+			return false;
+		}
+	}
+	if (!eglMakeCurrent(display, surface, surface, context)) {
+		errors.append("couldn't make the EGL context current\n");
+		return false;
+	}
+	// glewInit() also looks up GLX and fails when there's no X display, so
+	// only load the GL entry points themselves
+	glewExperimental = GL_TRUE;
+	if (glewContextInit() != GLEW_OK) {
+		errors.append("couldn't initialize GLEW\n");
+		return false;
+	}
+	return true;
+}
+
+void
+shutdown_headless_gl()
+{
+	if (display == EGL_NO_DISPLAY)
+		return;
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (surface != EGL_NO_SURFACE)
+		eglDestroySurface(display, surface);
+	if (context != EGL_NO_CONTEXT)
+		eglDestroyContext(display, context);
+	eglTerminate(display);
+	display = EGL_NO_DISPLAY;
+	context = EGL_NO_CONTEXT;
+	surface = EGL_NO_SURFACE;
+}
+
+#else
+
+bool
+init_headless_gl(std::string& errors)
+{
+	errors.append("headless mode needs EGL, which this build doesn't have\n");
+	return false;
+}
+
+void
+shutdown_headless_gl()
+{
+}
+
+#endif
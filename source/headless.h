@@ -0,0 +1,17 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <string>
+
+// Create an OpenGL context with no window or surface behind it, so rendering
+// can only go to framebuffer objects. Works on machines with no display
+// (e.g. Mesa's llvmpipe through EGL). Returns false and gives error messages
+// in "errors" if no such context could be made.
+bool
+init_headless_gl(std::string& errors);
+
+// Release the context made by init_headless_gl.
+void
+shutdown_headless_gl();
+
+#endif
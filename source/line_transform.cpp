@@ -0,0 +1,191 @@
+#include <math.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "line_transform.h"
+
+// These must match line.vert
+static const float PI = 3.14159265359f;
+static const float rotate_interval = 70.f;
+static const float orbit_interval = 200.f;
+static const float orbit_x = 0.8f;
+static const float orbit_y = 0.6f;
+
+digit_transform
+get_digit_transform(int index, float frame)
+{
+	digit_transform t;
+	const float theta_offset = float(index) * 0.1f;
+	const float theta = (frame / rotate_interval - theta_offset) * PI;
+	t.cos_theta = cosf(theta);
+	t.sin_theta = sinf(theta);
+
+	const float phi_offset = -float(index) * 0.15f;
+	const float phi = (frame / orbit_interval - phi_offset) * PI;
+	t.offset_x = orbit_x * cosf(phi);
+	t.offset_y = orbit_y * sinf(phi);
+
+	t.size = 0.05f + ((sinf(phi)+1.f)*0.015f);
+	return t;
+}
+
+void
+build_shape_segments(shape_segments& segments)
+{
+	segments.x0.clear();
+	segments.y0.clear();
+	segments.x1.clear();
+	segments.y1.clear();
+	for (int i = 0 ; i < NUM_SHAPES ; ++i) {
+		const shape_geometry& shape = shapes[i];
+		segments.first_segment[i] = (int)segments.x0.size();
+		segments.segment_counts[i] = shape.num_indices / 2;
+		for (int j = 0 ; j < shape.num_indices ; j += 2) {
+			const float *v0 = &shape.vertices[shape.indices[j] * 3];
+			const float *v1 = &shape.vertices[shape.indices[j+1] * 3];
+			segments.x0.push_back(v0[0]);
+			segments.y0.push_back(v0[1]);
+			segments.x1.push_back(v1[0]);
+			segments.y1.push_back(v1[1]);
+		}
+	}
+}
+
+// Frames done at once
+#if defined(__AVX__)
+static const int LANES = 8;
+#elif defined(__SSE2__)
+static const int LANES = 4;
+#else
+static const int LANES = 1;
+#endif
+
+// Rows of the per digit transform table
+enum {
+	COS_THETA,
+	SIN_THETA,
+	SIZE_X,
+	SIZE_Y,
+	OFFSET_X,
+	OFFSET_Y,
+	NUM_TRANSFORM_ROWS
+};
+
+// Transform one line's ends for every frame, given a digit's transform
+// table rows, each "stride" long (a whole number of vectors)
+static void
+transform_line(const float *table,
+			   int stride,
+			   float x0,
+			   float y0,
+			   float x1,
+			   float y1,
+			   float *out_x0,
+			   float *out_y0,
+			   float *out_x1,
+			   float *out_y1)
+{
+	const float *cos_theta = table + COS_THETA * stride;
+	const float *sin_theta = table + SIN_THETA * stride;
+	const float *size_x = table + SIZE_X * stride;
+	const float *size_y = table + SIZE_Y * stride;
+	const float *offset_x = table + OFFSET_X * stride;
+	const float *offset_y = table + OFFSET_Y * stride;
+#if defined(__AVX__)
+	const __m256 ax = _mm256_set1_ps(x0), ay = _mm256_set1_ps(y0);
+	const __m256 bx = _mm256_set1_ps(x1), by = _mm256_set1_ps(y1);
+	for (int f = 0 ; f < stride ; f += 8) {
+		const __m256 c = _mm256_loadu_ps(cos_theta + f);
+		const __m256 s = _mm256_loadu_ps(sin_theta + f);
+		const __m256 sx = _mm256_loadu_ps(size_x + f);
+		const __m256 sy = _mm256_loadu_ps(size_y + f);
+		const __m256 ox = _mm256_loadu_ps(offset_x + f);
+		const __m256 oy = _mm256_loadu_ps(offset_y + f);
+		_mm256_storeu_ps(out_x0 + f, _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(
+			_mm256_mul_ps(ax, c), _mm256_mul_ps(ay, s)), sx), ox));
+		_mm256_storeu_ps(out_y0 + f, _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(
+			_mm256_mul_ps(ay, c), _mm256_mul_ps(ax, s)), sy), oy));
+		_mm256_storeu_ps(out_x1 + f, _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(
+			_mm256_mul_ps(bx, c), _mm256_mul_ps(by, s)), sx), ox));
+		_mm256_storeu_ps(out_y1 + f, _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(
+			_mm256_mul_ps(by, c), _mm256_mul_ps(bx, s)), sy), oy));
+	}
+#elif defined(__SSE2__)
+	const __m128 ax = _mm_set1_ps(x0), ay = _mm_set1_ps(y0);
+	const __m128 bx = _mm_set1_ps(x1), by = _mm_set1_ps(y1);
+	for (int f = 0 ; f < stride ; f += 4) {
+		const __m128 c = _mm_loadu_ps(cos_theta + f);
+		const __m128 s = _mm_loadu_ps(sin_theta + f);
+		const __m128 sx = _mm_loadu_ps(size_x + f);
+		const __m128 sy = _mm_loadu_ps(size_y + f);
+		const __m128 ox = _mm_loadu_ps(offset_x + f);
+		const __m128 oy = _mm_loadu_ps(offset_y + f);
+		_mm_storeu_ps(out_x0 + f, _mm_add_ps(_mm_mul_ps(_mm_add_ps(
+			_mm_mul_ps(ax, c), _mm_mul_ps(ay, s)), sx), ox));
+		_mm_storeu_ps(out_y0 + f, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(
+			_mm_mul_ps(ay, c), _mm_mul_ps(ax, s)), sy), oy));
+		_mm_storeu_ps(out_x1 + f, _mm_add_ps(_mm_mul_ps(_mm_add_ps(
+			_mm_mul_ps(bx, c), _mm_mul_ps(by, s)), sx), ox));
+		_mm_storeu_ps(out_y1 + f, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(
+			_mm_mul_ps(by, c), _mm_mul_ps(bx, s)), sy), oy));
+	}
+#else
+	for (int f = 0 ; f < stride ; ++f) {
+		const float c = cos_theta[f], s = sin_theta[f];
+		out_x0[f] = (x0*c + y0*s) * size_x[f] + offset_x[f];
+		out_y0[f] = (y0*c - x0*s) * size_y[f] + offset_y[f];
+		out_x1[f] = (x1*c + y1*s) * size_x[f] + offset_x[f];
+		out_y1[f] = (y1*c - x1*s) * size_y[f] + offset_y[f];
+	}
+#endif
+}
+
+void
+transform_score(const shape_segments& shapes,
+				const int *digits,
+				int num_digits,
+				int first_frame,
+				int num_frames,
+				float aspect,
+				score_segments& out)
+{
+	const int stride = (num_frames + LANES - 1) / LANES * LANES;
+	int num_segments = 0;
+	for (int i = 0 ; i < num_digits ; ++i)
+		num_segments += shapes.segment_counts[digits[i]];
+	out.num_frames = num_frames;
+	out.num_segments = num_segments;
+	out.stride = stride;
+	out.x0.resize(num_segments * stride);
+	out.y0.resize(num_segments * stride);
+	out.x1.resize(num_segments * stride);
+	out.y1.resize(num_segments * stride);
+	// Padding frames past the end are transformed too, as a frame 0
+	out.transforms.assign(NUM_TRANSFORM_ROWS * stride, 0.f);
+	float *table = &out.transforms[0];
+
+	int segment = 0;
+	for (int i = 0 ; i < num_digits ; ++i) {
+		for (int f = 0 ; f < num_frames ; ++f) {
+			const digit_transform t =
+				get_digit_transform(i, (float)(first_frame + f));
+			table[COS_THETA * stride + f] = t.cos_theta;
+			table[SIN_THETA * stride + f] = t.sin_theta;
+			table[SIZE_X * stride + f] = t.size;
+			table[SIZE_Y * stride + f] = t.size * aspect;
+			table[OFFSET_X * stride + f] = t.offset_x;
+			table[OFFSET_Y * stride + f] = t.offset_y;
+		}
+		const int shape = digits[i];
+		for (int j = 0 ; j < shapes.segment_counts[shape] ; ++j, ++segment) {
+			const int k = shapes.first_segment[shape] + j;
+			const int at = segment * stride;
+			transform_line(table, stride, shapes.x0[k], shapes.y0[k],
+				shapes.x1[k], shapes.y1[k], &out.x0[at], &out.y0[at],
+				&out.x1[at], &out.y1[at]);
+		}
+	}
+}
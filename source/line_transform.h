@@ -0,0 +1,83 @@
+#ifndef LINE_TRANSFORM_H
+#define LINE_TRANSFORM_H
+
+#include <vector>
+
+#include "shapes.h"
+
+// CPU version of the animation in line.vert. Each digit's shape is rotated,
+// scaled and moved around an orbit depending on its index and the frame.
+
+// Frames for a full turn of the rotation and of the orbit, and for the
+// whole animation to come back to where it started
+const int ROTATE_PERIOD = 140;
+const int ORBIT_PERIOD = 400;
+const int ANIMATION_PERIOD = 2800;
+
+struct digit_transform {
+	float cos_theta;
+	float sin_theta;
+	float size;
+	float offset_x;
+	float offset_y;
+};
+
+// Work out the transform line.vert applies to digit "index" at "frame"
+digit_transform
+get_digit_transform(int index, float frame);
+
+// Transform a shape-space vertex to clip space, like line.vert does
+inline void
+apply_digit_transform(const digit_transform& t,
+                      float aspect,
+                      float x,
+                      float y,
+                      float& out_x,
+                      float& out_y)
+{
+	out_x = (x*t.cos_theta + y*t.sin_theta) * t.size + t.offset_x;
+	out_y = (-x*t.sin_theta + y*t.cos_theta) * t.size * aspect + t.offset_y;
+}
+
+// Every shape's lines as structure-of-arrays, shape after shape, for
+// transforming lots of them at once
+struct shape_segments {
+	std::vector<float> x0;
+	std::vector<float> y0;
+	std::vector<float> x1;
+	std::vector<float> y1;
+	int first_segment[NUM_SHAPES];
+	int segment_counts[NUM_SHAPES];
+};
+
+void
+build_shape_segments(shape_segments& segments);
+
+// A score's lines in clip space over a run of frames. Lines go digit by
+// digit in shape order, and each line's frames are together: frame f of
+// line i is at [i*stride + f].
+struct score_segments {
+	int num_frames;
+	int num_segments;
+	int stride;				// num_frames rounded up to a whole vector
+	std::vector<float> x0;
+	std::vector<float> y0;
+	std::vector<float> x1;
+	std::vector<float> y1;
+	std::vector<float> transforms;	// working space
+};
+
+// Transform every line of "digits" to clip space, like line.vert, for the
+// "num_frames" frames from "first_frame". Sines and cosines are worked out
+// once per digit and frame, then each line is done 4 or 8 frames at a time
+// with SSE or AVX.
+void
+transform_score(const shape_segments& shapes,
+                const int *digits,
+                int num_digits,
+                int first_frame,
+                int num_frames,
+                float aspect,
+                score_segments& out);
+
+#endif
@@ -45,9 +45,43 @@ SOFTWARE.
 
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
 #include <math.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _MSC_VER
+#include <sys/resource.h>
+#endif
 
+#include "bench.h"
+#include "decoder.h"
+#include "farm.h"
+#include "font_atlas.h"
+#include "frame_cache.h"
+#include "gif.h"
+#include "headless.h"
+#include "line_transform.h"
+#include "profiler.h"
+#include "raster.h"
+#include "readback.h"
+#include "render.h"
+#include "render_server.h"
+#include "score.h"
 #include "shader.h"
+#include "shm_ring.h"
+#include "shape_library.h"
+#include "sim_clock.h"
+#include "startup_cache.h"
+#include "svg.h"
+#include "thread_pool.h"
+#include "time_histogram.h"
+#include "timeline.h"
+#include "ui_render.h"
+#include "wall.h"
 
 static GLFWwindow* window;
 static GLuint fontTex;
@@ -57,62 +91,62 @@ static int sourceWidth	= 300;
 static int sourceHeight	= 150;
 static int targetScale 	= 2;
 
+// UI drawing, collated into one streamed vertex buffer if the GL can,
+// otherwise ImGui's example fixed function way
+static ui_renderer uiRenderer;
+static bool useCollatedUi = false;
+static ui_render_stats uiStats;
+
+// Set by the GLFW callbacks, so a paused window that's gone idle knows to
+// draw again
+static bool uiEvent = false;
+// Frames drawn after the last input before a paused window goes idle, for
+// ImGui's hover and active states to catch up
+static const int UI_SETTLE_FRAMES = 3;
+// Longest an idle window sleeps between looking for input
+static const double IDLE_WAIT_SECONDS = 0.5;
+
+// Phases of getting from main to the first frame, each timed from the end
+// of the one before
+enum startup_phase {
+	STARTUP_GL,				// the window or headless context, and GLEW
+	STARTUP_FONT,			// ImGui and its font texture
+	STARTUP_RENDERERS,		// everything else drawn with, and its shaders
+	STARTUP_FIRST_FRAME,	// up to the first frame swapped or rendered
+	NUM_STARTUP_PHASES,
+};
+
+static const char* const STARTUP_PHASE_NAMES[NUM_STARTUP_PHASES] = {
+	"GL", "font", "renderers", "first frame"};
+
+struct startup_times {
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point since;
+	double seconds[NUM_STARTUP_PHASES];
+	double total;
+	bool font_cached;
+};
+
+static startup_times startupTimes;
+
 // This is the main rendering function that you have to implement and provide to ImGui (via setting up 'RenderDrawListsFn' in the ImGuiIO structure)
 // If text or lines are blurry when integrating ImGui in your engine:
 // - in your Render function, try translating your projection matrix by (0.5f,0.5f) or (0.375f,0.375f)
 // - try adjusting ImGui::GetIO().PixelCenterOffset to 0.5f or 0.375f
 static void ImImpl_RenderDrawLists(ImDrawList** const cmd_lists, int cmd_lists_count)
 {
-	if (cmd_lists_count == 0)
-		return;
-
-	// We are using the OpenGL fixed pipeline to make the example code simpler to read!
-	// A probable faster way to render would be to collate all vertices from all cmd_lists into a single vertex buffer.
-	// Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled, vertex/texcoord/color pointers.
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_SCISSOR_TEST);
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_COLOR_ARRAY);
-
-	// Setup texture
-	glBindTexture(GL_TEXTURE_2D, fontTex);
-	glEnable(GL_TEXTURE_2D);
-
-	// Setup orthographic projection matrix
+	profile_scope scope("draw UI lists");
+	gpu_profile_scope gpu_scope("UI");
 	const float width = ImGui::GetIO().DisplaySize.x;
 	const float height = ImGui::GetIO().DisplaySize.y;
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	glOrtho(0.0f, width, height, 0.0f, -1.0f, +1.0f);
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-
-	// Render command lists
-	for (int n = 0; n < cmd_lists_count; n++)
-	{
-		const ImDrawList* cmd_list = cmd_lists[n];
-		const unsigned char* vtx_buffer = (const unsigned char*)cmd_list->vtx_buffer.begin();
-		glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), (void*)(vtx_buffer));
-		glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), (void*)(vtx_buffer+8));
-		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImDrawVert), (void*)(vtx_buffer+16));
-
-		int vtx_offset = 0;
-		const ImDrawCmd* pcmd_end = cmd_list->commands.end();
-		for (const ImDrawCmd* pcmd = cmd_list->commands.begin(); pcmd != pcmd_end; pcmd++)
-		{
-			glScissor((int)pcmd->clip_rect.x, (int)(height - pcmd->clip_rect.w), (int)(pcmd->clip_rect.z - pcmd->clip_rect.x), (int)(pcmd->clip_rect.w - pcmd->clip_rect.y));
-			glDrawArrays(GL_TRIANGLES, vtx_offset, pcmd->vtx_count);
-			vtx_offset += pcmd->vtx_count;
-		}
+	if (useCollatedUi) {
+		render_ui_lists(uiRenderer, cmd_lists, cmd_lists_count, width, height);
+		uiStats = uiRenderer.stats;
+	}
+	else {
+		render_ui_lists_fixed(cmd_lists, cmd_lists_count, width, height,
+			fontTex, uiStats);
 	}
-	glDisable(GL_SCISSOR_TEST);
-	glDisableClientState(GL_COLOR_ARRAY);
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-	glDisableClientState(GL_VERTEX_ARRAY);
 }
 
 // NB: ImGui already provide OS clipboard support for Windows so this isn't needed if you are using Windows only.
@@ -157,6 +191,18 @@ static void glfw_mouse_button_callback(
 {
 	if (action == GLFW_PRESS && button >= 0 && button < 2)
 		mousePressed[button] = true;
+	uiEvent = true;
+}
+
+static void glfw_cursor_pos_callback(GLFWwindow* window, double x, double y)
+{
+	uiEvent = true;
+}
+
+// The window was uncovered or needs drawing again for some other reason
+static void glfw_window_refresh_callback(GLFWwindow* window)
+{
+	uiEvent = true;
 }
 
 static void glfw_scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
@@ -164,6 +210,7 @@ static void glfw_scroll_callback(GLFWwindow* window, double xoffset, double yoff
 	ImGuiIO& io = ImGui::GetIO();
 	io.MouseWheel = (yoffset != 0.0f) ? yoffset > 0.0f ? 1 : - 1 : 0;
 	// Mouse wheel: -1,0,+1
+	uiEvent = true;
 }
 
 static void glfw_key_callback(
@@ -182,16 +229,45 @@ static void glfw_key_callback(
 	io.KeyShift = (mods & GLFW_MOD_SHIFT) != 0;
 	if (action == GLFW_RELEASE && (key == GLFW_KEY_ESCAPE || key == GLFW_KEY_Q))
 		glfwSetWindowShouldClose(window, true);
+	uiEvent = true;
 }
 
 static void glfw_char_callback(GLFWwindow* window, unsigned int c)
 {
 	if (c > 0 && c < 0x10000)
 		ImGui::GetIO().AddInputCharacter((unsigned short)c);
+	uiEvent = true;
+}
+
+// The phase that's just ended, and the whole startup so far
+static void end_startup_phase(startup_phase phase)
+{
+	const auto now = std::chrono::steady_clock::now();
+	startupTimes.seconds[phase] =
+		std::chrono::duration<double>(now - startupTimes.since).count();
+	startupTimes.total =
+		std::chrono::duration<double>(now - startupTimes.start).count();
+	startupTimes.since = now;
+}
+
+// Each phase that happened, in ms, and where the shaders came from
+static void print_startup_times(std::ostream& report)
+{
+	report << "started in " << startupTimes.total * 1000.0 << " ms (";
+	const char* separator = "";
+	for (int i = 0 ; i < NUM_STARTUP_PHASES ; ++i)
+		if (startupTimes.seconds[i] > 0.0) {
+			report << separator << STARTUP_PHASE_NAMES[i] << " "
+				<< startupTimes.seconds[i] * 1000.0;
+			separator = ", ";
+		}
+	report << "), " << shader_stats.cached << " shader programs cached, "
+		<< shader_stats.compiled << " compiled in "
+		<< shader_stats.seconds * 1000.0 << " ms\n";
 }
 
 // OpenGL code based on http://open.gl tutorials
-void InitGL()
+void InitGL(int width, int height)
 {
 	glfwSetErrorCallback(glfw_error_callback);
 
@@ -200,8 +276,8 @@ void InitGL()
 
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 	window = glfwCreateWindow(
-		sourceWidth * targetScale, 
-		sourceHeight * targetScale,
+		width,
+		height,
 		"vrviz",
 		NULL,
 		NULL);
@@ -210,6 +286,8 @@ void InitGL()
 	glfwSetMouseButtonCallback(window, glfw_mouse_button_callback);
 	glfwSetScrollCallback(window, glfw_scroll_callback);
 	glfwSetCharCallback(window, glfw_char_callback);
+	glfwSetCursorPosCallback(window, glfw_cursor_pos_callback);
+	glfwSetWindowRefreshCallback(window, glfw_window_refresh_callback);
 
 	glewInit();
 }
@@ -259,13 +337,15 @@ void InitImGui()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
 #if 1
-	// Default font (embedded in code)
-	const void* png_data;
-	unsigned int png_size;
-	ImGui::GetDefaultFontData(NULL, NULL, &png_data, &png_size);
-	int tex_x, tex_y, tex_comp;
-	void* tex_data = stbi_load_from_memory((const unsigned char*)png_data, (int)png_size, &tex_x, &tex_y, &tex_comp, 0);
-	IM_ASSERT(tex_data != NULL);
+	// Default font (embedded in code), decoded on the first run only
+	font_atlas atlas;
+	std::string errors;
+	if (!load_font_atlas(atlas, errors)) {
+		std::cerr << errors;
+		exit(1);
+	}
+	startupTimes.font_cached = atlas.cached;
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlas.width, atlas.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &atlas.pixels[0]);
 #else
 	// Custom font from filesystem
 	io.Font = new ImBitmapFont();
@@ -284,10 +364,10 @@ void InitImGui()
 			io.FontTexUvForWhite = ImVec2((float)(tex_data_off % tex_x)/(tex_x), (float)(tex_data_off / tex_x)/(tex_y));
 			break;
 		}
-#endif
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_x, tex_y, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_data);
 	stbi_image_free(tex_data);
+#endif
 }
 
 void UpdateImGui()
@@ -312,64 +392,1043 @@ void UpdateImGui()
 	ImGui::NewFrame();
 }
 
-void increment_score(int* digits, int num_digits) {
-	for (int i = 0 ; i < num_digits ; ++i) {
-		if (i == num_digits - 1 || digits[i] < digits[i+1]) {
-			++digits[i];
-			break;
+// CPU time the whole process has used so far, in seconds
+static double process_cpu_seconds()
+{
+#ifdef _MSC_VER
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0.0;
+	const unsigned long long ticks =
+		((unsigned long long)kernel.dwHighDateTime << 32 | kernel.dwLowDateTime) +
+		((unsigned long long)user.dwHighDateTime << 32 | user.dwLowDateTime);
+	return ticks * 1e-7;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage))
+		return 0.0;
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+		(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+// Times the window keeps histograms of
+enum frame_time {
+	TIME_FRAME,			// from one swap to the next
+	TIME_OFFSCREEN,
+	TIME_BLIT,
+	TIME_UI,
+	TIME_SWAP,
+	NUM_FRAME_TIMES,
+};
+
+static const char* const FRAME_TIME_NAMES[NUM_FRAME_TIMES] = {
+	"frame", "offscreen", "blit", "UI", "swap"};
+
+// Percentiles of each time over the sliding window, and a sparkline of
+// frame times
+static void show_frame_times(const std::vector<time_histogram>& times)
+{
+	for (const time_histogram& histogram : times)
+		ImGui::Text("%-9s p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms",
+			histogram.name, window_percentile(histogram, 50.0),
+			window_percentile(histogram, 95.0),
+			window_percentile(histogram, 99.0), window_max(histogram));
+	const time_histogram& frame = times[TIME_FRAME];
+	if (!frame.window_size)
+		return;
+	const bool full = frame.window_size == HISTOGRAM_WINDOW;
+	char overlay[32];
+	snprintf(overlay, sizeof(overlay), "%.2f ms",
+		frame.recent[(frame.next + HISTOGRAM_WINDOW - 1) % HISTOGRAM_WINDOW]);
+	ImGui::PlotLines("frame", frame.recent, frame.window_size,
+		full ? frame.next : 0, overlay, 0.f, FLT_MAX, ImVec2(0, 40));
+}
+
+// How hard the window is working, measured a second at a time
+struct window_load {
+	std::chrono::steady_clock::time_point start;
+	double cpu_start;
+	int windows_drawn;		// so far this second
+	int scores_drawn;
+	// For the last whole second
+	float cpu_percent;		// of one core
+	float windows_per_second;
+	float scores_per_second;
+};
+
+static void start_window_load(window_load& load)
+{
+	load = window_load();
+	load.start = std::chrono::steady_clock::now();
+	load.cpu_start = process_cpu_seconds();
+}
+
+// Finish the second if it's up
+static void update_window_load(window_load& load)
+{
+	const auto now = std::chrono::steady_clock::now();
+	const double seconds =
+		std::chrono::duration<double>(now - load.start).count();
+	if (seconds < 1.0)
+		return;
+	const double cpu = process_cpu_seconds();
+	load.cpu_percent = (float)(100.0 * (cpu - load.cpu_start) / seconds);
+	load.windows_per_second = (float)(load.windows_drawn / seconds);
+	load.scores_per_second = (float)(load.scores_drawn / seconds);
+	load.start = now;
+	load.cpu_start = cpu;
+	load.windows_drawn = 0;
+	load.scores_drawn = 0;
+}
+
+// Read a score given as a string of digits, least significant first
+static void parse_digits(const char* text, int* digits, int num_digits)
+{
+	for (int i = 0 ; i < num_digits && text[i] ; ++i)
+		digits[i] = std::max(std::min(text[i] - '0', NUM_SHAPES-1), 0);
+}
+
+// What --output writes
+enum output_type {
+	OUTPUT_RGB,
+	OUTPUT_Y4M,
+	OUTPUT_GIF,
+};
+
+// Settings that come from the command line
+struct app_options {
+	int digits[NUM_DIGITS];
+	bool should_auto_increment;
+	int headless_frames;	// render this many frames with no window
+	bool use_cpu;			// headless rendering with the CPU rasterizer
+	bool compare;			// check the CPU rasterizer against GL
+	bool decode;			// check the decoder reads headless frames back
+	bool no_instancing;		// draw a digit at a time even if GL can do more
+	int threads;			// for CPU work, 0 means one per hardware thread
+	const char* bench;		// benchmark to run instead of the viewer
+	const char* timeline;	// capture format to read from stdin and decode
+	int capture_width;		// size of raw RGB captures, or of the wall
+	int capture_height;
+	const char* wall;		// file of scores to show all at once, - for stdin
+	bool verify_score;		// check score arithmetic over every score
+	int frame_cache_mb;		// memory for reusing rendered frames, 0 for none
+	bool verify_transform;	// check the CPU line transform against line.vert
+	long long farm_frames;	// frames to render offline, on every core
+	const char* output;		// file for rendered frames, - for stdout
+	int readback_ring;		// pixel buffers to read GL frames back through
+	output_type output_format;
+	const char* shm;		// shared memory ring to publish frames to
+	long long svg_frames;	// frames to export as vector graphics
+	bool uncapped;			// step the window's animation a frame a draw
+	const char* trace;		// file to write a Chrome trace of frames to
+	int trace_frames;		// frames the trace keeps, the last ones
+	const char* histograms;	// file to write frame time histograms to
+	bool no_cache;			// decode and compile everything at startup
+	const char* shapes;		// shape library to draw a glyph set from
+	int glyph_set;			// which of its sets
+	const char* compile_shapes[2];	// shape text to compile, and where to
+	const char* bench_json;	// file to write benchmark results to
+	const char* serve;		// Unix socket to render frames on request on
+};
+
+// Frame rate y4m output claims, a frame per simulation step
+static const int OUTPUT_FPS = SIM_FRAMES_PER_SECOND;
+// Memory --serve keeps rendered frames in at each scale, unless
+// --frame-cache says otherwise
+static const int SERVER_FRAME_CACHE_MB = 256;
+
+static void usage()
+{
+	std::cerr << "usage: vrviz [options]\n"
+		"  --digits 0123456   starting score, least significant digit first\n"
+		"  --score N          starting score, as an integer\n"
+		"  --auto-increment   count the score up every 30 frames\n"
+		"  --trace FILE       write a Chrome trace of the last frames' phases\n"
+		"  --trace-frames N   frames the trace keeps (default: 300, at most\n"
+		"                     100000)\n"
+		"  --histograms FILE  write frame and phase time histograms on exit\n"
+		"  --shapes FILE      draw the digits with a glyph set from a shape\n"
+		"                     library made by --compile-shapes\n"
+		"  --glyph-set N      which of the library's glyph sets (default 0)\n"
+		"  --compile-shapes TEXT LIBRARY\n"
+		"                     compile shapes written as text into a library\n"
+		"  --no-cache         don't keep the decoded font and linked shaders\n"
+		"                     between runs (VRVIZ_CACHE_DIR says where)\n"
+		"  --uncapped         draw the window as fast as possible, a frame\n"
+		"                     of animation each, rather than at 60 a second\n"
+		"  --headless N       render N frames offscreen with no window\n"
+		"  --cpu              render headless frames with the CPU rasterizer\n"
+		"  --compare          check CPU rasterizer frames against GL ones\n"
+		"  --decode           check headless frames decode back to the score\n"
+		"  --no-instancing    draw one digit at a time instead of one score\n"
+		"  --threads N        threads for CPU work (default: all)\n"
+		"  --bench NAME       run a benchmark (decode, farm, transform,\n"
+		"                     score, wall, ui, histogram, startup, shapes,\n"
+		"                     frame, imgui, serve, or all)\n"
+		"  --bench-json FILE  also write the benchmarks' results as JSON\n"
+		"  --farm N           render N frames offline on every thread, with\n"
+		"                     the score counting up if --auto-increment\n"
+		"  --svg N            export N frames as SVG to --output, one file\n"
+		"                     per frame if it has a pattern like %05d.svg\n"
+		"  --output FILE      write frames from --farm, --headless or the\n"
+		"                     window to FILE, - for stdout, or a named pipe\n"
+		"  --output-format F  rgb (raw, the default), y4m or gif\n"
+		"  --shm NAME         publish --headless or window frames to a\n"
+		"                     shared memory ring (like /vrviz) instead\n"
+		"  --readback-ring N  read GL frames back through N pixel buffers\n"
+		"                     (default 3, at most 16), 0 to wait for each frame\n"
+		"  --frame-cache MB   keep up to MB of rendered frames to reuse when\n"
+		"                     a score comes round to the same frame again\n"
+		"  --serve SOCKET     render frames on request over a Unix socket\n"
+		"                     (see source/render_server.h) until stopped\n"
+		"  --verify-transform check the batched CPU line transform against\n"
+		"                     line.vert on headless GL\n"
+		"  --verify-score     check score conversion and arithmetic against\n"
+		"                     counting up, for every possible score\n"
+		"  --timeline FORMAT  decode a y4m or rgb capture from stdin into a\n"
+		"                     timeline of score changes on stdout\n"
+		"  --size WxH         size of rgb captures (default 300x150), or of\n"
+		"                     the wall (default 1280x720)\n"
+		"  --wall FILE        show every score listed in FILE (- for stdin)\n"
+		"                     at once, one per line as with --digits,\n"
+		"                     optionally followed by a phase in frames\n";
+	exit(1);
+}
+
+// A count from "least" to "most", like --headless N, or a usage error
+static long long parse_count(const char* text, long long least,
+	long long most)
+{
+	char* end;
+	errno = 0;
+	const long long count = strtoll(text, &end, 10);
+	if (end == text || *end || errno || count < least || count > most)
+		usage();
+	return count;
+}
+
+static void parse_options(int argc, char** argv, app_options& options)
+{
+	for (int i = 1 ; i < argc ; ++i) {
+		const bool has_value = i+1 < argc;
+		if (!strcmp(argv[i], "--digits") && has_value)
+			parse_digits(argv[++i], options.digits, NUM_DIGITS);
+		else if (!strcmp(argv[i], "--auto-increment"))
+			options.should_auto_increment = true;
+		else if (!strcmp(argv[i], "--headless") && has_value)
+			options.headless_frames = parse_count(argv[++i], 1, INT_MAX);
+		else if (!strcmp(argv[i], "--cpu"))
+			options.use_cpu = true;
+		else if (!strcmp(argv[i], "--compare"))
+			options.compare = true;
+		else if (!strcmp(argv[i], "--decode"))
+			options.decode = true;
+		else if (!strcmp(argv[i], "--no-instancing"))
+			options.no_instancing = true;
+		else if (!strcmp(argv[i], "--uncapped"))
+			options.uncapped = true;
+		else if (!strcmp(argv[i], "--trace") && has_value)
+			options.trace = argv[++i];
+		else if (!strcmp(argv[i], "--trace-frames") && has_value)
+			options.trace_frames = parse_count(argv[++i], 1, 100000);
+		else if (!strcmp(argv[i], "--histograms") && has_value)
+			options.histograms = argv[++i];
+		else if (!strcmp(argv[i], "--no-cache"))
+			options.no_cache = true;
+		else if (!strcmp(argv[i], "--shapes") && has_value)
+			options.shapes = argv[++i];
+		else if (!strcmp(argv[i], "--glyph-set") && has_value)
+			options.glyph_set = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--compile-shapes") && i+2 < argc) {
+			options.compile_shapes[0] = argv[++i];
+			options.compile_shapes[1] = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--threads") && has_value)
+			options.threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--bench") && has_value)
+			options.bench = argv[++i];
+		else if (!strcmp(argv[i], "--bench-json") && has_value)
+			options.bench_json = argv[++i];
+		else if (!strcmp(argv[i], "--serve") && has_value)
+			options.serve = argv[++i];
+		else if (!strcmp(argv[i], "--timeline") && has_value)
+			options.timeline = argv[++i];
+		else if (!strcmp(argv[i], "--size") && has_value) {
+			char extra;
+			if (sscanf(argv[++i], "%dx%d%c", &options.capture_width,
+				&options.capture_height, &extra) != 2 ||
+				options.capture_width <= 0 || options.capture_height <= 0)
+				usage();
+		}
+		else if (!strcmp(argv[i], "--wall") && has_value)
+			options.wall = argv[++i];
+		else if (!strcmp(argv[i], "--score") && has_value) {
+			if (!int_to_score(atoi(argv[++i]), options.digits))
+				usage();
+		}
+		else if (!strcmp(argv[i], "--verify-score"))
+			options.verify_score = true;
+		else if (!strcmp(argv[i], "--verify-transform"))
+			options.verify_transform = true;
+		else if (!strcmp(argv[i], "--farm") && has_value)
+			options.farm_frames = parse_count(argv[++i], 1, LLONG_MAX);
+		else if (!strcmp(argv[i], "--svg") && has_value)
+			options.svg_frames = parse_count(argv[++i], 1, LLONG_MAX);
+		else if (!strcmp(argv[i], "--output") && has_value)
+			options.output = argv[++i];
+		else if (!strcmp(argv[i], "--output-format") && has_value) {
+			++i;
+			if (!strcmp(argv[i], "rgb"))
+				options.output_format = OUTPUT_RGB;
+			else if (!strcmp(argv[i], "y4m"))
+				options.output_format = OUTPUT_Y4M;
+			else if (!strcmp(argv[i], "gif"))
+				options.output_format = OUTPUT_GIF;
+			else
+				usage();
+		}
+		else if (!strcmp(argv[i], "--shm") && has_value)
+			options.shm = argv[++i];
+		else if (!strcmp(argv[i], "--readback-ring") && has_value)
+			options.readback_ring = parse_count(argv[++i], 0, 16);
+		else if (!strcmp(argv[i], "--frame-cache") && has_value)
+			options.frame_cache_mb = atoi(argv[++i]);
+		else
+			usage();
+	}
+}
+
+// Open --output, or stdout for -
+static FILE* open_output(const app_options& options)
+{
+#ifdef SIGPIPE
+	// A reader going away should fail the write, not kill us
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	if (!options.output || !strcmp(options.output, "-"))
+		return stdout;
+	FILE* out = fopen(options.output, "wb");
+	if (!out)
+		std::cerr << "failed to open " << options.output << "\n";
+	return out;
+}
+
+static void close_output(FILE* out)
+{
+	if (out && out != stdout)
+		fclose(out);
+}
+
+// Set up wherever --shm or --output sends rendered frames, if anywhere.
+// Returns false and gives error messages in "errors" on failure.
+static bool open_frame_output(const app_options& options,
+	int width, int height, FILE*& out, shm_ring_sink& ring,
+	std::string& errors)
+{
+	out = 0;
+	if (options.shm)
+		return ring.open(options.shm, width, height, errors);
+	if (options.output)
+		out = open_output(options);
+	return out || !options.output;
+}
+
+// Pick which of the sinks --output or --shm frames go to
+static frame_sink& choose_sink(const app_options& options,
+	stream_sink& stream, gif_sink& gif, shm_ring_sink& ring)
+{
+	if (options.shm)
+		return ring;
+	if (options.output_format == OUTPUT_GIF)
+		return gif;
+	return stream;
+}
+
+static stream_format get_stream_format(const app_options& options)
+{
+	return options.output_format == OUTPUT_Y4M ? STREAM_Y4M : STREAM_RGB;
+}
+
+static void print_gif_stats(std::ostream& out, const gif_sink& gif)
+{
+	const gif_stats& stats = gif.get_stats();
+	const double frames = (double)std::max(stats.frames, 1LL);
+	out << "gif: " << stats.frames << " frames, " << stats.bytes / frames
+		<< " bytes/frame, " << stats.changed_pixels / frames
+		<< " changed pixels/frame, encoded at " << stats.frames / stats.seconds
+		<< " frames/sec\n";
+}
+
+static void print_readback_stats(std::ostream& out, const pbo_readback& readback)
+{
+	const readback_stats& stats = readback.stats;
+	const double frames = (double)std::max(stats.frames, 1LL);
+	out << "readback (" << readback.buffers.size() << " buffer ring): "
+		<< stats.frames << " frames, latency " << stats.latency_frames / frames
+		<< " frames / " << 1000.0 * stats.latency_seconds / frames
+		<< " ms, stalled " << 1000.0 * stats.stall_seconds / frames
+		<< " ms/frame\n";
+}
+
+// Write --trace, if it was asked for
+static void write_trace(const app_options& options, std::ostream& report)
+{
+	if (!options.trace)
+		return;
+	std::string errors;
+	if (write_chrome_trace(options.trace, errors))
+		report << "wrote a trace of the last " << options.trace_frames
+			<< " frames to " << options.trace << "\n";
+	else
+		std::cerr << errors;
+}
+
+// Write --histograms, if it was asked for
+static void write_histograms(const app_options& options,
+	const std::vector<time_histogram>& histograms, std::ostream& report)
+{
+	if (!options.histograms)
+		return;
+	std::string errors;
+	if (write_time_histograms(options.histograms, &histograms[0],
+		(int)histograms.size(), errors))
+		report << "wrote frame time histograms to " << options.histograms
+			<< "\n";
+	else
+		std::cerr << errors;
+}
+
+static void print_frame_cache_stats(const frame_cache& cache)
+{
+	const frame_cache_stats& stats = cache.stats;
+	std::cout << "frame cache: " << stats.hits << " hits, " << stats.misses
+		<< " misses, " << stats.evictions << " evictions, "
+		<< frame_cache_bytes(cache) / 1048576.0 << " MB of "
+		<< cache.max_frames * (size_t)cache.frame_size / 1048576.0
+		<< " MB used\n";
+}
+
+// Render and report run_headless' frames, with GL already started if it's
+// in use
+static int render_headless(app_options& options, score_renderer& renderer,
+	const gl_call_counts& setup_calls, std::ostream& report)
+{
+	const int num_frames = options.headless_frames;
+	int (&digits)[NUM_DIGITS] = options.digits;
+	const bool use_gl = !options.use_cpu || options.compare;
+	const bool use_cpu = options.use_cpu || options.compare;
+	std::string errors;
+	thread_pool pool(options.threads);
+	cpu_rasterizer rasterizer;
+	init_cpu_rasterizer(rasterizer, sourceWidth, sourceHeight, &pool);
+	std::vector<unsigned char> cpu_frame(sourceWidth * sourceHeight * 3);
+	std::vector<unsigned char> gl_frame(cpu_frame.size());
+	float worst_match = 1.f;
+	int worst_frame = 0;
+	score_decoder decoder;
+	init_score_decoder(decoder, sourceWidth, sourceHeight);
+	int decoded_right = 0;
+	double decode_seconds = 0.0;
+	// Comparing needs both renderers to actually render, and writing
+	// frames out needs them in order through the readback ring
+	const bool publishing = options.output || options.shm;
+	const bool use_cache = options.frame_cache_mb > 0 && !options.compare &&
+		!publishing;
+	frame_cache cache;
+	init_frame_cache(cache, (int)cpu_frame.size(),
+		(size_t)options.frame_cache_mb << 20);
+	// Frames written out come from GL if it's rendering them
+	FILE* out;
+	shm_ring_sink ring;
+	pbo_readback readback;
+	if (!open_frame_output(options, sourceWidth, sourceHeight, out, ring,
+		errors) || (publishing && use_gl && !init_pbo_readback(readback,
+		sourceWidth, sourceHeight, options.readback_ring, errors))) {
+		std::cerr << errors;
+		return 1;
+	}
+	stream_sink stream(out, get_stream_format(options), OUTPUT_FPS);
+	gif_sink gif(out, OUTPUT_FPS, options.threads);
+	frame_sink& sink = choose_sink(options, stream, gif, ring);
+
+	if (use_gl)
+		report << "rendering " << num_frames << " frames with "
+			<< glGetString(GL_RENDERER) << "\n";
+	if (use_cpu)
+		report << "rendering " << num_frames << " frames with the CPU "
+			"rasterizer on " << pool.size() << " threads\n";
+	// Frame and rendering times, for --histograms
+	std::vector<time_histogram> times(2);
+	init_time_histogram(times[0], "frame");
+	init_time_histogram(times[1], "render");
+	const auto start = std::chrono::steady_clock::now();
+	auto frame_start = start;
+	for (int frame_count = 0 ; frame_count < num_frames ; ++frame_count) {
+		next_profile_frame();
+		step_score(digits, frame_count, options.should_auto_increment);
+		const int phase = frame_count % ANIMATION_PERIOD;
+		// Cached frames stand in for whichever renderer is in use
+		std::vector<unsigned char>& frame = use_cpu ? cpu_frame : gl_frame;
+		const unsigned char *cached = use_cache ?
+			find_frame(cache, digits, frame_count) : 0;
+		if (cached) {
+			memcpy(&frame[0], cached, frame.size());
 		}
 		else {
-			digits[i] = 0;
+			auto render_start = std::chrono::steady_clock::now();
+			if (use_gl) {
+				profile_scope scope("render");
+				gpu_profile_scope gpu_scope("render");
+				gl_calls = gl_call_counts();
+				render_score(renderer, digits, NUM_DIGITS, (float)phase);
+				glFlush();
+			}
+			if (use_cpu) {
+				profile_scope scope("rasterize");
+				rasterize_score(rasterizer, digits, NUM_DIGITS, phase,
+					&cpu_frame[0]);
+			}
+			add_lap(times[1], render_start);
+			if (use_gl && (options.compare || options.decode || use_cache))
+				glReadPixels(0, 0, sourceWidth, sourceHeight, GL_RGB,
+					GL_UNSIGNED_BYTE, &gl_frame[0]);
+			if (use_cache)
+				memcpy(store_frame(cache, digits, frame_count), &frame[0],
+					frame.size());
+		}
+		if (publishing) {
+			profile_scope scope("publish");
+			sink.note_score(frame_count, digits, NUM_DIGITS);
+			const bool written = use_gl ?
+				queue_readback(readback, frame_count, sink, errors) :
+				sink.write_frame(&cpu_frame[0], sourceWidth, sourceHeight,
+					frame_count, errors);
+			if (!written) {
+				std::cerr << errors;
+				return 1;
+			}
+		}
+		if (options.compare) {
+			const float match = frame_match_fraction(&cpu_frame[0],
+				&gl_frame[0], sourceWidth, sourceHeight);
+			if (match < worst_match) {
+				worst_match = match;
+				worst_frame = frame_count;
+			}
+		}
+		if (options.decode) {
+			const auto decode_start = std::chrono::steady_clock::now();
+			decode_result result;
+			decode_score(decoder, use_gl ? &gl_frame[0] : &cpu_frame[0], -1,
+				result);
+			decode_seconds += std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - decode_start).count();
+			if (!memcmp(result.digits, digits, sizeof(result.digits)))
+				++decoded_right;
 		}
-	}	
+		add_lap(times[0], frame_start);
+		if (frame_count == 0)
+			end_startup_phase(STARTUP_FIRST_FRAME);
+	}
+	if (publishing && ((use_gl && !flush_readbacks(readback, sink, errors)) ||
+		!sink.finish(errors))) {
+		std::cerr << errors;
+		return 1;
+	}
+	close_output(out);
+	if (use_gl)
+		glFinish();
+	const double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	report << num_frames << " frames in " << seconds << " s ("
+		<< num_frames / seconds << " frames/sec)\n";
+	print_startup_times(report);
+	write_trace(options, report);
+	write_histograms(options, times, report);
+	if (publishing && use_gl)
+		print_readback_stats(report, readback);
+	if (&sink == &gif)
+		print_gif_stats(report, gif);
+	if (use_gl) {
+		report << "GL per frame: " << gl_calls.draw_calls << " draws, "
+			<< gl_calls.uniform_lookups << " uniform lookups ("
+			<< setup_calls.uniform_lookups << " when starting), "
+			<< gl_calls.state_changes << " state changes ("
+			<< (renderer.use_instancing ? "instanced" : "a digit at a time")
+			<< ")\n";
+	}
+	if (use_cache)
+		print_frame_cache_stats(cache);
+	if (options.decode)
+		report << "decoded " << decoded_right << " of " << num_frames
+			<< " frames back to the right score, at "
+			<< num_frames / decode_seconds << " frames/sec\n";
+	if (options.compare) {
+		// Anti-aliasing moves the odd pixel, but lines should line up
+		const float tolerance = 0.95f;
+		report << "worst CPU/GL match " << worst_match * 100.f
+			<< "% of lit pixels, at frame " << worst_frame << "\n";
+		if (worst_match < tolerance) {
+			std::cerr << "CPU rasterizer doesn't match GL\n";
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Render frames offscreen as fast as possible, with no window to present to,
+// and report the throughput. Frames come from GL on a surfaceless context,
+// from the CPU rasterizer, or from both when comparing them.
+static int run_headless(app_options& options)
+{
+	const bool use_gl = !options.use_cpu || options.compare;
+	// Frames might be going to stdout
+	std::ostream& report = options.output && !strcmp(options.output, "-") ?
+		std::cerr : std::cout;
+	std::string errors;
+	score_renderer renderer;
+	gl_call_counts setup_calls = gl_call_counts();
+	if (use_gl) {
+		if (!init_headless_gl(errors)) {
+			std::cerr << "failed to init headless GL\n" << errors;
+			return 1;
+		}
+		end_startup_phase(STARTUP_GL);
+		if (!init_score_renderer(renderer, sourceWidth, sourceHeight, errors)) {
+			std::cerr << "failed to init renderer\n" << errors;
+			shutdown_headless_gl();
+			return 1;
+		}
+		end_startup_phase(STARTUP_RENDERERS);
+		// Uniforms are looked up once here rather than every frame
+		setup_calls = gl_calls;
+		start_gpu_profiler();
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		if (options.no_instancing)
+			renderer.use_instancing = false;
+	}
+	// However it went, the context and its surfaces go here
+	const int result = render_headless(options, renderer, setup_calls,
+		report);
+	if (use_gl)
+		shutdown_headless_gl();
+	return result;
+}
+
+// Compile --compile-shapes' text into a library, and say what's in it
+static int run_compile_shapes(const app_options& options)
+{
+	std::string errors;
+	shape_library library;
+	if (!compile_shape_file(options.compile_shapes[0],
+		options.compile_shapes[1], errors) ||
+		!open_shape_library(library, options.compile_shapes[1], errors)) {
+		std::cerr << errors;
+		return 1;
+	}
+	std::cout << library.num_shapes << " shapes, "
+		<< num_shape_sets(library) << " glyph sets, " << library.size
+		<< " bytes\n";
+	close_shape_library(library);
+	return 0;
+}
+
+// The library --shapes draws from, mapped for as long as the program runs
+static shape_library shapeLibrary;
+
+static bool load_shapes(const app_options& options)
+{
+	std::string errors;
+	const auto start = std::chrono::steady_clock::now();
+	if (!open_shape_library(shapeLibrary, options.shapes, errors)) {
+		std::cerr << errors;
+		return false;
+	}
+	if (!use_shape_set(shapeLibrary, options.glyph_set)) {
+		std::cerr << options.shapes << " has no glyph set "
+			<< options.glyph_set << " (it has "
+			<< num_shape_sets(shapeLibrary) << ")\n";
+		return false;
+	}
+	std::cerr << "mapped " << shapeLibrary.num_shapes << " shapes ("
+		<< shapeLibrary.size / 1024.0 << " KB) from " << options.shapes
+		<< " in " << std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count() << " ms\n";
+	return true;
+}
+
+// Read the --wall list of scores
+static bool load_wall(const app_options& options, score_list& scores)
+{
+	const bool from_stdin = !strcmp(options.wall, "-");
+	FILE* in = from_stdin ? stdin : fopen(options.wall, "r");
+	std::string errors;
+	if (!in) {
+		std::cerr << "failed to open " << options.wall << "\n";
+		return false;
+	}
+	const bool success = read_score_list(in, scores, errors);
+	if (!from_stdin)
+		fclose(in);
+	if (!success) {
+		std::cerr << "failed to read " << options.wall << "\n" << errors;
+		return false;
+	}
+	return true;
+}
+
+static void wall_size(const app_options& options, int& width, int& height)
+{
+	width = options.capture_width ? options.capture_width : 1280;
+	height = options.capture_height ? options.capture_height : 720;
+}
+
+// Render a wall of scores offscreen and report the throughput
+static int run_headless_wall(const app_options& options)
+{
+	score_list scores;
+	if (!load_wall(options, scores))
+		return 1;
+	int width, height;
+	wall_size(options, width, height);
+	std::string errors;
+	if (!init_headless_gl(errors)) {
+		std::cerr << "failed to init headless GL\n" << errors;
+		return 1;
+	}
+	score_wall wall;
+	if (!init_score_wall(wall, width, height,
+		(float)sourceWidth/sourceHeight, errors)) {
+		std::cerr << "failed to init wall\n" << errors;
+		shutdown_headless_gl();
+		return 1;
+	}
+	set_wall_scores(wall, scores);
+	const int num_frames = options.headless_frames;
+	std::cout << "rendering " << num_frames << " frames of "
+		<< wall.num_scores << " scores (" << wall.columns << "x" << wall.rows
+		<< ") at " << width << "x" << height << " with "
+		<< glGetString(GL_RENDERER) << "\n";
+	const auto start = std::chrono::steady_clock::now();
+	for (int frame_count = 0 ; frame_count < num_frames ; ++frame_count) {
+		gl_calls = gl_call_counts();
+		render_wall(wall, (float)(frame_count % ANIMATION_PERIOD));
+		glFlush();
+	}
+	glFinish();
+	const double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	std::cout << num_frames << " frames in " << seconds << " s ("
+		<< 1000.0 * seconds / num_frames << " ms/frame)\n"
+		<< "GL per frame: " << gl_calls.draw_calls << " draws, "
+		<< gl_calls.state_changes << " state changes\n";
+	shutdown_headless_gl();
+	return 0;
+}
+
+// Check every score converts and adds up the same as counting up to it
+static int run_verify_score(const app_options& options)
+{
+	thread_pool pool(options.threads);
+	std::string errors;
+	const auto start = std::chrono::steady_clock::now();
+	const bool success = verify_scores(pool, errors);
+	const double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	if (!success) {
+		std::cerr << "score arithmetic is wrong\n" << errors;
+		return 1;
+	}
+	std::cout << "all " << NUM_SCORES << " scores convert, compare, add, "
+		"subtract and advance correctly (checked in " << seconds << " s on "
+		<< pool.size() << " threads)\n";
+	return 0;
+}
+
+// Check the batched CPU transform against the scalar one, and against the
+// positions line.vert gives on headless GL, over a whole animation for a
+// score using every shape
+static int run_verify_transform()
+{
+	const int digits[NUM_DIGITS] = {0, 1, 2, 3, 4, 5, 8};
+	const int other_digits[NUM_DIGITS] = {6, 7, 0, 3, 5, 8, 2};
+	const float aspect = (float)sourceWidth / sourceHeight;
+	// Clip space units, a hundredth of a pixel or so at 300x150
+	const float scalar_tolerance = 1e-5f;
+	const float gl_tolerance = 1e-4f;
+	shape_segments shapes;
+	build_shape_segments(shapes);
+	std::string errors;
+	const bool has_gl = init_headless_gl(errors);
+	score_renderer renderer;
+	vertex_capture capture;
+	const bool can_capture = has_gl &&
+		init_score_renderer(renderer, sourceWidth, sourceHeight, errors) &&
+		init_vertex_capture(capture, renderer, errors);
+	if (!can_capture)
+		std::cerr << "not checking against line.vert\n" << errors;
+
+	float worst_scalar = 0.f;
+	float worst_gl = 0.f;
+	std::vector<float> positions;
+	for (const int *score : {digits, other_digits}) {
+		score_segments out;
+		transform_score(shapes, score, NUM_DIGITS, 0, ANIMATION_PERIOD,
+			aspect, out);
+		for (int frame = 0 ; frame < ANIMATION_PERIOD ; ++frame) {
+			if (can_capture)
+				capture_score_vertices(capture, renderer, score, NUM_DIGITS,
+					frame, positions);
+			int segment = 0;
+			for (int i = 0 ; i < NUM_DIGITS ; ++i) {
+				const digit_transform t =
+					get_digit_transform(i, (float)frame);
+				const int shape = score[i];
+				for (int j = 0 ; j < shapes.segment_counts[shape] ;
+					++j, ++segment) {
+					const int k = shapes.first_segment[shape] + j;
+					const int at = segment * out.stride + frame;
+					const float batch[4] = {
+						out.x0[at], out.y0[at], out.x1[at], out.y1[at]};
+					float scalar[4];
+					apply_digit_transform(t, aspect, shapes.x0[k],
+						shapes.y0[k], scalar[0], scalar[1]);
+					apply_digit_transform(t, aspect, shapes.x1[k],
+						shapes.y1[k], scalar[2], scalar[3]);
+					// Written so that NaNs count as the worst
+					for (int c = 0 ; c < 4 ; ++c) {
+						const float scalar_difference =
+							fabsf(batch[c] - scalar[c]);
+						if (!(scalar_difference <= worst_scalar))
+							worst_scalar = scalar_difference;
+						if (can_capture) {
+							const float *position =
+								&positions[(segment * 2 + c / 2) * 4];
+							const float gl_difference = fabsf(batch[c] -
+								position[c % 2] / position[3]);
+							if (!(gl_difference <= worst_gl))
+								worst_gl = gl_difference;
+						}
+					}
+				}
+			}
+		}
+	}
+	if (has_gl)
+		shutdown_headless_gl();
+	std::cout << "largest difference from the scalar transform "
+		<< worst_scalar;
+	if (can_capture)
+		std::cout << ", from line.vert " << worst_gl;
+	std::cout << " (clip space, over " << ANIMATION_PERIOD << " frames)\n";
+	if (!(worst_scalar <= scalar_tolerance) ||
+		(can_capture && !(worst_gl <= gl_tolerance))) {
+		std::cerr << "CPU line transform doesn't match\n";
+		return 1;
+	}
+	return 0;
+}
+
+// Render a long run of frames offline as fast as the cores allow
+static int run_farm_frames(const app_options& options)
+{
+	FILE* out = open_output(options);
+	if (!out)
+		return 1;
+	farm_job job;
+	memcpy(job.digits, options.digits, sizeof(job.digits));
+	job.auto_increment = options.should_auto_increment;
+	job.first_frame = 0;
+	job.num_frames = options.farm_frames;
+	job.width = sourceWidth;
+	job.height = sourceHeight;
+	job.threads = options.threads;
+	stream_sink stream(out, get_stream_format(options), OUTPUT_FPS);
+	gif_sink gif(out, OUTPUT_FPS, options.threads);
+	frame_sink& sink = options.output_format == OUTPUT_GIF ?
+		(frame_sink&)gif : stream;
+	farm_stats stats;
+	std::string errors;
+	const bool success = run_farm(job, sink, stats, errors);
+	close_output(out);
+	if (!success) {
+		std::cerr << "failed to render frames\n" << errors;
+		return 1;
+	}
+	std::cerr << stats.frames << " frames on " << stats.threads
+		<< " threads in " << stats.seconds << " s ("
+		<< stats.frames / stats.seconds << " frames/sec, writer waited "
+		<< stats.writer_wait_seconds << " s)\n";
+	if (&sink == &gif)
+		print_gif_stats(std::cerr, gif);
+	return 0;
+}
+
+// Export frames as lines rather than pixels
+static int run_svg_export(const app_options& options)
+{
+	svg_job job;
+	memcpy(job.digits, options.digits, sizeof(job.digits));
+	job.auto_increment = options.should_auto_increment;
+	job.num_frames = options.svg_frames;
+	job.width = options.capture_width ? options.capture_width : sourceWidth;
+	job.height = options.capture_height ? options.capture_height :
+		sourceHeight;
+	job.frames_per_second = OUTPUT_FPS;
+	job.output = options.output ? options.output : "-";
+	svg_stats stats;
+	std::string errors;
+	if (!export_svg(job, stats, errors)) {
+		std::cerr << "failed to export SVG\n" << errors;
+		return 1;
+	}
+	std::cerr << stats.frames << " frames (" << stats.segments
+		<< " lines) in " << stats.seconds << " s ("
+		<< stats.frames / stats.seconds << " frames/sec, "
+		<< stats.bytes / (double)std::max(stats.frames, 1LL)
+		<< " bytes/frame)\n";
+	return 0;
+}
+
+// Turn a capture on stdin into a timeline of score changes on stdout
+static int run_timeline(const app_options& options)
+{
+	capture_format format;
+	if (!strcmp(options.timeline, "y4m"))
+		format = CAPTURE_Y4M;
+	else if (!strcmp(options.timeline, "rgb"))
+		format = CAPTURE_RGB;
+	else
+		usage();
+	timeline_stats stats;
+	std::string errors;
+	const bool success = run_timeline(stdin, format,
+		options.capture_width ? options.capture_width : sourceWidth,
+		options.capture_height ? options.capture_height : sourceHeight,
+		stdout, stats, errors);
+	if (!success) {
+		std::cerr << "failed to read capture\n" << errors;
+		return 1;
+	}
+	std::cerr << stats.frames << " frames (" << stats.decoded
+		<< " with a score), " << stats.events << " changes, in "
+		<< stats.seconds << " s: " << stats.frames / stats.seconds
+		<< " frames/sec, " << stats.frames / stats.seconds / 60.0
+		<< "x real time\n";
+	return 0;
+}
+
+// Render frames for other programs as they ask, until stopped
+static int run_server(const app_options& options)
+{
+	server_job job;
+	job.socket_path = options.serve;
+	job.width = sourceWidth;
+	job.height = sourceHeight;
+	job.frame_cache_mb = options.frame_cache_mb > 0 ?
+		options.frame_cache_mb : SERVER_FRAME_CACHE_MB;
+	job.use_instancing = !options.no_instancing;
+	std::cerr << "serving on " << options.serve << "\n";
+	server_stats stats;
+	std::string errors;
+	if (!run_render_server(job, stats, errors)) {
+		std::cerr << "failed to serve\n" << errors;
+		return 1;
+	}
+	std::cerr << stats.requests << " requests (" << stats.failed
+		<< " failed) from " << stats.clients << " clients in "
+		<< stats.seconds << " s, " << stats.frames << " frames sent, "
+		<< stats.frames_rendered << " rendered in " << stats.batches
+		<< " passes\n";
+	return 0;
 }
 
 // Application code
 int main(int argc, char** argv)
 {
-	const int NUM_DIGITS = 7;
-	int digits[NUM_DIGITS] = {0};
-	bool should_auto_increment = false;
+	startupTimes.start = startupTimes.since = std::chrono::steady_clock::now();
+	app_options options = app_options();
+	options.readback_ring = 3;
+	options.trace_frames = 300;
+	parse_options(argc, argv, options);
+	if (options.no_cache)
+		set_cache_dir("");
+	if (options.compile_shapes[0])
+		return run_compile_shapes(options);
+	if (options.shapes && !load_shapes(options))
+		return 1;
+	if (options.trace) {
+		start_profiler(options.trace_frames);
+		name_profile_thread("main");
+	}
+	if (options.bench) {
+		if (!run_benchmarks(options.bench, options.threads)) {
+			std::cerr << "no benchmark called " << options.bench << "\n";
+			return 1;
+		}
+		std::string errors;
+		if (options.bench_json &&
+			!write_bench_results(options.bench_json, errors)) {
+			std::cerr << errors;
+			return 1;
+		}
+		return 0;
+	}
+	if (options.verify_score)
+		return run_verify_score(options);
+	if (options.verify_transform)
+		return run_verify_transform();
+	if (options.farm_frames > 0)
+		return run_farm_frames(options);
+	if (options.svg_frames > 0)
+		return run_svg_export(options);
+	if (options.timeline)
+		return run_timeline(options);
+	if (options.serve)
+		return run_server(options);
+	if (options.headless_frames > 0)
+		return options.wall ? run_headless_wall(options)
+			: run_headless(options);
+	score_list wall_scores;
+	if (options.wall && !load_wall(options, wall_scores))
+		return 1;
+	int (&digits)[NUM_DIGITS] = options.digits;
+	bool should_auto_increment = options.should_auto_increment;
 	bool paused = false;
 	// Init helpers
-	InitGL();
+	int window_width = sourceWidth * targetScale;
+	int window_height = sourceHeight * targetScale;
+	if (options.wall)
+		wall_size(options, window_width, window_height);
+	InitGL(window_width, window_height);
+	end_startup_phase(STARTUP_GL);
 	InitImGui();
-	// Init shader
-	GLuint shader;
+	end_startup_phase(STARTUP_FONT);
 	std::string errors;
-	bool success = make_shader_program("line.vert", "line.frag", shader, errors);
-	if (!success) {
-		std::cerr << "failed to make shader\n" << errors;
+	start_gpu_profiler();
+	useCollatedUi = init_ui_renderer(uiRenderer, fontTex, errors);
+	if (!useCollatedUi)
+		std::cerr << "drawing the UI the fixed function way\n" << errors;
+	errors.clear();
+	// Init offscreen rendering
+	score_renderer renderer;
+	if (!init_score_renderer(renderer, sourceWidth, sourceHeight, errors)) {
+		std::cerr << "failed to init renderer\n" << errors;
 		exit(1);
 	}
-	glUseProgram(shader);
-	glUniform1f(glGetUniformLocation(shader, "aspect"),
-		(float)sourceWidth/sourceHeight);
-	glUseProgram(0);
-	// Set up secondary framebuffer for rendering to texture
-	GLuint frame_buffer = 0;
-	glGenFramebuffers(1, &frame_buffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
-	// The texture we're going to render to
-	GLuint rendered_texture;
-	glGenTextures(1, &rendered_texture);
-	glBindTexture(GL_TEXTURE_2D, rendered_texture);
-	// Give an empty image to OpenGL ( the last "0" )
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, sourceWidth, sourceHeight, 0, GL_RGB,
-		GL_UNSIGNED_BYTE, 0);
-	// Use box filter
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	// Set "renderedTexture" as our colour attachement #0
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-		rendered_texture, 0); 
-	// Set the list of draw buffers.
-	GLenum DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-	glDrawBuffers(1, DrawBuffers); // "1" is the size of DrawBuffers
-	// Always check that our framebuffer is ok
-	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		printf("failed to setup framebuffer\n");
-		exit(-1);
+	if (options.no_instancing)
+		renderer.use_instancing = false;
+	// Init the wall, drawn at the window's size in place of the one score
+	score_wall wall;
+	if (options.wall) {
+		const ImVec2 size = ImGui::GetIO().DisplaySize;
+		if (!init_score_wall(wall, (int)size.x, (int)size.y,
+			(float)sourceWidth/sourceHeight, errors)) {
+			std::cerr << "failed to init wall\n" << errors;
+			exit(1);
+		}
+		set_wall_scores(wall, wall_scores);
 	}
 	// Setup vertex buffers and shader for rendering texture to screen
 	const GLfloat g_quad_vertex_buffer_data[] = {
@@ -383,7 +1442,7 @@ int main(int argc, char** argv)
 	glBufferData(GL_ARRAY_BUFFER, sizeof(g_quad_vertex_buffer_data), g_quad_vertex_buffer_data, GL_STATIC_DRAW);
 	// Create and compile our GLSL program from the shaders
 	GLuint quad_shader;
-	success = make_shader_program("quad.vert", "quad.frag", quad_shader, errors);
+	bool success = make_shader_program("quad.vert", "quad.frag", quad_shader, errors);
 	if (!success) {
 		std::cerr << "failed to make shader\n" << errors;
 		exit(1);
@@ -393,191 +1452,93 @@ int main(int argc, char** argv)
 	// Set our "renderedTexture" sampler to user Texture Unit 0
 	glUniform1i(tex_id, 0);
 	glUseProgram(0);
-	// Init geometry
-	const int NUM_SHAPES = 9;
-	GLuint vertex_buffers[NUM_SHAPES];
-	GLuint index_buffers[NUM_SHAPES];
-	int index_counts[NUM_SHAPES] = {0};
-	std::vector<GLfloat> dataf;
-	std::vector<GLuint> datau;
-	glGenBuffers(NUM_SHAPES, vertex_buffers);
-	glGenBuffers(NUM_SHAPES, index_buffers);
-	// Setup our shapes
-	// 0 - line
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[0]);
-	dataf = {
-		-1.f,0.f,0.f,
-		1.f,0.f,0.f};
-	glBufferData(GL_ARRAY_BUFFER, dataf.size()*sizeof(GLfloat), &dataf[0],
-		GL_STATIC_DRAW);
-	// 1 - 3 pointed line
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[1]);
-	dataf = {
-		0.f,0.f,0.f,
-		-1.f,0.f,0.f,
-		0.5,0.866,0.f,
-		0.5,-0.866,0.f};
-	glBufferData(GL_ARRAY_BUFFER, dataf.size()*sizeof(GLfloat), &dataf[0],
-		GL_STATIC_DRAW);
-	// 2 - cross
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[2]);
-	dataf = {
-		0.f,0.f,0.f,
-		-1.f,0.f,0.f,
-		0.f,1.f,0.f,
-		1.f,0.f,0.f,
-		0.f,-1.f,0.f};
-	glBufferData(GL_ARRAY_BUFFER, dataf.size()*sizeof(GLfloat), &dataf[0],
-		GL_STATIC_DRAW);
-	// 3 - fat line
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[3]);
-	dataf = {
-		-1.f,0.2f,0.f,
-		1.f,0.2f,0.f,
-		1.f,-0.2f,0.f,
-		-1.f,-0.2f,0.f
-	};
-	glBufferData(GL_ARRAY_BUFFER, dataf.size()*sizeof(GLfloat), &dataf[0],
-		GL_STATIC_DRAW);
-	// 4 - fat 3-line
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[4]);
-	dataf = {
-		-1.f,		-0.2f,		0.f,
-		-1.f,		0.2f,		0.f,
-		-0.115f,	0.2f,		0.f,
-		0.316f,		0.949f,		0.f,
-		0.663f,		0.748f,		0.f,
-		0.3f,		0.f,		0.f,
-		0.663f,		-0.748f,	0.f,
-		0.316f,		-0.949f,	0.f,
-		-0.115f,	-0.2f,		0.f
-	};
-	glBufferData(GL_ARRAY_BUFFER, dataf.size()*sizeof(GLfloat), &dataf[0],
-		GL_STATIC_DRAW);
-	// 5 - fat cross
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[5]);
-	dataf = {
-		-1.f,0.2f,0.f,
-		-0.2f,0.2f,0.f,
-		-0.2f,1.f,0.f,
-		0.2f,1.f,0.f,
-		0.2f,0.2f,0.f,
-		1.f,0.2f,0.f,
-		1.f,-0.2f,0.f,
-		0.2f,-0.2f,0.f,
-		0.2f,-1.f,0.f,
-		-0.2f,-1.f,0.f,
-		-0.2f,-0.2f,0.f,
-		-1.f,-0.2f,0.f
-	};
-	glBufferData(GL_ARRAY_BUFFER, dataf.size()*sizeof(GLfloat), &dataf[0],
-		GL_STATIC_DRAW);
-	// 6 - triangle
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[6]);
-	dataf = {
-		-1.f,-0.866f,0.f,
-		1.f,-0.866f,0.f,
-		0.f,0.866f,0.f,
-	};
-	glBufferData(GL_ARRAY_BUFFER, dataf.size()*sizeof(GLfloat), &dataf[0],
-		GL_STATIC_DRAW);
-	// 7 - square
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[7]);
-	dataf = {
-		-0.707f,	-0.707f,	0.f,
-		0.707f,		-0.707f,	0.f,
-		0.707f,		0.707f,		0.f,
-		-0.707f,	0.707f,		0.f
-	};
-	glBufferData(GL_ARRAY_BUFFER, dataf.size()*sizeof(GLfloat), &dataf[0],
-		GL_STATIC_DRAW);
-	// 8 - pentagon
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[8]);
-	dataf = {
-		1.f,		0.f,		0.f,
-		0.309f,		-0.951f,	0.f,
-		-0.809f,	-0.588f,	0.f,
-		-0.809f,	0.588f,		0.f,
-		0.309f,		0.951f,		0.f
-	};
-	glBufferData(GL_ARRAY_BUFFER, dataf.size()*sizeof(GLfloat), &dataf[0],
-		GL_STATIC_DRAW);
-	/*
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[3]);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[4]);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[5]);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[6]);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[7]);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[8]);
-	*/
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	// Index buffers
-	// 0 - line
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[0]);
-	datau = {0,1};
-	index_counts[0] = datau.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, datau.size()*sizeof(GLuint), &datau[0],
-		GL_STATIC_DRAW);
-	// 1 - 3-line
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[1]);
-	datau = {0,1, 0,2, 0,3};
-	index_counts[1] = datau.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, datau.size()*sizeof(GLuint), &datau[0],
-		GL_STATIC_DRAW);
-	// 2 - cross
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[2]);
-	datau = {0,1, 0,2, 0,3, 0,4};
-	index_counts[2] = datau.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, datau.size()*sizeof(GLuint), &datau[0],
-		GL_STATIC_DRAW);
-	// 3 - fat line
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[3]);
-	datau = {0,1, 1,2, 2,3, 3,0};
-	index_counts[3] = datau.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, datau.size()*sizeof(GLuint), &datau[0],
-		GL_STATIC_DRAW);
-	// 4 - fat 3-line
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[4]);
-	datau = {0,1, 1,2, 2,3, 3,4, 4,5, 5,6, 6,7, 7,8, 8,0};
-	index_counts[4] = datau.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, datau.size()*sizeof(GLuint), &datau[0],
-		GL_STATIC_DRAW);
-	// 5 - fat cross
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[5]);
-	datau = {0,1, 1,2, 2,3, 3,4, 4,5, 5,6, 6,7, 7,8, 8,9, 9,10, 10,11, 11,0};
-	index_counts[5] = datau.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, datau.size()*sizeof(GLuint), &datau[0],
-		GL_STATIC_DRAW);
-	// 6 - triangle
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[6]);
-	datau = {0,1, 1,2, 2,0};
-	index_counts[6] = datau.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, datau.size()*sizeof(GLuint), &datau[0],
-		GL_STATIC_DRAW);
-	// 7 - square
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[7]);
-	datau = {0,1, 1,2, 2,3, 3,0};
-	index_counts[7] = datau.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, datau.size()*sizeof(GLuint), &datau[0],
-		GL_STATIC_DRAW);
-	// 8 - pentagon
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[8]);
-	datau = {0,1, 1,2, 2,3, 3,4, 4,0};
-	index_counts[8] = datau.size();
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, datau.size()*sizeof(GLuint), &datau[0],
-		GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	int frame_count = 0;
+
+	// Frames already drawn, read back to be uploaded again when they come
+	// round instead of drawn
+	const bool use_cache = options.frame_cache_mb > 0 && !options.wall;
+	frame_cache cache;
+	init_frame_cache(cache, sourceWidth * sourceHeight * 3,
+		(size_t)options.frame_cache_mb << 20);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// Record what's shown with --output or --shm, through the readback ring
+	// so the window doesn't wait on each frame
+	const bool publishing = options.output || options.shm;
+	const int output_width = options.wall ? wall.width : sourceWidth;
+	const int output_height = options.wall ? wall.height : sourceHeight;
+	FILE* out;
+	shm_ring_sink ring;
+	pbo_readback readback;
+	if (!open_frame_output(options, output_width, output_height, out, ring,
+		errors) || (publishing && !init_pbo_readback(readback, output_width,
+		output_height, options.readback_ring, errors))) {
+		std::cerr << errors;
+		exit(1);
+	}
+	stream_sink stream(out, get_stream_format(options), OUTPUT_FPS);
+	gif_sink gif(out, OUTPUT_FPS, options.threads);
+	frame_sink& sink = choose_sink(options, stream, gif, ring);
+
+	// The animation steps on at SIM_FRAMES_PER_SECOND however fast the
+	// window draws, unless it's uncapped, or recording, when it's a step a
+	// window like --headless
+	const bool uncapped = options.uncapped || publishing;
+	glfwSwapInterval(uncapped ? 0 : 1);
+	sim_clock clock;
+	init_sim_clock(clock);
+	gl_call_counts last_gl_calls = gl_call_counts();
+	// What the score texture was last drawn with, so it's only drawn again
+	// when that changes
+	int shown_digits[NUM_DIGITS];
+	float shown_frame = -1.f;
+	bool shown_instancing = renderer.use_instancing;
+	// Windows drawn since the last input
+	int quiet_frames = 0;
+	window_load load;
+	start_window_load(load);
+	std::vector<time_histogram> times(NUM_FRAME_TIMES);
+	for (int i = 0 ; i < NUM_FRAME_TIMES ; ++i)
+		init_time_histogram(times[i], FRAME_TIME_NAMES[i]);
+	// When the last window was swapped, if the one before this was drawn
+	bool timing_frames = false;
+	auto last_swap = std::chrono::steady_clock::now();
+	end_startup_phase(STARTUP_RENDERERS);
+	bool started = false;
 
 	// Main loop
 	while (!glfwWindowShouldClose(window))
 	{
+		// Paused with the UI settled there's nothing new to draw, so sleep
+		// until there's input. Recording keeps drawing to keep its frame rate.
+		const bool idle = paused && !publishing &&
+			quiet_frames >= UI_SETTLE_FRAMES;
 		ImGuiIO& io = ImGui::GetIO();
 		mousePressed[0] = mousePressed[1] = false;
 		io.MouseWheel = 0;
-		glfwPollEvents();
+		const uint64_t poll_start = profile_now();
+		if (idle)
+			glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+		else
+			glfwPollEvents();
+		update_window_load(load);
+		if (uiEvent) {
+			uiEvent = false;
+			quiet_frames = 0;
+		}
+		else if (idle) {
+			continue;
+		}
+		// Time asleep isn't a frame
+		if (idle)
+			timing_frames = false;
+		++quiet_frames;
+		const bool was_paused = paused;
+		// Time asleep waiting for input isn't part of the frame
+		next_profile_frame();
+		profile_phases phases("poll events",
+			idle ? profile_now() : poll_start);
+		phases.next("build UI");
+		gl_calls = gl_call_counts();
 		UpdateImGui();
 
 		bool shown = ImGui::Begin("Info");
@@ -592,68 +1553,189 @@ int main(int argc, char** argv)
 			if (ImGui::Button("increment")) {
 				increment_score(digits, NUM_DIGITS);
 			}
+			// Jump straight to a score, -1 while the digits aren't one
+			int value = score_to_int(digits);
+			if (ImGui::InputInt("score", &value))
+				int_to_score(std::max(std::min(value, NUM_SCORES-1), 0),
+					digits);
 			ImGui::Checkbox("auto increment", &should_auto_increment);
 			ImGui::Checkbox("paused", &paused);
+			ImGui::Text("frame %lld, %.2f to the next, %lld dropped",
+				clock.frame, sim_clock_fraction(clock), clock.dropped_frames);
+			if (renderer.can_instance)
+				ImGui::Checkbox("instanced", &renderer.use_instancing);
+			int glyph_set = options.glyph_set;
+			if (num_shape_sets(shapeLibrary) > 1 &&
+				ImGui::InputInt("glyph set", &glyph_set) &&
+				use_shape_set(shapeLibrary, glyph_set)) {
+				// Everything drawn from the old shapes is out of date
+				options.glyph_set = glyph_set;
+				update_score_shapes(renderer);
+				if (options.wall)
+					set_wall_scores(wall, wall_scores);
+				init_frame_cache(cache, sourceWidth * sourceHeight * 3,
+					(size_t)options.frame_cache_mb << 20);
+				shown_frame = -1.f;
+			}
+			ImGui::Text("GL per frame: %d draws, %d uniform lookups, "
+				"%d state changes", last_gl_calls.draw_calls,
+				last_gl_calls.uniform_lookups, last_gl_calls.state_changes);
+			if (uiRenderer.shader)
+				ImGui::Checkbox("collated UI", &useCollatedUi);
+			ImGui::Text("UI: %d draws, %d scissors, %d vertices, %.3f ms",
+				uiStats.draw_calls, uiStats.scissor_changes, uiStats.vertices,
+				uiStats.seconds * 1000.0);
+			ImGui::Text("CPU: %.1f%%, %.0f windows/s, %.0f scores/s",
+				load.cpu_percent, load.windows_per_second,
+				load.scores_per_second);
+			show_frame_times(times);
+			if (started)
+				ImGui::Text("startup: %.1f ms (GL %.1f, font %.1f%s, renderers "
+					"%.1f, first frame %.1f)", startupTimes.total * 1000.0,
+					startupTimes.seconds[STARTUP_GL] * 1000.0,
+					startupTimes.seconds[STARTUP_FONT] * 1000.0,
+					startupTimes.font_cached ? " cached" : "",
+					startupTimes.seconds[STARTUP_RENDERERS] * 1000.0,
+					startupTimes.seconds[STARTUP_FIRST_FRAME] * 1000.0);
+			ImGui::Text("shaders: %d programs cached, %d compiled, %.1f ms",
+				shader_stats.cached, shader_stats.compiled,
+				shader_stats.seconds * 1000.0);
+			if (options.wall)
+				ImGui::Text("wall: %d scores (%dx%d), %.2f ms/frame",
+					wall.num_scores, wall.columns, wall.rows,
+					io.DeltaTime * 1000.f);
+			if (publishing)
+				ImGui::Text("readback: %lld frames, latency %.1f frames, "
+					"stalled %.3f ms/frame", readback.stats.frames,
+					readback.stats.latency_frames /
+					(double)std::max(readback.stats.frames, 1LL),
+					1000.0 * readback.stats.stall_seconds /
+					std::max(readback.stats.frames, 1LL));
+			if (use_cache)
+				ImGui::Text("frame cache: %lld hits, %lld misses, "
+					"%lld evictions, %.1f/%.1f MB", cache.stats.hits,
+					cache.stats.misses, cache.stats.evictions,
+					frame_cache_bytes(cache) / 1048576.0,
+					cache.max_frames * (double)cache.frame_size / 1048576.0);
 		}
 		ImGui::End();
 		// Prevent overflow
 		for (int& digit : digits)
 			digit = std::max(std::min(digit, NUM_SHAPES-1), 0);
-		// Auto increment
-		if (should_auto_increment)
-			if (frame_count && frame_count % 30 == 0)
-				increment_score(digits, NUM_DIGITS);
-		// Rendering
-		// Render to texture
-		glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
-		glViewport(0, 0, sourceWidth, sourceHeight);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		
-		glUseProgram(shader);
-		glUniform1i(glGetUniformLocation(shader, "frame"), frame_count);
-		glUniform3f(glGetUniformLocation(shader, "color"), 1.f, 1.f, 0.f);
-		for (int i = 0 ; i < NUM_DIGITS ; ++i)
-		{
-			const int type = digits[i];
-			glUniform1i(glGetUniformLocation(shader, "index"), i);
-			glUniform1i(glGetUniformLocation(shader, "digit"), digits[i]);
-			glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[type]);
-			glEnableClientState(GL_VERTEX_ARRAY);
-			glVertexPointer(3, GL_FLOAT, 0, 0);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[type]);
-			glDrawElements(GL_LINES, index_counts[type], GL_UNSIGNED_INT, 0);
+		// Rendering, unless the score texture already has this frame.
+		// Frames between steps can't come from the cache.
+		phases.next("offscreen");
+		auto lap = std::chrono::steady_clock::now();
+		const float frame = sim_clock_animation_frame(clock);
+		const bool scene_changed = frame != shown_frame ||
+			memcmp(digits, shown_digits, sizeof(shown_digits)) ||
+			renderer.use_instancing != shown_instancing;
+		if (scene_changed) {
+			gpu_profile_scope gpu_scope("offscreen");
+			const bool whole_frame = sim_clock_fraction(clock) == 0.f;
+			const int phase = (int)(clock.frame % ANIMATION_PERIOD);
+			const unsigned char *cached = use_cache && whole_frame ?
+				find_frame(cache, digits, phase) : 0;
+			if (options.wall) {
+				render_wall(wall, frame);
+			}
+			else if (cached) {
+				GL_STATE(glBindTexture(GL_TEXTURE_2D,
+					renderer.rendered_texture));
+				GL_STATE(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, sourceWidth,
+					sourceHeight, GL_RGB, GL_UNSIGNED_BYTE, cached));
+			}
+			else {
+				render_score(renderer, digits, NUM_DIGITS, frame);
+				if (use_cache && whole_frame)
+					glReadPixels(0, 0, sourceWidth, sourceHeight, GL_RGB,
+						GL_UNSIGNED_BYTE, store_frame(cache, digits, phase));
+			}
+			memcpy(shown_digits, digits, sizeof(shown_digits));
+			shown_frame = frame;
+			shown_instancing = renderer.use_instancing;
+			++load.scores_drawn;
 		}
+		add_lap(times[TIME_OFFSCREEN], lap);
+		if (publishing) {
+			phases.next("publish");
+			sink.note_score(clock.frame, digits, NUM_DIGITS);
+			glBindFramebuffer(GL_FRAMEBUFFER, options.wall ? wall.frame_buffer
+				: renderer.frame_buffer);
+			if (!queue_readback(readback, clock.frame, sink, errors)) {
+				std::cerr << errors;
+				glfwSetWindowShouldClose(window, 1);
+			}
+		}
+
+		phases.next("blit");
+		lap = std::chrono::steady_clock::now();
+		{
+			gpu_profile_scope gpu_scope("blit");
+			// Switch to rendering to screen
+			GL_STATE(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+			GL_STATE(glViewport(0, 0, (int)io.DisplaySize.x,
+				(int)io.DisplaySize.y));
+			GL_STATE(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
+			glClear(GL_COLOR_BUFFER_BIT);
 
-		// Switch to rendering to screen
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		// Render texture fullscreen
-		glUseProgram(quad_shader);
-		// Bind our texture in Texture Unit 0
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, rendered_texture);
-		// Use quad buffer
-		glBindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glVertexPointer(3, GL_FLOAT, 0, 0);
-		glDrawArrays(GL_TRIANGLES, 0, 3);
-
-		// Unbind resources
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		glUseProgram(0);
+			// Render texture fullscreen
+			GL_STATE(glUseProgram(quad_shader));
+			// Bind our texture in Texture Unit 0
+			GL_STATE(glActiveTexture(GL_TEXTURE0));
+			GL_STATE(glBindTexture(GL_TEXTURE_2D, options.wall ?
+				wall.rendered_texture : renderer.rendered_texture));
+			// Use quad buffer
+			GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer));
+			GL_STATE(glEnableClientState(GL_VERTEX_ARRAY));
+			GL_STATE(glVertexPointer(3, GL_FLOAT, 0, 0));
+			GL_DRAW(glDrawArrays(GL_TRIANGLES, 0, 3));
+
+			// Unbind resources
+			GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, 0));
+			GL_STATE(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+			GL_STATE(glUseProgram(0));
+			last_gl_calls = gl_calls;
+		}
+		add_lap(times[TIME_BLIT], lap);
 
 		// UI Rendering
+		phases.next("ImGui::Render");
 		ImGui::Render();
+		add_lap(times[TIME_UI], lap);
 		// Swap
+		phases.next("swap");
 		glfwSwapBuffers(window);
-		if (!paused)
-			++frame_count;
+		add_lap(times[TIME_SWAP], lap);
+		if (timing_frames)
+			add_time(times[TIME_FRAME], std::chrono::duration<double>(
+				lap - last_swap).count());
+		last_swap = lap;
+		timing_frames = true;
+		if (!started) {
+			end_startup_phase(STARTUP_FIRST_FRAME);
+			started = true;
+		}
+		++load.windows_drawn;
+		phases.next("step");
+		// Step the animation on, counting up as it goes. Time spent paused
+		// doesn't count.
+		const long long last_frame = clock.frame;
+		if (uncapped && !paused)
+			++clock.frame;
+		else if (!uncapped && !paused && !was_paused)
+			advance_sim_clock(clock, io.DeltaTime);
+		for (long long f = last_frame + 1 ; f <= clock.frame ; ++f)
+			step_score(digits, f, should_auto_increment);
 	}
+	if (publishing && (!flush_readbacks(readback, sink, errors) ||
+		!sink.finish(errors)))
+		std::cerr << errors;
+	close_output(out);
+	if (&sink == &gif)
+		print_gif_stats(std::cerr, gif);
+	write_trace(options, std::cerr);
+	write_histograms(options, times, std::cerr);
 	// Closing
 	ImGui::Shutdown();
 	glfwTerminate();
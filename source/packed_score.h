@@ -0,0 +1,170 @@
+#ifndef PACKED_SCORE_H
+#define PACKED_SCORE_H
+
+#include <stdint.h>
+
+// A score packed as one 4-bit digit per nibble, least significant digit in
+// the lowest nibble, so the whole score can be worked on a word at a time.
+// Scores of up to 16 digits are one 64-bit word, longer ones take more.
+// Digits past the end of the score are always zero.
+template <int Digits, int Shapes>
+struct packed_score {
+	static_assert(Digits > 0, "scores need digits");
+	static_assert(Shapes > 1 && Shapes < 16,
+		"digits, plus one for incrementing, have to fit in a nibble");
+
+	static const int NUM_WORDS = (Digits + 15) / 16;
+	uint64_t words[NUM_WORDS];
+
+	static packed_score
+	from_digits(const int *digits)
+	{
+		packed_score score = packed_score();
+		for (int i = 0 ; i < Digits ; ++i)
+			score.set_digit(i, digits[i]);
+		return score;
+	}
+
+	void
+	to_digits(int *digits) const
+	{
+		for (int i = 0 ; i < Digits ; ++i)
+			digits[i] = digit(i);
+	}
+
+	int
+	digit(int i) const
+	{
+		return (int)(words[i / 16] >> (i % 16 * 4)) & 0xf;
+	}
+
+	// Values outside [0, 15] are cut down to a nibble; clamp() does the rest
+	void
+	set_digit(int i, int value)
+	{
+		const int shift = i % 16 * 4;
+		words[i / 16] = (words[i / 16] & ~((uint64_t)0xf << shift)) |
+			((uint64_t)(value & 0xf) << shift);
+	}
+
+	// Step on to the next score the way increment_score does: the lowest
+	// digit that's below the one above it (or the top digit) goes up, and
+	// every digit under it goes back to zero. The top digit can go one past
+	// the last shape, so clamp() afterwards to stay in range.
+	void
+	increment()
+	{
+		bool done = false;
+		for (int k = 0 ; k < NUM_WORDS ; ++k) {
+			const uint64_t above_next = k + 1 < NUM_WORDS ?
+				words[k + 1] << 60 : 0;
+			const uint64_t next = (words[k] >> 4) | above_next;
+			// Digits that can go up: the ones below their neighbour, and
+			// the top one
+			const uint64_t can_go_up =
+				(lanes_below(words[k], next) & low_lanes(k)) | top_lane(k);
+			if (done)
+				continue;
+			if (can_go_up) {
+				const uint64_t lane = can_go_up & (0 - can_go_up);
+				const uint64_t unit = lane >> 3;
+				words[k] = (words[k] & ~(unit - 1)) + unit;
+				done = true;
+			}
+			else {
+				words[k] = 0;
+			}
+		}
+	}
+
+	// Bring every digit into [0, Shapes - 1]
+	void
+	clamp()
+	{
+		for (int k = 0 ; k < NUM_WORDS ; ++k) {
+			const uint64_t top = LANE_ONES * (Shapes - 1);
+			const uint64_t over = lanes_to_masks(lanes_below(top, words[k]));
+			words[k] = (words[k] & ~over) | (top & over & used_lanes(k));
+		}
+	}
+
+	// -1, 0 or 1 as this score is below, equal to or above "other". The
+	// most significant digit is in the highest nibble, so it's word order.
+	int
+	compare(const packed_score& other) const
+	{
+		int order = 0;
+		for (int k = 0 ; k < NUM_WORDS ; ++k) {
+			const int word_order = (words[k] > other.words[k]) -
+				(words[k] < other.words[k]);
+			order = word_order ? word_order : order;
+		}
+		return order;
+	}
+
+	bool
+	operator==(const packed_score& other) const
+	{
+		uint64_t differences = 0;
+		for (int k = 0 ; k < NUM_WORDS ; ++k)
+			differences |= words[k] ^ other.words[k];
+		return !differences;
+	}
+
+	bool
+	operator<(const packed_score& other) const
+	{
+		return compare(other) < 0;
+	}
+
+private:
+	static const uint64_t LANE_ONES = 0x1111111111111111ull;
+	static const uint64_t LANE_HIGH_BITS = 0x8888888888888888ull;
+
+	// The top bit of each nibble where "a" is below "b", from the borrow
+	// out of each nibble when subtracting b from a
+	static uint64_t
+	lanes_below(uint64_t a, uint64_t b)
+	{
+		const uint64_t difference =
+			((a | LANE_HIGH_BITS) - (b & ~LANE_HIGH_BITS)) ^
+			((a ^ ~b) & LANE_HIGH_BITS);
+		return ((~a & b) | (~(a ^ b) & difference)) & LANE_HIGH_BITS;
+	}
+
+	// Top bits of nibbles to whole nibble masks
+	static uint64_t
+	lanes_to_masks(uint64_t lanes)
+	{
+		return (lanes >> 3) * 0xf;
+	}
+
+	// Nibbles of word "k" that hold digits
+	static uint64_t
+	used_lanes(int k)
+	{
+		const int used = k + 1 < NUM_WORDS ? 16 : Digits - k * 16;
+		return used == 16 ? ~(uint64_t)0 : ((uint64_t)1 << (used * 4)) - 1;
+	}
+
+	// Top bits of nibbles of word "k" holding digits with one above them
+	static uint64_t
+	low_lanes(int k)
+	{
+		const int digit = Digits - 1 - k * 16;
+		const uint64_t below_top = digit >= 16 ? ~(uint64_t)0 :
+			digit <= 0 ? 0 : ((uint64_t)1 << (digit * 4)) - 1;
+		return below_top & LANE_HIGH_BITS;
+	}
+
+	// Top bit of the top digit's nibble, if it's in word "k"
+	static uint64_t
+	top_lane(int k)
+	{
+		const int digit = Digits - 1 - k * 16;
+		return digit >= 0 && digit < 16 ?
+			(uint64_t)0x8 << (digit * 4) : 0;
+	}
+};
+
+#endif
@@ -0,0 +1,270 @@
+// glew
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "profiler.h"
+
+// Room in each thread's ring for this many events a frame
+static const int EVENTS_PER_FRAME = 32;
+// Most frames each ring keeps, about 100MB a thread
+static const int MAX_FRAMES_KEPT = 100000;
+// GPU timings in flight, waiting for their queries to come back
+static const int GPU_SCOPES = 64;
+
+struct profile_event {
+	const char *name;
+	uint64_t start;
+	uint64_t end;
+	long long frame;
+};
+
+// One thread's events, written only by that thread. "written" counts every
+// event ever pushed, so a reader knows which slots hold the latest ones.
+struct thread_events {
+	int id;
+	std::string name;
+	std::vector<profile_event> ring;
+	std::atomic<uint64_t> written;
+};
+
+std::atomic<bool> profiler_enabled(false);
+
+static std::chrono::steady_clock::time_point profile_start;
+static size_t ring_events;
+static int frames_kept;
+static std::atomic<long long> current_frame(0);
+// Every thread's ring, kept after the thread exits so the trace has it.
+// The lock is only taken when a thread records its first event.
+static std::mutex registry_mutex;
+static std::vector< std::unique_ptr<thread_events> > registry;
+static thread_local thread_events *my_events = 0;
+
+// Timestamp queries for GL work, two a scope, handed out and collected in
+// order
+struct gpu_profile {
+	bool enabled;
+	GLuint queries[GPU_SCOPES * 2];
+	const char *names[GPU_SCOPES];
+	long long frames[GPU_SCOPES];
+	int first;		// oldest scope not yet collected
+	int count;
+	// Add to a GPU timestamp to get profile time
+	int64_t offset;
+	thread_events *events;
+};
+static gpu_profile gpu;
+
+static thread_events*
+add_thread_events(const char *name)
+{
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	thread_events *events = new thread_events();
+	events->id = (int)registry.size() + 1;
+	events->name = name ? name : "thread " + std::to_string(events->id);
+	events->ring.resize(ring_events);
+	events->written = 0;
+	registry.emplace_back(events);
+	return events;
+}
+
+static void
+push_event(thread_events& events,
+		   const char *name,
+		   uint64_t start,
+		   uint64_t end,
+		   long long frame)
+{
+	const uint64_t index = events.written.load(std::memory_order_relaxed);
+	profile_event& event = events.ring[index % events.ring.size()];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+	event.frame = frame;
+	events.written.store(index + 1, std::memory_order_release);
+}
+
+void
+start_profiler(int frames)
+{
+	frames_kept = std::min(std::max(frames, 1), MAX_FRAMES_KEPT);
+	ring_events = (size_t)frames_kept * EVENTS_PER_FRAME;
+	profile_start = std::chrono::steady_clock::now();
+	profiler_enabled = true;
+}
+
+static void
+calibrate_gpu_clock()
+{
+	GLint64 gpu_now;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+	gpu.offset = (int64_t)profile_now() - gpu_now;
+}
+
+void
+start_gpu_profiler()
+{
+	if (!profiler_enabled || !GLEW_ARB_timer_query)
+		return;
+	glGenQueries(GPU_SCOPES * 2, gpu.queries);
+	gpu.first = 0;
+	gpu.count = 0;
+	gpu.events = add_thread_events("GPU");
+	calibrate_gpu_clock();
+	gpu.enabled = true;
+}
+
+uint64_t
+profile_now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - profile_start).count();
+}
+
+void
+record_profile_event(const char *name, uint64_t start, uint64_t end)
+{
+	if (!my_events)
+		my_events = add_thread_events(0);
+	push_event(*my_events, name, start, end,
+		current_frame.load(std::memory_order_relaxed));
+}
+
+void
+name_profile_thread(const char *name)
+{
+	if (!profiler_enabled)
+		return;
+	if (!my_events)
+		my_events = add_thread_events(name);
+	else {
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		my_events->name = name;
+	}
+}
+
+// Move GPU timings that have come back into the GPU's ring, oldest first,
+// stopping at the first that hasn't
+static void
+collect_gpu_times()
+{
+	while (gpu.count) {
+		const GLuint *pair = gpu.queries + gpu.first * 2;
+		GLint available = 0;
+		glGetQueryObjectiv(pair[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 start, end;
+		glGetQueryObjectui64v(pair[0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(pair[1], GL_QUERY_RESULT, &end);
+		push_event(*gpu.events, gpu.names[gpu.first],
+			(uint64_t)std::max((int64_t)start + gpu.offset, (int64_t)0),
+			(uint64_t)std::max((int64_t)end + gpu.offset, (int64_t)0),
+			gpu.frames[gpu.first]);
+		gpu.first = (gpu.first + 1) % GPU_SCOPES;
+		--gpu.count;
+	}
+}
+
+void
+next_profile_frame()
+{
+	if (!profiler_enabled)
+		return;
+	current_frame.fetch_add(1, std::memory_order_relaxed);
+	if (gpu.enabled) {
+		collect_gpu_times();
+		// The clocks can drift apart, so line them up again
+		calibrate_gpu_clock();
+	}
+}
+
+gpu_profile_scope::gpu_profile_scope(const char *name) :
+	pair(-1)
+{
+	if (!gpu.enabled || gpu.count == GPU_SCOPES)
+		return;
+	pair = (gpu.first + gpu.count) % GPU_SCOPES;
+	++gpu.count;
+	gpu.names[pair] = name;
+	gpu.frames[pair] = current_frame.load(std::memory_order_relaxed);
+	glQueryCounter(gpu.queries[pair * 2], GL_TIMESTAMP);
+}
+
+gpu_profile_scope::~gpu_profile_scope()
+{
+	if (pair >= 0)
+		glQueryCounter(gpu.queries[pair * 2 + 1], GL_TIMESTAMP);
+}
+
+// Write "text" with JSON's quotes and backslashes escaped
+static void
+put_json_string(FILE *out, const char *text)
+{
+	putc('"', out);
+	for ( ; *text ; ++text) {
+		if (*text == '"' || *text == '\\')
+			putc('\\', out);
+		if ((unsigned char)*text >= 0x20)
+			putc(*text, out);
+	}
+	putc('"', out);
+}
+
+bool
+write_chrome_trace(const char *path, std::string& errors)
+{
+	if (gpu.enabled) {
+		// Whatever the GPU hasn't finished by now won't be in the trace
+		glFinish();
+		collect_gpu_times();
+	}
+	FILE *out = fopen(path, "wb");
+	if (!out) {
+		errors.append(std::string("failed to open ") + path + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	const long long first_frame =
+		current_frame.load(std::memory_order_relaxed) - frames_kept + 1;
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+	bool first = true;
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	for (const std::unique_ptr<thread_events>& events : registry) {
+		fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+			"\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", events->id);
+		put_json_string(out, events->name.c_str());
+		fputs("}}", out);
+		first = false;
+		const uint64_t written = events->written.load(
+			std::memory_order_acquire);
+		const uint64_t size = events->ring.size();
+		for (uint64_t i = written > size ? written - size : 0 ; i < written ;
+			++i) {
+			const profile_event& event = events->ring[i % size];
+			if (event.frame < first_frame)
+				continue;
+			fputs(",\n{\"name\":", out);
+			put_json_string(out, event.name);
+			fprintf(out, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+				"\"dur\":%.3f,\"args\":{\"frame\":%lld}}", events->id,
+				event.start * 1e-3, (event.end - event.start) * 1e-3,
+				event.frame);
+		}
+	}
+	fputs("\n]}\n", out);
+	if (fclose(out)) {
+		errors.append(std::string("failed to write ") + path + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	return true;
+}
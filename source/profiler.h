@@ -0,0 +1,104 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+// Times the phases of each frame, to write out as a Chrome trace for
+// chrome://tracing or ui.perfetto.dev. Every thread records into a ring of
+// its own with no locks, so timing worker threads doesn't make them wait
+// on each other. GL work can also be timed on the GPU with timestamp
+// queries, which are collected a few frames later. Until start_profiler is
+// called a scope costs one relaxed load.
+
+extern std::atomic<bool> profiler_enabled;
+
+// Start recording, keeping about the last "frames" frames (up to 100000)
+// on each thread
+void
+start_profiler(int frames);
+
+// Time GL work too, if GL has timer queries. Only call this after OpenGL
+// has started, from the thread that uses it.
+void
+start_gpu_profiler();
+
+// Nanoseconds since the profiler started
+uint64_t
+profile_now();
+
+// Record that "name" took from "start" to "end" on the calling thread
+void
+record_profile_event(const char *name, uint64_t start, uint64_t end);
+
+// Give the calling thread a name in the trace
+void
+name_profile_thread(const char *name);
+
+// Begin the next frame, which the events after it are part of. GPU times
+// that have come back are collected here.
+void
+next_profile_frame();
+
+// Write the last frames recorded as a Chrome trace. Returns false and gives
+// error messages in "errors" if it couldn't be written.
+bool
+write_chrome_trace(const char *path, std::string& errors);
+
+// Times its own lifetime as "name", which has to outlive the profiler, so
+// a string literal
+struct profile_scope {
+	const char *name;
+	bool on;
+	uint64_t start;
+
+	explicit profile_scope(const char *name) :
+		name(name),
+		on(profiler_enabled.load(std::memory_order_relaxed)),
+		start(on ? profile_now() : 0) {}
+
+	~profile_scope()
+	{
+		if (on)
+			record_profile_event(name, start, profile_now());
+	}
+};
+
+// Times one phase after another, each lasting until the next starts and
+// the last until it's destroyed
+struct profile_phases {
+	const char *name;
+	bool on;
+	uint64_t start;
+
+	profile_phases(const char *first, uint64_t first_start) :
+		name(first),
+		on(profiler_enabled.load(std::memory_order_relaxed)),
+		start(first_start) {}
+
+	void next(const char *next_name)
+	{
+		if (!on)
+			return;
+		const uint64_t now = profile_now();
+		record_profile_event(name, start, now);
+		name = next_name;
+		start = now;
+	}
+
+	~profile_phases()
+	{
+		next(0);
+	}
+};
+
+// Times the GL commands issued in its lifetime as "name" on the GPU
+struct gpu_profile_scope {
+	int pair;	// timestamp queries in use, or -1
+
+	explicit gpu_profile_scope(const char *name);
+	~gpu_profile_scope();
+};
+
+#endif
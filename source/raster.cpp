@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "line_transform.h"
+#include "raster.h"
+#include "shapes.h"
+#include "thread_pool.h"
+
+// Must be a multiple of 4 so the kernel can always work on whole vectors
+static const int TILE_SIZE = 32;
+
+void
+init_cpu_rasterizer(cpu_rasterizer& rasterizer,
+					int width,
+					int height,
+					thread_pool *pool)
+{
+	rasterizer.width = width;
+	rasterizer.height = height;
+	rasterizer.tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	rasterizer.tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+	rasterizer.pool = pool;
+	rasterizer.segments.clear();
+	rasterizer.bins.assign(rasterizer.tiles_x * rasterizer.tiles_y,
+		std::vector<int>());
+}
+
+static void
+add_segment(cpu_rasterizer& r,
+			float x0, float y0,
+			float x1, float y1,
+			const float *color)
+{
+	// GL draws nothing for zero length lines, so neither do we
+	if (x0 == x1 && y0 == y1)
+		return;
+	raster_segment s;
+	s.x_major = fabsf(x1 - x0) >= fabsf(y1 - y0);
+	const float a0 = s.x_major ? x0 : y0;
+	const float a1 = s.x_major ? x1 : y1;
+	const float b0 = s.x_major ? y0 : x0;
+	const float b1 = s.x_major ? y1 : x1;
+	s.slope = (b1 - b0) / (a1 - a0);
+	s.intercept = b0 - s.slope * a0;
+	s.major_min = std::min(a0, a1);
+	s.major_max = std::max(a0, a1);
+	s.color[0] = color[0];
+	s.color[1] = color[1];
+	s.color[2] = color[2];
+
+	// Bin by bounding box, grown by the pixel that anti-aliasing can touch
+	const float min_x = std::min(x0, x1) - 1.f;
+	const float max_x = std::max(x0, x1) + 1.f;
+	const float min_y = std::min(y0, y1) - 1.f;
+	const float max_y = std::max(y0, y1) + 1.f;
+	if (max_x < 0.f || max_y < 0.f || min_x > r.width || min_y > r.height)
+		return;
+	const int tx0 = std::max((int)min_x / TILE_SIZE, 0);
+	const int tx1 = std::min((int)max_x / TILE_SIZE, r.tiles_x - 1);
+	const int ty0 = std::max((int)min_y / TILE_SIZE, 0);
+	const int ty1 = std::min((int)max_y / TILE_SIZE, r.tiles_y - 1);
+	const int index = (int)r.segments.size();
+	r.segments.push_back(s);
+	for (int ty = ty0 ; ty <= ty1 ; ++ty)
+		for (int tx = tx0 ; tx <= tx1 ; ++tx)
+			r.bins[ty * r.tiles_x + tx].push_back(index);
+}
+
+// Wu-style coverage: full intensity on the line, fading linearly to nothing
+// one pixel away along the minor axis. Works on "tile_row" columns
+// [col_lo, col_hi], rounded out to whole groups of four.
+static void
+cover_span(const raster_segment& s,
+		   float tile_x,
+		   float py,
+		   int col_lo,
+		   int col_hi,
+		   float *red,
+		   float *green,
+		   float *blue)
+{
+	int col = col_lo & ~3;
+#ifdef __SSE2__
+	const __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 intercept = _mm_set1_ps(s.intercept);
+	const __m128 slope = _mm_set1_ps(s.slope);
+	const __m128 major_min = _mm_set1_ps(s.major_min);
+	const __m128 major_max = _mm_set1_ps(s.major_max);
+	const __m128 r = _mm_set1_ps(s.color[0]);
+	const __m128 g = _mm_set1_ps(s.color[1]);
+	const __m128 b = _mm_set1_ps(s.color[2]);
+	for ( ; col <= col_hi ; col += 4) {
+		const __m128 px = _mm_add_ps(_mm_set1_ps(tile_x + col), lane_offsets);
+		const __m128 major = s.x_major ? px : _mm_set1_ps(py);
+		const __m128 minor = s.x_major ? _mm_set1_ps(py) : px;
+		const __m128 line = _mm_add_ps(intercept, _mm_mul_ps(slope, major));
+		const __m128 dist = _mm_and_ps(_mm_sub_ps(minor, line), abs_mask);
+		const __m128 inside = _mm_and_ps(_mm_cmpge_ps(major, major_min),
+			_mm_cmple_ps(major, major_max));
+		const __m128 cover = _mm_and_ps(
+			_mm_max_ps(_mm_sub_ps(one, dist), zero), inside);
+		_mm_store_ps(red + col,
+			_mm_max_ps(_mm_load_ps(red + col), _mm_mul_ps(cover, r)));
+		_mm_store_ps(green + col,
+			_mm_max_ps(_mm_load_ps(green + col), _mm_mul_ps(cover, g)));
+		_mm_store_ps(blue + col,
+			_mm_max_ps(_mm_load_ps(blue + col), _mm_mul_ps(cover, b)));
+	}
+#else
+	for ( ; col <= col_hi ; ++col) {
+		const float px = tile_x + col + 0.5f;
+		const float major = s.x_major ? px : py;
+		const float minor = s.x_major ? py : px;
+		if (major < s.major_min || major > s.major_max)
+			continue;
+		const float dist = fabsf(minor - (s.intercept + s.slope * major));
+		const float cover = std::max(1.f - dist, 0.f);
+		red[col] = std::max(red[col], cover * s.color[0]);
+		green[col] = std::max(green[col], cover * s.color[1]);
+		blue[col] = std::max(blue[col], cover * s.color[2]);
+	}
+#endif
+}
+
+static void
+draw_tile(const cpu_rasterizer& r, int tile, unsigned char *rgb)
+{
+	const int x0 = (tile % r.tiles_x) * TILE_SIZE;
+	const int y0 = (tile / r.tiles_x) * TILE_SIZE;
+	const int w = std::min(TILE_SIZE, r.width - x0);
+	const int h = std::min(TILE_SIZE, r.height - y0);
+	// Most of the frame is empty, so don't bother with the kernel there
+	if (r.bins[tile].empty()) {
+		for (int row = 0 ; row < h ; ++row)
+			memset(rgb + ((y0 + row) * r.width + x0) * 3, 0, w * 3);
+		return;
+	}
+	alignas(16) float acc[3][TILE_SIZE * TILE_SIZE];
+	memset(acc, 0, sizeof(acc));
+
+	for (int index : r.bins[tile]) {
+		const raster_segment& s = r.segments[index];
+		for (int row = 0 ; row < h ; ++row) {
+			const float py = y0 + row + 0.5f;
+			// Find the stretch of this row within a pixel of the line
+			float lo, hi;
+			if (s.x_major) {
+				if (s.slope == 0.f) {
+					if (fabsf(py - s.intercept) >= 1.f)
+						continue;
+					lo = s.major_min;
+					hi = s.major_max;
+				}
+				else {
+					const float xa = (py - 1.f - s.intercept) / s.slope;
+					const float xb = (py + 1.f - s.intercept) / s.slope;
+					lo = std::max(std::min(xa, xb), s.major_min);
+					hi = std::min(std::max(xa, xb), s.major_max);
+				}
+			}
+			else {
+				if (py < s.major_min || py > s.major_max)
+					continue;
+				const float x = s.intercept + s.slope * py;
+				lo = x - 1.f;
+				hi = x + 1.f;
+			}
+			const int col_lo = std::max((int)ceilf(lo - 0.5f - x0), 0);
+			const int col_hi = std::min((int)floorf(hi - 0.5f - x0), w - 1);
+			if (col_lo > col_hi)
+				continue;
+			const int offset = row * TILE_SIZE;
+			cover_span(s, (float)x0, py, col_lo, col_hi, acc[0] + offset,
+				acc[1] + offset, acc[2] + offset);
+		}
+	}
+
+	for (int row = 0 ; row < h ; ++row) {
+		unsigned char *out = rgb + ((y0 + row) * r.width + x0) * 3;
+		for (int col = 0 ; col < w ; ++col) {
+			const int i = row * TILE_SIZE + col;
+			for (int c = 0 ; c < 3 ; ++c)
+				*out++ = (unsigned char)(std::min(acc[c][i], 1.f)*255.f + 0.5f);
+		}
+	}
+}
+
+void
+rasterize_score(cpu_rasterizer& rasterizer,
+				const int *digits,
+				int num_digits,
+				int frame,
+				unsigned char *rgb)
+{
+	rasterizer.segments.clear();
+	for (std::vector<int>& bin : rasterizer.bins)
+		bin.clear();
+
+	// Transform every shape's lines into pixel space, like line.vert and
+	// the viewport transform would
+	const float w = (float)rasterizer.width;
+	const float h = (float)rasterizer.height;
+	const float aspect = w / h;
+	for (int i = 0 ; i < num_digits ; ++i) {
+		const shape_geometry& shape = shapes[digits[i]];
+		const digit_transform t = get_digit_transform(i, (float)frame);
+		float color[3];
+		shape_color(digits[i], color);
+		for (int j = 0 ; j + 1 < shape.num_indices ; j += 2) {
+			const float *v0 = shape.vertices + shape.indices[j] * 3;
+			const float *v1 = shape.vertices + shape.indices[j+1] * 3;
+			float x0, y0, x1, y1;
+			apply_digit_transform(t, aspect, v0[0], v0[1], x0, y0);
+			apply_digit_transform(t, aspect, v1[0], v1[1], x1, y1);
+			add_segment(rasterizer,
+				(x0 + 1.f) * 0.5f * w, (y0 + 1.f) * 0.5f * h,
+				(x1 + 1.f) * 0.5f * w, (y1 + 1.f) * 0.5f * h,
+				color);
+		}
+	}
+
+	const int num_tiles = rasterizer.tiles_x * rasterizer.tiles_y;
+	if (rasterizer.pool)
+		rasterizer.pool->parallel_for(num_tiles, [&](int tile) {
+			draw_tile(rasterizer, tile, rgb);
+		});
+	else
+		for (int tile = 0 ; tile < num_tiles ; ++tile)
+			draw_tile(rasterizer, tile, rgb);
+}
+
+// Lit means bright enough that it isn't just the faint edge of a line
+static bool
+is_lit(const unsigned char *p)
+{
+	return std::max(std::max(p[0], p[1]), p[2]) > 96;
+}
+
+// Compare hue, ignoring brightness, which anti-aliasing changes
+static bool
+similar_color(const unsigned char *a, const unsigned char *b)
+{
+	const int max_a = std::max(std::max(a[0], a[1]), a[2]);
+	const int max_b = std::max(std::max(b[0], b[1]), b[2]);
+	for (int c = 0 ; c < 3 ; ++c)
+		if (abs(a[c] * 255 / max_a - b[c] * 255 / max_b) > 64)
+			return false;
+	return true;
+}
+
+static float
+fraction_found(const unsigned char *a,
+			   const unsigned char *b,
+			   int width,
+			   int height)
+{
+	int lit = 0;
+	int found = 0;
+	for (int y = 0 ; y < height ; ++y) {
+		for (int x = 0 ; x < width ; ++x) {
+			const unsigned char *p = a + (y * width + x) * 3;
+			if (!is_lit(p))
+				continue;
+			++lit;
+			bool match = false;
+			for (int ny = std::max(y-1, 0) ; ny <= std::min(y+1, height-1) &&
+				!match ; ++ny) {
+				for (int nx = std::max(x-1, 0) ; nx <= std::min(x+1, width-1) &&
+					!match ; ++nx) {
+					const unsigned char *q = b + (ny * width + nx) * 3;
+					match = is_lit(q) && similar_color(p, q);
+				}
+			}
+			if (match)
+				++found;
+		}
+	}
+	return lit ? (float)found / lit : 1.f;
+}
+
+float
+frame_match_fraction(const unsigned char *a,
+					 const unsigned char *b,
+					 int width,
+					 int height)
+{
+	return std::min(fraction_found(a, b, width, height),
+		fraction_found(b, a, width, height));
+}
@@ -0,0 +1,58 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <vector>
+
+class thread_pool;
+
+// One anti-aliased line, prepared for the tile kernel. Positions are in
+// pixels; along the major axis "minor = intercept + slope*major".
+struct raster_segment {
+	float intercept;
+	float slope;
+	float major_min;
+	float major_max;
+	bool x_major;
+	float color[3];
+};
+
+// Software renderer for scores, drawing the same shapes with the same
+// animation as line.vert/line.frag without needing OpenGL. Segments are
+// binned into tiles and the tiles are drawn in parallel.
+struct cpu_rasterizer {
+	int width;
+	int height;
+	int tiles_x;
+	int tiles_y;
+	thread_pool *pool;
+	std::vector<raster_segment> segments;
+	std::vector< std::vector<int> > bins;	// segment indices for each tile
+};
+
+// Set up a rasterizer for "width" by "height" frames. Tiles are drawn on
+// "pool", or on the calling thread if it's NULL.
+void
+init_cpu_rasterizer(cpu_rasterizer& rasterizer,
+                    int width,
+                    int height,
+                    thread_pool *pool);
+
+// Draw "digits" at animation frame "frame" into "rgb", which holds
+// width*height RGB pixels with the bottom row first, like glReadPixels.
+void
+rasterize_score(cpu_rasterizer& rasterizer,
+                const int *digits,
+                int num_digits,
+                int frame,
+                unsigned char *rgb);
+
+// Compare two frames that may differ in anti-aliasing. Returns the smaller,
+// over both frames, of the fraction of lit pixels that have a lit pixel of
+// similar colour at most one pixel away in the other frame.
+float
+frame_match_fraction(const unsigned char *a,
+                     const unsigned char *b,
+                     int width,
+                     int height);
+
+#endif
@@ -0,0 +1,132 @@
+// glew
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <chrono>
+
+#include "readback.h"
+
+static double
+seconds_now()
+{
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool
+init_pbo_readback(pbo_readback& readback,
+				  int width,
+				  int height,
+				  int ring_size,
+				  std::string& errors)
+{
+	readback.width = width;
+	readback.height = height;
+	readback.next = 0;
+	readback.queued = 0;
+	readback.stats = readback_stats();
+	if (ring_size < 0) {
+		errors.append("a readback ring can't have fewer than 0 buffers\n");
+		return false;
+	}
+	readback.buffers.assign(ring_size, 0);
+	readback.frames.assign(ring_size, -1);
+	readback.queue_times.assign(ring_size, 0.0);
+	readback.queue_counts.assign(ring_size, 0);
+	if (!ring_size) {
+		readback.pixels.resize(width * height * 3);
+		return true;
+	}
+	if (!GLEW_ARB_pixel_buffer_object) {
+		errors.append("reading back through a ring needs pixel buffer "
+			"objects\n");
+		return false;
+	}
+	glGenBuffers(ring_size, &readback.buffers[0]);
+	for (int i = 0 ; i < ring_size ; ++i) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 3, 0,
+			GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return true;
+}
+
+// Map the buffer "slot" and give its frame to "sink"
+static bool
+write_slot(pbo_readback& readback,
+		   int slot,
+		   frame_sink& sink,
+		   std::string& errors)
+{
+	const double start = seconds_now();
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffers[slot]);
+	const unsigned char *pixels =
+		(const unsigned char*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	const double mapped = seconds_now();
+	readback_stats& stats = readback.stats;
+	stats.stall_seconds += mapped - start;
+	stats.latency_seconds += mapped - readback.queue_times[slot];
+	stats.latency_frames += readback.queued - readback.queue_counts[slot];
+	++stats.frames;
+	bool success = pixels != 0;
+	if (!success)
+		errors.append("failed to map pixel buffer\n");
+	else {
+		success = sink.write_frame(pixels, readback.width, readback.height,
+			readback.frames[slot], errors);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readback.frames[slot] = -1;
+	return success;
+}
+
+bool
+queue_readback(pbo_readback& readback,
+			   long long frame,
+			   frame_sink& sink,
+			   std::string& errors)
+{
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	if (readback.buffers.empty()) {
+		const double start = seconds_now();
+		glReadPixels(0, 0, readback.width, readback.height, GL_RGB,
+			GL_UNSIGNED_BYTE, &readback.pixels[0]);
+		readback.stats.stall_seconds += seconds_now() - start;
+		readback.stats.latency_seconds += seconds_now() - start;
+		++readback.stats.frames;
+		return sink.write_frame(&readback.pixels[0], readback.width,
+			readback.height, frame, errors);
+	}
+	const int slot = readback.next;
+	if (readback.frames[slot] >= 0 &&
+		!write_slot(readback, slot, sink, errors))
+		return false;
+	// The copy into the buffer is queued behind the rendering, and this
+	// returns straight away
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffers[slot]);
+	glReadPixels(0, 0, readback.width, readback.height, GL_RGB,
+		GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readback.frames[slot] = frame;
+	readback.queue_times[slot] = seconds_now();
+	readback.queue_counts[slot] = readback.queued++;
+	readback.next = (slot + 1) % (int)readback.buffers.size();
+	return true;
+}
+
+bool
+flush_readbacks(pbo_readback& readback,
+				frame_sink& sink,
+				std::string& errors)
+{
+	const int ring_size = (int)readback.buffers.size();
+	for (int i = 0 ; i < ring_size ; ++i) {
+		const int slot = (readback.next + i) % ring_size;
+		if (readback.frames[slot] >= 0 &&
+			!write_slot(readback, slot, sink, errors))
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,59 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#include <string>
+#include <vector>
+
+#include "frame_sink.h"
+
+struct readback_stats {
+	long long frames;
+	double latency_frames;		// frames queued after a frame before it's read
+	double latency_seconds;		// from queueing a frame to having its pixels
+	double stall_seconds;		// time spent waiting on the GPU for pixels
+};
+
+// Reads frames back from the bound framebuffer through a ring of pixel
+// pack buffers, so the copy runs behind rendering and a frame's pixels are
+// only needed a few frames later. A ring of 0 reads each frame straight
+// away with glReadPixels instead, for comparison.
+struct pbo_readback {
+	int width;
+	int height;
+	std::vector<GLuint> buffers;
+	std::vector<long long> frames;	// frame in each buffer, -1 if none
+	std::vector<double> queue_times;
+	std::vector<long long> queue_counts;
+	int next;					// buffer the next frame goes in
+	long long queued;
+	std::vector<unsigned char> pixels;	// for reading without a ring
+	readback_stats stats;
+};
+
+// Make a ring of "ring_size" buffers for "width" by "height" frames. Needs
+// pixel buffer objects unless "ring_size" is 0. Returns false and gives
+// error messages in "errors" on failure.
+bool
+init_pbo_readback(pbo_readback& readback,
+                  int width,
+                  int height,
+                  int ring_size,
+                  std::string& errors);
+
+// Start reading frame "frame" from the bound framebuffer. If the ring is
+// full, the oldest frame in it is mapped and given to "sink" first,
+// straight from the mapped buffer. Returns false and gives error messages
+// in "errors" if the sink fails.
+bool
+queue_readback(pbo_readback& readback,
+               long long frame,
+               frame_sink& sink,
+               std::string& errors);
+
+// Give every frame still in the ring to "sink", oldest first
+bool
+flush_readbacks(pbo_readback& readback,
+                frame_sink& sink,
+                std::string& errors);
+
+#endif
@@ -0,0 +1,406 @@
+// glew & glfw
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#ifdef _MSC_VER
+#define GLFW_EXPOSE_NATIVE_WIN32
+#define GLFW_EXPOSE_NATIVE_WGL
+#include <GLFW/glfw3native.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include "render.h"
+#include "shader.h"
+
+gl_call_counts gl_calls;
+
+// Set up score.vert, which draws a score's digits as instances of one line
+// list, each fetching its own shape's lines from a float texture
+static bool
+init_instancing(score_renderer& renderer)
+{
+	GLint vertex_texture_units = 0;
+	glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &vertex_texture_units);
+	if (!GLEW_ARB_instanced_arrays || !GLEW_ARB_draw_instanced ||
+		!GLEW_ARB_texture_float || !GLEW_ARB_vertex_array_object ||
+		vertex_texture_units < 1)
+		return false;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &renderer.max_texture_size);
+	std::string errors;
+	if (!make_shader_program("score.vert", "score.frag",
+		renderer.instanced_shader, errors))
+		return false;
+	const GLuint shader = renderer.instanced_shader;
+	renderer.instanced_frame_location = GL_LOOKUP(glGetUniformLocation(shader,
+		"frame"));
+	renderer.corner_location = glGetAttribLocation(shader, "corner");
+	renderer.instance_index_location = glGetAttribLocation(shader, "index");
+	renderer.instance_digit_location = glGetAttribLocation(shader, "digit");
+	if (renderer.corner_location < 0 || renderer.instance_index_location < 0 ||
+		renderer.instance_digit_location < 0)
+		return false;
+
+	glGenTextures(1, &renderer.segment_texture);
+	glBindTexture(GL_TEXTURE_2D, renderer.segment_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(shader);
+	glUniform1f(GL_LOOKUP(glGetUniformLocation(shader, "aspect")),
+		(float)renderer.width/renderer.height);
+	glUniform1i(GL_LOOKUP(glGetUniformLocation(shader, "segments")), 1);
+	glUseProgram(0);
+	glGenBuffers(1, &renderer.corner_buffer);
+	glGenBuffers(1, &renderer.instance_buffer);
+
+	// Record the attribute setup once, so drawing only has to bind it
+	glGenVertexArrays(1, &renderer.instanced_vao);
+	glBindVertexArray(renderer.instanced_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.corner_buffer);
+	glEnableVertexAttribArray(renderer.corner_location);
+	glVertexAttribPointer(renderer.corner_location, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.instance_buffer);
+	glEnableVertexAttribArray(renderer.instance_index_location);
+	glVertexAttribPointer(renderer.instance_index_location, 1, GL_FLOAT,
+		GL_FALSE, 2*sizeof(GLfloat), 0);
+	glVertexAttribDivisorARB(renderer.instance_index_location, 1);
+	glEnableVertexAttribArray(renderer.instance_digit_location);
+	glVertexAttribPointer(renderer.instance_digit_location, 1, GL_FLOAT,
+		GL_FALSE, 2*sizeof(GLfloat), (void*)sizeof(GLfloat));
+	glVertexAttribDivisorARB(renderer.instance_digit_location, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+// Give score.vert the shapes: each one's lines as a row of x0,y0,x1,y1
+// texels, padded out with zero length lines, which draw nothing
+static void
+upload_segment_table(score_renderer& renderer, const shape_arena& arena)
+{
+	const int max_segments = std::max(arena.max_segments, 1);
+	renderer.max_segments = max_segments;
+	std::vector<GLfloat> table(max_segments * NUM_SHAPES * 4, 0.f);
+	for (int i = 0 ; i < NUM_SHAPES ; ++i) {
+		for (int j = 0 ; j < arena.index_counts[i] ; ++j) {
+			const unsigned vertex = arena.indices[arena.first_index[i] + j];
+			GLfloat *texel = &table[(i * max_segments + j / 2) * 4];
+			texel[(j % 2) * 2] = arena.vertices[vertex * 3];
+			texel[(j % 2) * 2 + 1] = arena.vertices[vertex * 3 + 1];
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, renderer.segment_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F_ARB, max_segments, NUM_SHAPES, 0,
+		GL_RGBA, GL_FLOAT, &table[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(renderer.instanced_shader);
+	glUniform2f(GL_LOOKUP(glGetUniformLocation(renderer.instanced_shader,
+		"segments_size")), (float)max_segments, (float)NUM_SHAPES);
+	glUseProgram(0);
+
+	// Both ends of every line slot
+	std::vector<GLfloat> corners;
+	for (int j = 0 ; j < max_segments ; ++j) {
+		corners.push_back((GLfloat)j);
+		corners.push_back(0.f);
+		corners.push_back((GLfloat)j);
+		corners.push_back(1.f);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.corner_buffer);
+	glBufferData(GL_ARRAY_BUFFER, corners.size()*sizeof(GLfloat), &corners[0],
+		GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void
+update_score_shapes(score_renderer& renderer)
+{
+	shape_arena arena;
+	build_shape_arena(arena);
+	for (int i = 0 ; i < NUM_SHAPES ; ++i) {
+		renderer.first_index[i] = arena.first_index[i];
+		renderer.index_counts[i] = arena.index_counts[i];
+	}
+	// The vertices, then the indices, in one buffer
+	const size_t vertex_bytes = arena.vertices.size()*sizeof(GLfloat);
+	const size_t index_bytes = arena.indices.size()*sizeof(GLuint);
+	renderer.index_offset = vertex_bytes;
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.shape_buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertex_bytes + index_bytes, 0,
+		GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_bytes, &arena.vertices[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, vertex_bytes, index_bytes,
+		&arena.indices[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (!renderer.gl_can_instance)
+		return;
+	// A glyph set with very long shapes has more lines than a texture row
+	// holds, and then only draws a digit at a time
+	renderer.can_instance =
+		std::max(arena.max_segments, 1) <= renderer.max_texture_size;
+	if (renderer.can_instance)
+		upload_segment_table(renderer, arena);
+	else
+		renderer.use_instancing = false;
+}
+
+bool
+create_render_target(int width,
+					 int height,
+					 GLuint& frame_buffer,
+					 GLuint& texture,
+					 std::string& errors)
+{
+	glGenFramebuffers(1, &frame_buffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+	// The texture we're going to render to
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	// Give an empty image to OpenGL ( the last "0" )
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
+		GL_UNSIGNED_BYTE, 0);
+	// Use box filter
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	// Set "renderedTexture" as our colour attachement #0
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+		texture, 0); 
+	// Set the list of draw buffers.
+	GLenum DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
+	glDrawBuffers(1, DrawBuffers); // "1" is the size of DrawBuffers
+	// Always check that our framebuffer is ok
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		errors.append("failed to setup framebuffer\n");
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glDeleteFramebuffers(1, &frame_buffer);
+		glDeleteTextures(1, &texture);
+		frame_buffer = 0;
+		texture = 0;
+		return false;
+	}
+	return true;
+}
+
+bool
+init_score_renderer(score_renderer& renderer,
+					int width,
+					int height,
+					std::string& errors)
+{
+	// Zeroed, so delete_score_renderer knows what was made if this fails
+	renderer = score_renderer();
+	renderer.width = width;
+	renderer.height = height;
+	// Init shader
+	if (!make_shader_program("line.vert", "line.frag", renderer.shader,
+		errors))
+		return false;
+	glUseProgram(renderer.shader);
+	glUniform1f(GL_LOOKUP(glGetUniformLocation(renderer.shader, "aspect")),
+		(float)width/height);
+	glUseProgram(0);
+	renderer.frame_location = GL_LOOKUP(glGetUniformLocation(renderer.shader,
+		"frame"));
+	renderer.index_location = GL_LOOKUP(glGetUniformLocation(renderer.shader,
+		"index"));
+	renderer.digit_location = GL_LOOKUP(glGetUniformLocation(renderer.shader,
+		"digit"));
+	// Set up secondary framebuffer for rendering to texture
+	if (!create_render_target(width, height, renderer.frame_buffer,
+		renderer.rendered_texture, errors))
+		return false;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	renderer.gl_can_instance = init_instancing(renderer);
+	renderer.can_instance = renderer.gl_can_instance;
+	renderer.use_instancing = renderer.can_instance;
+	// Init geometry
+	glGenBuffers(1, &renderer.shape_buffer);
+	update_score_shapes(renderer);
+	return true;
+}
+
+void
+delete_score_renderer(score_renderer& renderer)
+{
+	glDeleteProgram(renderer.shader);
+	glDeleteProgram(renderer.instanced_shader);
+	glDeleteFramebuffers(1, &renderer.frame_buffer);
+	glDeleteTextures(1, &renderer.rendered_texture);
+	glDeleteTextures(1, &renderer.segment_texture);
+	glDeleteBuffers(1, &renderer.shape_buffer);
+	glDeleteBuffers(1, &renderer.corner_buffer);
+	glDeleteBuffers(1, &renderer.instance_buffer);
+	// Only made, and only there to call, if the GL has vertex array objects
+	if (renderer.instanced_vao)
+		glDeleteVertexArrays(1, &renderer.instanced_vao);
+	renderer = score_renderer();
+}
+
+// One draw per digit, all from the shared buffers
+static void
+render_digits(const score_renderer& renderer,
+			  const int *digits,
+			  int num_digits,
+			  float frame)
+{
+	GL_STATE(glUseProgram(renderer.shader));
+	GL_STATE(glUniform1f(renderer.frame_location, frame));
+	GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, renderer.shape_buffer));
+	GL_STATE(glEnableClientState(GL_VERTEX_ARRAY));
+	GL_STATE(glVertexPointer(3, GL_FLOAT, 0, 0));
+	GL_STATE(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer.shape_buffer));
+	for (int i = 0 ; i < num_digits ; ++i)
+	{
+		const int type = digits[i];
+		GL_STATE(glUniform1i(renderer.index_location, i));
+		GL_STATE(glUniform1i(renderer.digit_location, type));
+		GL_DRAW(glDrawElements(GL_LINES, renderer.index_counts[type],
+			GL_UNSIGNED_INT, (void*)(renderer.index_offset +
+			renderer.first_index[type]*sizeof(GLuint))));
+	}
+}
+
+// The whole score in one instanced draw
+static void
+render_instanced(const score_renderer& renderer,
+				 const int *digits,
+				 int num_digits,
+				 float frame)
+{
+	GLfloat instances[NUM_DIGITS * 2];
+	for (int i = 0 ; i < num_digits ; ++i) {
+		instances[i*2] = (GLfloat)i;
+		instances[i*2+1] = (GLfloat)digits[i];
+	}
+	GL_STATE(glUseProgram(renderer.instanced_shader));
+	GL_STATE(glUniform1f(renderer.instanced_frame_location, frame));
+	GL_STATE(glActiveTexture(GL_TEXTURE1));
+	GL_STATE(glBindTexture(GL_TEXTURE_2D, renderer.segment_texture));
+	GL_STATE(glActiveTexture(GL_TEXTURE0));
+	GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, renderer.instance_buffer));
+	GL_STATE(glBufferData(GL_ARRAY_BUFFER, num_digits*2*sizeof(GLfloat),
+		instances, GL_STREAM_DRAW));
+	GL_STATE(glBindVertexArray(renderer.instanced_vao));
+	GL_DRAW(glDrawArraysInstancedARB(GL_LINES, 0, renderer.max_segments * 2,
+		num_digits));
+	GL_STATE(glBindVertexArray(0));
+}
+
+void
+render_score(const score_renderer& renderer,
+			 const int *digits,
+			 int num_digits,
+			 float frame)
+{
+	// Render to texture
+	GL_STATE(glBindFramebuffer(GL_FRAMEBUFFER, renderer.frame_buffer));
+	GL_STATE(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
+	glClear(GL_COLOR_BUFFER_BIT);
+	render_score_at(renderer, digits, num_digits, frame, 0, 0);
+}
+
+void
+render_score_at(const score_renderer& renderer,
+				const int *digits,
+				int num_digits,
+				float frame,
+				int x,
+				int y)
+{
+	GL_STATE(glViewport(x, y, renderer.width, renderer.height));
+	// The instanced path's per-digit attributes only have room for a score
+	num_digits = std::min(num_digits, NUM_DIGITS);
+	if (renderer.use_instancing)
+		render_instanced(renderer, digits, num_digits, frame);
+	else
+		render_digits(renderer, digits, num_digits, frame);
+}
+
+bool
+init_vertex_capture(vertex_capture& capture,
+					const score_renderer& renderer,
+					std::string& errors)
+{
+	if (!GLEW_VERSION_3_0) {
+		errors.append("transform feedback needs GL 3.0\n");
+		return false;
+	}
+	if (!make_relinkable_shader_program("line.vert", "line.frag",
+		capture.shader, errors))
+		return false;
+	const char *varyings[] = {"gl_Position"};
+	glTransformFeedbackVaryings(capture.shader, 1, varyings,
+		GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(capture.shader);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(capture.shader, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		errors.append("failed to relink line.vert for transform feedback\n");
+		return false;
+	}
+	glUseProgram(capture.shader);
+	glUniform1f(GL_LOOKUP(glGetUniformLocation(capture.shader, "aspect")),
+		(float)renderer.width/renderer.height);
+	glUseProgram(0);
+	capture.frame_location = GL_LOOKUP(glGetUniformLocation(capture.shader,
+		"frame"));
+	capture.index_location = GL_LOOKUP(glGetUniformLocation(capture.shader,
+		"index"));
+	// Room for the most lines a score can have
+	int most_indices = 0;
+	for (int i = 0 ; i < NUM_SHAPES ; ++i)
+		most_indices = std::max(most_indices, renderer.index_counts[i]);
+	glGenBuffers(1, &capture.buffer);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, capture.buffer);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER,
+		NUM_DIGITS * most_indices * 4 * sizeof(GLfloat), 0, GL_STREAM_READ);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+	return true;
+}
+
+void
+capture_score_vertices(const vertex_capture& capture,
+					   const score_renderer& renderer,
+					   const int *digits,
+					   int num_digits,
+					   int frame,
+					   std::vector<float>& positions)
+{
+	int num_vertices = 0;
+	for (int i = 0 ; i < num_digits ; ++i)
+		num_vertices += renderer.index_counts[digits[i]];
+	// Nothing gets drawn, but with no window there's no default framebuffer
+	// to be complete
+	glBindFramebuffer(GL_FRAMEBUFFER, renderer.frame_buffer);
+	glUseProgram(capture.shader);
+	glUniform1f(capture.frame_location, (float)frame);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.shape_buffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer.shape_buffer);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, capture.buffer);
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBeginTransformFeedback(GL_LINES);
+	for (int i = 0 ; i < num_digits ; ++i) {
+		const int type = digits[i];
+		glUniform1i(capture.index_location, i);
+		glDrawElements(GL_LINES, renderer.index_counts[type], GL_UNSIGNED_INT,
+			(void*)(renderer.index_offset +
+			renderer.first_index[type]*sizeof(GLuint)));
+	}
+	glEndTransformFeedback();
+	glDisable(GL_RASTERIZER_DISCARD);
+	positions.resize(num_vertices * 4);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, capture.buffer);
+	glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0,
+		positions.size()*sizeof(GLfloat), &positions[0]);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glUseProgram(0);
+}
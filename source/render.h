@@ -0,0 +1,135 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <string>
+#include <vector>
+
+#include "shapes.h"
+
+// How many GL calls of each kind the score rendering has made, so changes to
+// it can be measured. Reset it at the start of each frame.
+struct gl_call_counts {
+	int draw_calls;
+	int uniform_lookups;
+	int state_changes;	// binds, enables, pointers, uniforms and uploads
+};
+
+extern gl_call_counts gl_calls;
+
+// Make a GL call and count it in gl_calls, as in GL_STATE(glUseProgram(p)),
+// so the counts come from the calls themselves
+#define GL_DRAW(call) (++gl_calls.draw_calls, call)
+#define GL_LOOKUP(call) (++gl_calls.uniform_lookups, call)
+#define GL_STATE(call) (++gl_calls.state_changes, call)
+
+// Everything needed to draw a score into an offscreen texture.
+struct score_renderer {
+	int width;
+	int height;
+	GLuint frame_buffer;
+	GLuint rendered_texture;
+	// Every shape's geometry in one buffer, the indices after the vertices
+	GLuint shape_buffer;
+	size_t index_offset;		// bytes
+	int first_index[NUM_SHAPES];
+	int index_counts[NUM_SHAPES];
+	// Drawing one digit at a time with line.vert
+	GLuint shader;
+	GLint frame_location;
+	GLint index_location;
+	GLint digit_location;
+	// Drawing a whole score at once with score.vert, if the GL can and the
+	// shapes' lines fit in a texture
+	bool gl_can_instance;
+	bool can_instance;
+	bool use_instancing;
+	GLuint instanced_shader;
+	GLint instanced_frame_location;
+	GLint corner_location;
+	GLint instance_index_location;
+	GLint instance_digit_location;
+	GLuint segment_texture;		// every shape's lines, one row per shape
+	GLuint corner_buffer;		// which end of which line each vertex is
+	GLuint instance_buffer;		// index and digit of each instance
+	GLuint instanced_vao;
+	int max_segments;
+	GLint max_texture_size;		// widest segment table the GL takes
+};
+
+// Create the line shaders, the offscreen framebuffer with its texture and
+// the shape geometry. Only call this after OpenGL has started. Returns false
+// and gives error messages in "errors" on failure.
+bool
+init_score_renderer(score_renderer& renderer,
+                    int width,
+                    int height,
+                    std::string& errors);
+
+// Delete everything init_score_renderer made, even if it failed partway
+void
+delete_score_renderer(score_renderer& renderer);
+
+// Upload "shapes" again after they've changed. Turns instancing off if
+// they have too many lines for it.
+void
+update_score_shapes(score_renderer& renderer);
+
+// Create a framebuffer drawing into a new RGB texture of the given size,
+// left bound. Returns false and gives error messages in "errors" on failure,
+// deleting what it made.
+bool
+create_render_target(int width,
+                     int height,
+                     GLuint& frame_buffer,
+                     GLuint& texture,
+                     std::string& errors);
+
+// Render "digits" at animation frame "frame", which can fall between two
+// frames, into the renderer's texture, in one draw if instancing is
+// available and turned on, otherwise one draw per digit. Digits past
+// NUM_DIGITS aren't drawn. Leaves the offscreen framebuffer bound.
+void
+render_score(const score_renderer& renderer,
+             const int *digits,
+             int num_digits,
+             float frame);
+
+// Render "digits" like render_score, but into whichever framebuffer is
+// bound, at "x", "y" in it, and without clearing it first, so a batch of
+// frames can share one render target and be read back together
+void
+render_score_at(const score_renderer& renderer,
+                const int *digits,
+                int num_digits,
+                float frame,
+                int x,
+                int y);
+
+// line.vert relinked to hand back its vertex positions with transform
+// feedback instead of drawing, to check CPU transforms against.
+struct vertex_capture {
+	GLuint shader;
+	GLint frame_location;
+	GLint index_location;
+	GLuint buffer;
+};
+
+// Needs GL 3.0. Returns false and gives error messages in "errors" on
+// failure.
+bool
+init_vertex_capture(vertex_capture& capture,
+                    const score_renderer& renderer,
+                    std::string& errors);
+
+// Run line.vert over every line of "digits" at animation frame "frame",
+// setting "positions" to the clip space x,y,z,w of both ends of each line,
+// digit by digit in shape order
+void
+capture_score_vertices(const vertex_capture& capture,
+                       const score_renderer& renderer,
+                       const int *digits,
+                       int num_digits,
+                       int frame,
+                       std::vector<float>& positions);
+
+#endif
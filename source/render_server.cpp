@@ -0,0 +1,783 @@
+// glew
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <poll.h>
+#include <signal.h>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "frame_cache.h"
+#include "frame_sink.h"
+#include "gif.h"
+#include "headless.h"
+#include "line_transform.h"
+#include "render.h"
+#include "render_server.h"
+#include "sim_clock.h"
+#include "time_histogram.h"
+
+// Biggest frames asked for are 2400x1200
+static const int MAX_SCALE = 8;
+// Raw frames one request can ask for, before encoding
+static const size_t MAX_REQUEST_BYTES = 256 << 20;
+// Frames one request's range can span, however small they are
+static const long long MAX_REQUEST_FRAMES = 1 << 20;
+// Longest request line taken before the client is dropped
+static const size_t MAX_LINE = 1024;
+// Replies a client can have waiting to go out before the server stops
+// reading its requests, so one that asks and never reads can't fill memory
+static const size_t MAX_CLIENT_BACKLOG = 2 * MAX_REQUEST_BYTES;
+// Request text read ahead of parsing; the rest waits in the socket
+static const size_t MAX_CLIENT_INPUT = 64 << 10;
+// Tallest shared render target, however many frames fit in it
+static const int MAX_BATCH_HEIGHT = 4096;
+// Seconds the request rate is counted over
+static const int RATE_SECONDS = 10;
+
+// Written to wake the server's poll when it's told to stop
+static int stop_pipe[2] = {-1, -1};
+static std::atomic<bool> stopping(false);
+
+enum request_type {
+	REQUEST_RENDER,
+	REQUEST_STATS,
+	REQUEST_BAD,
+};
+
+enum request_format {
+	FORMAT_RGB,
+	FORMAT_Y4M,
+	FORMAT_GIF,
+};
+
+// One line from a client, waiting to be answered
+struct server_request {
+	int client;
+	request_type type;
+	std::string problem;		// what's wrong with a bad one
+	int digits[NUM_DIGITS];
+	long long first_frame;
+	long long num_frames;
+	int scale;
+	request_format format;
+	std::chrono::steady_clock::time_point arrived;
+	std::vector<unsigned char> pixels;	// every frame, bottom row first
+};
+
+struct server_client {
+	int fd;
+	std::string in;				// read, up to the last whole line
+	std::vector<unsigned char> out;	// replies still to send
+	size_t sent;
+	bool done_reading;			// it's closed its end, or sent too much
+	bool failed;
+};
+
+// Everything drawn at one scale: a renderer the size of a frame, a target
+// tall enough to stack a batch of frames in, and the frames already drawn
+struct scale_target {
+	bool ready;
+	std::string failure;		// why it couldn't be made, if it couldn't
+	score_renderer renderer;
+	GLuint batch_frame_buffer;
+	GLuint batch_texture;
+	int batch_frames;
+	frame_cache cache;
+};
+
+// A frame to draw, with the requests waiting on it
+struct pending_frame {
+	uint64_t key;
+	int phase;
+	int request;
+	long long frame;			// within the request
+};
+
+struct server_state {
+	const server_job *job;
+	scale_target targets[MAX_SCALE];
+	std::vector<server_client> clients;
+	server_stats stats;
+	time_histogram latency;
+	std::chrono::steady_clock::time_point start;
+	long long second_counts[RATE_SECONDS];
+	long long counted_second;
+	long long cache_hits;
+	std::vector<unsigned char> batch_pixels;
+};
+
+static void
+handle_stop_signal(int)
+{
+	stop_render_server();
+}
+
+void
+stop_render_server()
+{
+	stopping = true;
+	if (stop_pipe[1] >= 0) {
+		const char wake = 0;
+		if (write(stop_pipe[1], &wake, 1) < 0) {
+			// The pipe is full, so the server has been woken already
+		}
+	}
+}
+
+static bool
+set_non_blocking(int fd)
+{
+	const int flags = fcntl(fd, F_GETFL);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Listen on "path", taking it over from a server that's gone but left its
+// socket behind, though not from one that's still there
+static int
+open_listener(const char *path, std::string& errors)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		errors.append(std::string("socket path too long: ") + path + "\n");
+		return -1;
+	}
+	strcpy(address.sun_path, path);
+	struct stat status;
+	if (!lstat(path, &status)) {
+		if (!S_ISSOCK(status.st_mode)) {
+			errors.append(std::string(path) + " is there and isn't a socket\n");
+			return -1;
+		}
+		const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		const bool live = probe >= 0 &&
+			!connect(probe, (const sockaddr*)&address, sizeof(address));
+		if (probe >= 0)
+			close(probe);
+		if (live) {
+			errors.append(std::string("already serving on ") + path + "\n");
+			return -1;
+		}
+		unlink(path);
+	}
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, (const sockaddr*)&address, sizeof(address)) ||
+		listen(fd, SOMAXCONN) || !set_non_blocking(fd)) {
+		errors.append(std::string("failed to listen on ") + path + ": " +
+			strerror(errno) + "\n");
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Parse "render ..." after the command
+static bool
+parse_render(std::istringstream& line,
+			 server_request& request,
+			 std::string& problem)
+{
+	std::string digits;
+	if (!(line >> digits) || digits.size() > (size_t)NUM_DIGITS) {
+		problem = "expected up to " + std::to_string(NUM_DIGITS) +
+			" digits, least significant first";
+		return false;
+	}
+	std::fill(request.digits, request.digits + NUM_DIGITS, 0);
+	for (size_t i = 0 ; i < digits.size() ; ++i) {
+		const int digit = digits[i] - '0';
+		if (digit < 0 || digit >= NUM_SHAPES) {
+			problem = "digits go from 0 to " + std::to_string(NUM_SHAPES - 1);
+			return false;
+		}
+		request.digits[i] = digit;
+	}
+	request.first_frame = 0;
+	request.num_frames = 1;
+	request.scale = 1;
+	request.format = FORMAT_RGB;
+	std::string name;
+	while (line >> name) {
+		std::string value;
+		if (!(line >> value)) {
+			problem = "expected a value after " + name;
+			return false;
+		}
+		if (name == "frame" || name == "frames") {
+			long long first, last;
+			char dash;
+			std::istringstream range(value);
+			if (!(range >> first) || first < 0) {
+				problem = "expected a frame number from 0";
+				return false;
+			}
+			last = first;
+			if ((range >> dash) && (dash != '-' || !(range >> last) ||
+				last < first)) {
+				problem = "expected frames FIRST-LAST";
+				return false;
+			}
+			if (last - first >= MAX_REQUEST_FRAMES) {
+				problem = "at most " + std::to_string(MAX_REQUEST_FRAMES) +
+					" frames";
+				return false;
+			}
+			request.first_frame = first;
+			request.num_frames = last - first + 1;
+		}
+		else if (name == "scale") {
+			request.scale = atoi(value.c_str());
+			if (request.scale < 1 || request.scale > MAX_SCALE) {
+				problem = "scale goes from 1 to " + std::to_string(MAX_SCALE);
+				return false;
+			}
+		}
+		else if (name == "format") {
+			if (value == "rgb")
+				request.format = FORMAT_RGB;
+			else if (value == "y4m")
+				request.format = FORMAT_Y4M;
+			else if (value == "gif")
+				request.format = FORMAT_GIF;
+			else {
+				problem = "formats are rgb, y4m and gif";
+				return false;
+			}
+		}
+		else {
+			problem = "unknown option \"" + name + "\"";
+			return false;
+		}
+	}
+	return true;
+}
+
+static void
+parse_request(const std::string& text, server_request& request)
+{
+	std::istringstream line(text);
+	std::string command;
+	line >> command;
+	request.type = REQUEST_BAD;
+	if (command == "render") {
+		if (parse_render(line, request, request.problem))
+			request.type = REQUEST_RENDER;
+	}
+	else if (command == "stats") {
+		request.type = REQUEST_STATS;
+	}
+	else {
+		request.problem = "unknown command \"" + command + "\"";
+	}
+}
+
+// Bytes of replies "client" has waiting to go out
+static size_t
+unsent_bytes(const server_client& client)
+{
+	return client.out.size() - client.sent;
+}
+
+// Whether "client" can have more of its requests read and answered
+static bool
+can_take_requests(const server_client& client)
+{
+	return !client.failed && unsent_bytes(client) < MAX_CLIENT_BACKLOG;
+}
+
+// Whether "client" has whole lines read but held back until its replies go
+static bool
+has_held_requests(const server_client& client)
+{
+	return client.in.find('\n') != std::string::npos;
+}
+
+// About what "request"'s reply will take, as raw frames
+static size_t
+reply_bytes(const server_state& server, const server_request& request)
+{
+	if (request.type != REQUEST_RENDER)
+		return 0;
+	const size_t frame_size = (size_t)server.job->width *
+		server.job->height * 3 * request.scale * request.scale;
+	return (size_t)std::min((unsigned long long)request.num_frames,
+		(unsigned long long)(MAX_REQUEST_BYTES / frame_size + 1)) * frame_size;
+}
+
+// Read what "client" has sent, adding its whole lines to "requests" until
+// its replies would pass MAX_CLIENT_BACKLOG. Lines past that are kept for
+// once the replies have gone.
+static void
+read_client(server_state& server,
+			int index,
+			std::vector<server_request>& requests)
+{
+	server_client& client = server.clients[index];
+	if (!can_take_requests(client))
+		return;
+	char buffer[4096];
+	while (!client.done_reading && client.in.size() < MAX_CLIENT_INPUT) {
+		const ssize_t got = read(client.fd, buffer, sizeof(buffer));
+		if (got > 0) {
+			client.in.append(buffer, got);
+			continue;
+		}
+		if (got == 0)
+			client.done_reading = true;
+		else if (errno == EINTR)
+			continue;
+		else if (errno != EAGAIN && errno != EWOULDBLOCK)
+			client.failed = true;
+		break;
+	}
+	const auto now = std::chrono::steady_clock::now();
+	size_t backlog = unsent_bytes(client);
+	size_t start = 0;
+	for (size_t end ; backlog < MAX_CLIENT_BACKLOG &&
+		(end = client.in.find('\n', start)) != std::string::npos ;
+		start = end + 1) {
+		std::string line = client.in.substr(start, end - start);
+		if (!line.empty() && line[line.size() - 1] == '\r')
+			line.resize(line.size() - 1);
+		if (line.find_first_not_of(" \t") == std::string::npos)
+			continue;
+		requests.push_back(server_request());
+		server_request& request = requests.back();
+		request.client = index;
+		request.arrived = now;
+		parse_request(line, request);
+		backlog += reply_bytes(server, request);
+	}
+	client.in.erase(0, start);
+	if (!has_held_requests(client) && client.in.size() > MAX_LINE) {
+		client.failed = true;
+		client.in.clear();
+	}
+}
+
+// Send as much of "client"'s replies as it will take without waiting
+static void
+write_client(server_client& client)
+{
+	while (client.sent < client.out.size()) {
+		const ssize_t put = write(client.fd, &client.out[client.sent],
+			client.out.size() - client.sent);
+		if (put > 0)
+			client.sent += put;
+		else if (put < 0 && errno == EINTR)
+			continue;
+		else {
+			if (put < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+				client.failed = true;
+			break;
+		}
+	}
+	// Drop what's gone from the front once it's most of the buffer, so a
+	// client always a little behind doesn't grow it forever
+	if (client.sent == client.out.size()) {
+		client.out.clear();
+		client.sent = 0;
+	}
+	else if (client.sent > unsent_bytes(client)) {
+		client.out.erase(client.out.begin(), client.out.begin() + client.sent);
+		client.sent = 0;
+	}
+}
+
+static void
+reply(server_state& server, const server_request& request,
+	  const void *body, size_t size)
+{
+	server_client& client = server.clients[request.client];
+	const std::string header = "ok " + std::to_string(size) + "\n";
+	client.out.insert(client.out.end(), header.begin(), header.end());
+	const unsigned char *bytes = (const unsigned char*)body;
+	client.out.insert(client.out.end(), bytes, bytes + size);
+}
+
+static void
+reply_error(server_state& server, const server_request& request,
+			const std::string& problem)
+{
+	server_client& client = server.clients[request.client];
+	const std::string line = "error " + problem + "\n";
+	client.out.insert(client.out.end(), line.begin(), line.end());
+}
+
+// Requests/sec over the last RATE_SECONDS, counting one answered now if
+// "add"
+static double
+count_request(server_state& server, bool add)
+{
+	const double uptime = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - server.start).count();
+	const long long second = (long long)uptime;
+	for (long long s = std::max(server.counted_second + 1,
+		second - RATE_SECONDS + 1) ; s <= second ; ++s)
+		server.second_counts[s % RATE_SECONDS] = 0;
+	server.counted_second = std::max(server.counted_second, second);
+	if (add)
+		++server.second_counts[second % RATE_SECONDS];
+	long long total = 0;
+	for (int i = 0 ; i < RATE_SECONDS ; ++i)
+		total += server.second_counts[i];
+	return total / std::min(std::max(uptime, 1e-3), (double)RATE_SECONDS);
+}
+
+static void
+reply_stats(server_state& server, const server_request& request)
+{
+	const server_stats& stats = server.stats;
+	char text[512];
+	const int size = snprintf(text, sizeof(text),
+		"requests %lld\n"
+		"requests_per_second %.1f\n"
+		"latency_p50_ms %.3f\n"
+		"latency_p99_ms %.3f\n"
+		"latency_max_ms %.3f\n"
+		"failed %lld\n"
+		"frames %lld\n"
+		"frames_rendered %lld\n"
+		"frames_cached %lld\n"
+		"batches %lld\n"
+		"clients %zu\n",
+		stats.requests, count_request(server, false),
+		window_percentile(server.latency, 50.0),
+		window_percentile(server.latency, 99.0), window_max(server.latency),
+		stats.failed, stats.frames, stats.frames_rendered, server.cache_hits,
+		stats.batches, server.clients.size());
+	reply(server, request, text, std::min(size, (int)sizeof(text) - 1));
+}
+
+// The renderer and batch target for "scale", made the first time it's asked
+// for
+static scale_target *
+get_target(server_state& server, int scale, std::string& errors)
+{
+	scale_target& target = server.targets[scale - 1];
+	if (target.ready)
+		return &target;
+	// Don't try again on every request once it's failed
+	if (!target.failure.empty()) {
+		errors.append(target.failure);
+		return 0;
+	}
+	const int width = server.job->width * scale;
+	const int height = server.job->height * scale;
+	GLint max_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	target.batch_frames = std::max(std::min(MAX_BATCH_HEIGHT,
+		(int)max_size) / height, 1);
+	std::string problem;
+	if (!init_score_renderer(target.renderer, width, height, problem) ||
+		!create_render_target(width, height * target.batch_frames,
+		target.batch_frame_buffer, target.batch_texture, problem)) {
+		delete_score_renderer(target.renderer);
+		target.failure = problem.empty() ? "failed to make renderer\n" :
+			problem;
+		errors.append(target.failure);
+		return 0;
+	}
+	if (!server.job->use_instancing)
+		target.renderer.use_instancing = false;
+	init_frame_cache(target.cache, width * height * 3,
+		(size_t)server.job->frame_cache_mb << 20);
+	target.ready = true;
+	return &target;
+}
+
+static bool
+pending_before(const pending_frame& a, const pending_frame& b)
+{
+	return a.key < b.key;
+}
+
+// Draw every frame in "pending" at "target"'s scale that isn't already in
+// its cache, as many to a pass as its batch target holds, and copy them to
+// the requests waiting on them
+static void
+render_pending(server_state& server,
+			   scale_target& target,
+			   std::vector<pending_frame>& pending,
+			   std::vector<server_request>& requests)
+{
+	const score_renderer& renderer = target.renderer;
+	const size_t frame_size = (size_t)renderer.width * renderer.height * 3;
+	// The same frame asked for twice is drawn once
+	std::stable_sort(pending.begin(), pending.end(), pending_before);
+	std::vector<size_t> unique;
+	for (size_t i = 0 ; i < pending.size() ; ++i)
+		if (!i || pending[i].key != pending[i - 1].key)
+			unique.push_back(i);
+	unique.push_back(pending.size());
+	server.batch_pixels.resize(frame_size * target.batch_frames);
+	for (size_t first = 0 ; first + 1 < unique.size() ;
+		first += target.batch_frames) {
+		const int count = (int)std::min((size_t)target.batch_frames,
+			unique.size() - 1 - first);
+		glBindFramebuffer(GL_FRAMEBUFFER, target.batch_frame_buffer);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		for (int i = 0 ; i < count ; ++i) {
+			const pending_frame& frame = pending[unique[first + i]];
+			render_score_at(renderer, requests[frame.request].digits,
+				NUM_DIGITS, (float)frame.phase, 0, i * renderer.height);
+		}
+		glReadPixels(0, 0, renderer.width, renderer.height * count, GL_RGB,
+			GL_UNSIGNED_BYTE, &server.batch_pixels[0]);
+		++server.stats.batches;
+		server.stats.frames_rendered += count;
+		for (int i = 0 ; i < count ; ++i) {
+			const unsigned char *pixels = &server.batch_pixels[i * frame_size];
+			const pending_frame& drawn = pending[unique[first + i]];
+			memcpy(store_frame(target.cache, requests[drawn.request].digits,
+				drawn.phase), pixels, frame_size);
+			for (size_t j = unique[first + i] ; j < unique[first + i + 1] ;
+				++j) {
+				server_request& request = requests[pending[j].request];
+				memcpy(&request.pixels[pending[j].frame * frame_size], pixels,
+					frame_size);
+			}
+		}
+	}
+}
+
+// Encode "request"'s frames as it asked, through the same sinks as --output
+static bool
+encode_frames(const server_request& request,
+			  int width,
+			  int height,
+			  std::vector<unsigned char>& bytes,
+			  std::string& errors)
+{
+	char *buffer = 0;
+	size_t size = 0;
+	FILE *out = open_memstream(&buffer, &size);
+	if (!out) {
+		errors.append(std::string("failed to encode: ") + strerror(errno));
+		return false;
+	}
+	// A GIF sets up its palette as it's made, so only make the sink needed.
+	// Requests are small, so each is encoded on the server's own thread.
+	std::unique_ptr<frame_sink> sink;
+	if (request.format == FORMAT_GIF)
+		sink.reset(new gif_sink(out, SIM_FRAMES_PER_SECOND, 1));
+	else
+		sink.reset(new stream_sink(out, request.format == FORMAT_Y4M ?
+			STREAM_Y4M : STREAM_RGB, SIM_FRAMES_PER_SECOND));
+	const size_t frame_size = (size_t)width * height * 3;
+	bool good = true;
+	for (long long i = 0 ; good && i < request.num_frames ; ++i)
+		good = sink->write_frame(&request.pixels[i * frame_size], width,
+			height, request.first_frame + i, errors);
+	good = good && sink->finish(errors);
+	sink.reset();
+	fclose(out);
+	if (good)
+		bytes.assign(buffer, buffer + size);
+	free(buffer);
+	return good;
+}
+
+// Answer every request read this time round, in order, drawing the frames
+// none of them have cached together
+static void
+answer_requests(server_state& server, std::vector<server_request>& requests)
+{
+	std::vector<pending_frame> pending[MAX_SCALE];
+	for (size_t r = 0 ; r < requests.size() ; ++r) {
+		server_request& request = requests[r];
+		if (request.type != REQUEST_RENDER)
+			continue;
+		std::string errors;
+		const size_t frame_size = (size_t)server.job->width *
+			server.job->height * 3 * request.scale * request.scale;
+		if ((size_t)request.num_frames > MAX_REQUEST_BYTES / frame_size) {
+			request.type = REQUEST_BAD;
+			request.problem = "at most " + std::to_string(MAX_REQUEST_BYTES /
+				frame_size) + " frames at scale " +
+				std::to_string(request.scale);
+			continue;
+		}
+		scale_target *target = get_target(server, request.scale, errors);
+		if (!target) {
+			request.type = REQUEST_BAD;
+			request.problem = "can't render at scale " +
+				std::to_string(request.scale) + ": " +
+				errors.substr(0, errors.find('\n'));
+			continue;
+		}
+		request.pixels.resize(request.num_frames * frame_size);
+		for (long long i = 0 ; i < request.num_frames ; ++i) {
+			const int phase = (int)((request.first_frame + i) %
+				ANIMATION_PERIOD);
+			const unsigned char *cached = find_frame(target->cache,
+				request.digits, phase);
+			if (cached) {
+				memcpy(&request.pixels[i * frame_size], cached, frame_size);
+				++server.cache_hits;
+			}
+			else {
+				pending_frame frame = {frame_key(request.digits, phase), phase,
+					(int)r, i};
+				pending[request.scale - 1].push_back(frame);
+			}
+		}
+	}
+	for (int s = 0 ; s < MAX_SCALE ; ++s)
+		if (!pending[s].empty())
+			render_pending(server, server.targets[s], pending[s], requests);
+
+	for (server_request& request : requests) {
+		if (request.type == REQUEST_STATS) {
+			reply_stats(server, request);
+			continue;
+		}
+		++server.stats.requests;
+		std::vector<unsigned char> bytes;
+		std::string errors;
+		if (request.type == REQUEST_RENDER &&
+			!encode_frames(request, server.job->width * request.scale,
+			server.job->height * request.scale, bytes, errors)) {
+			request.type = REQUEST_BAD;
+			request.problem = errors.substr(0, errors.find('\n'));
+		}
+		if (request.type == REQUEST_BAD) {
+			++server.stats.failed;
+			reply_error(server, request, request.problem);
+		}
+		else {
+			server.stats.frames += request.num_frames;
+			reply(server, request, bytes.data(), bytes.size());
+		}
+		std::vector<unsigned char>().swap(request.pixels);
+		add_time(server.latency, std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - request.arrived).count());
+		count_request(server, true);
+	}
+}
+
+bool
+run_render_server(const server_job& job,
+				  server_stats& stats,
+				  std::string& errors)
+{
+	std::unique_ptr<server_state> server(new server_state());
+	server->job = &job;
+	init_time_histogram(server->latency, "request");
+	if (!init_headless_gl(errors))
+		return false;
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	// Make scale 1 now, so the first request doesn't wait on compiling
+	if (!get_target(*server, 1, errors)) {
+		shutdown_headless_gl();
+		return false;
+	}
+	const int listener = open_listener(job.socket_path, errors);
+	if (listener < 0) {
+		shutdown_headless_gl();
+		return false;
+	}
+	if (pipe(stop_pipe)) {
+		errors.append(std::string("failed to make a pipe: ") +
+			strerror(errno) + "\n");
+		close(listener);
+		unlink(job.socket_path);
+		shutdown_headless_gl();
+		return false;
+	}
+	set_non_blocking(stop_pipe[0]);
+	set_non_blocking(stop_pipe[1]);
+	// A client going away mid-reply fails the write instead
+	signal(SIGPIPE, SIG_IGN);
+	void (*old_interrupt)(int) = signal(SIGINT, handle_stop_signal);
+	void (*old_terminate)(int) = signal(SIGTERM, handle_stop_signal);
+
+	server->start = std::chrono::steady_clock::now();
+	std::vector<pollfd> polled;
+	std::vector<server_request> requests;
+	while (!stopping) {
+		polled.clear();
+		const pollfd wake = {stop_pipe[0], POLLIN, 0};
+		const pollfd incoming = {listener, POLLIN, 0};
+		polled.push_back(wake);
+		polled.push_back(incoming);
+		// Clients with their replies backed up aren't read until they've
+		// taken some, and ones with requests held back until then don't
+		// wait for more
+		bool held = false;
+		for (const server_client& client : server->clients) {
+			const bool taking = can_take_requests(client);
+			pollfd watch = {client.fd, (short)((client.done_reading ||
+				!taking ? 0 : POLLIN) | (client.out.empty() ? 0 : POLLOUT)),
+				0};
+			polled.push_back(watch);
+			held = held || (taking && has_held_requests(client));
+		}
+		if (poll(&polled[0], polled.size(), held ? 0 : -1) < 0 &&
+			errno != EINTR) {
+			errors.append(std::string("failed to wait for clients: ") +
+				strerror(errno) + "\n");
+			break;
+		}
+		for (int fd ; (fd = accept(listener, 0, 0)) >= 0 ; ) {
+			set_non_blocking(fd);
+			server_client client = {fd, std::string(),
+				std::vector<unsigned char>(), 0, false, false};
+			server->clients.push_back(client);
+			++server->stats.clients;
+		}
+		// Clients just taken on weren't polled, but reading finds nothing
+		for (size_t i = 0 ; i < server->clients.size() ; ++i)
+			read_client(*server, (int)i, requests);
+		if (!requests.empty()) {
+			answer_requests(*server, requests);
+			requests.clear();
+		}
+		// Send what's ready, and drop clients that are finished with
+		size_t kept = 0;
+		for (size_t i = 0 ; i < server->clients.size() ; ++i) {
+			server_client& client = server->clients[i];
+			if (!client.failed)
+				write_client(client);
+			if (client.failed || (client.done_reading && client.out.empty() &&
+				!has_held_requests(client)))
+				close(client.fd);
+			else
+				std::swap(server->clients[kept++], client);
+		}
+		server->clients.resize(kept);
+	}
+
+	for (const server_client& client : server->clients)
+		close(client.fd);
+	close(listener);
+	unlink(job.socket_path);
+	close(stop_pipe[0]);
+	close(stop_pipe[1]);
+	stop_pipe[0] = stop_pipe[1] = -1;
+	stopping = false;
+	signal(SIGINT, old_interrupt);
+	signal(SIGTERM, old_terminate);
+	shutdown_headless_gl();
+	stats = server->stats;
+	stats.seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - server->start).count();
+	return errors.empty();
+}
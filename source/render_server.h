@@ -0,0 +1,57 @@
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include <string>
+
+// Renders frames on request over a Unix domain socket, keeping one headless
+// GL context, its programs and the shapes warm between requests. Clients
+// send lines of text and get back "ok SIZE" and SIZE bytes, or "error
+// MESSAGE":
+//
+//   render DIGITS [frame N | frames FIRST-LAST] [scale S] [format F]
+//       DIGITS least significant first, like --digits. Frame 0 by default,
+//       at scale 1 (300x150) and as raw RGB, top row first. F is rgb, y4m
+//       or gif, for the frames in one stream or animation.
+//   stats
+//       "name value" lines: requests, requests/sec over the last ten
+//       seconds, p50, p99 and max latency in ms over the last 600 requests,
+//       frames rendered and found in the cache, and render passes.
+//
+// Every request read in one go, from however many clients, is answered
+// together: frames already rendered come from a cache by score and point in
+// the animation at each scale, and the rest are drawn stacked up in shared
+// render targets and read back a pass at a time. A client can send several
+// requests without waiting, and replies come back in order.
+
+struct server_job {
+	const char *socket_path;
+	int width;				// of a frame at scale 1
+	int height;
+	int frame_cache_mb;		// memory for rendered frames, at each scale
+	bool use_instancing;
+};
+
+struct server_stats {
+	long long requests;		// renders answered, including bad ones
+	long long failed;
+	long long frames;		// sent back
+	long long frames_rendered;
+	long long batches;		// render passes
+	long long clients;		// connections taken
+	double seconds;
+};
+
+// Serve "job" until stop_render_server is called or the process gets
+// SIGINT or SIGTERM. Makes its own headless GL context on the calling
+// thread. Returns false and gives error messages in "errors" if it couldn't
+// start.
+bool
+run_render_server(const server_job& job,
+                  server_stats& stats,
+                  std::string& errors);
+
+// Make run_render_server return, from any thread
+void
+stop_render_server();
+
+#endif
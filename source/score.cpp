@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string.h>
+#include <vector>
+
+#include "packed_score.h"
+#include "score.h"
+#include "thread_pool.h"
+
+// Highest value digit i plus i can take
+static const int MAX_COMBINED = NUM_DIGITS + NUM_SHAPES - 2;
+
+// choose[i][n] is C(n, i + 1), the weight of digit i when it's n - i
+struct choose_table {
+	int weights[NUM_DIGITS][MAX_COMBINED + 1];
+
+	choose_table()
+	{
+		for (int n = 0 ; n <= MAX_COMBINED ; ++n) {
+			long long value = n;
+			for (int i = 0 ; i < NUM_DIGITS ; ++i) {
+				weights[i][n] = (int)value;
+				// C(n, k + 1) = C(n, k) * (n - k) / (k + 1)
+				value = value * (n - i - 1) / (i + 2);
+				if (value < 0)
+					value = 0;
+			}
+		}
+	}
+};
+
+static const choose_table choose;
+
+void
+increment_score(int *digits, int num_digits)
+{
+	for (int i = 0 ; i < num_digits ; ++i) {
+		if (i == num_digits - 1 || digits[i] < digits[i+1]) {
+			++digits[i];
+			break;
+		}
+		else {
+			digits[i] = 0;
+		}
+	}
+}
+
+void
+advance_score(int *digits, long long count)
+{
+	const int value = score_to_int(digits);
+	if (value < 0) {
+		for (long long i = 0 ; i < count ; ++i) {
+			increment_score(digits, NUM_DIGITS);
+			for (int j = 0 ; j < NUM_DIGITS ; ++j)
+				digits[j] = std::max(std::min(digits[j], NUM_SHAPES-1), 0);
+		}
+		return;
+	}
+	long long target = value + count;
+	if (target >= NUM_SCORES)
+		target = CLAMPED_SCORE +
+			(target - CLAMPED_SCORE) % (NUM_SCORES - CLAMPED_SCORE);
+	int_to_score((int)target, digits);
+}
+
+bool
+is_valid_score(const int *digits)
+{
+	for (int i = 0 ; i < NUM_DIGITS ; ++i)
+		if (digits[i] < 0 || digits[i] >= NUM_SHAPES ||
+			(i > 0 && digits[i] < digits[i-1]))
+			return false;
+	return true;
+}
+
+int
+score_to_int(const int *digits)
+{
+	if (!is_valid_score(digits))
+		return -1;
+	int value = 0;
+	for (int i = 0 ; i < NUM_DIGITS ; ++i)
+		value += choose.weights[i][digits[i] + i];
+	return value;
+}
+
+bool
+int_to_score(int value, int *digits)
+{
+	if (value < 0 || value >= NUM_SCORES)
+		return false;
+	// Greedily take the biggest weight that fits, most significant first.
+	// Each digit is at most the one above it, so the search only goes down.
+	int combined = MAX_COMBINED;
+	for (int i = NUM_DIGITS - 1 ; i >= 0 ; --i) {
+		while (choose.weights[i][combined] > value)
+			--combined;
+		value -= choose.weights[i][combined];
+		digits[i] = combined - i;
+		--combined;
+	}
+	return true;
+}
+
+int
+compare_scores(const int *a, const int *b)
+{
+	for (int i = NUM_DIGITS - 1 ; i >= 0 ; --i)
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+bool
+add_scores(const int *a, const int *b, int *result)
+{
+	const int value_a = score_to_int(a);
+	const int value_b = score_to_int(b);
+	if (value_a < 0 || value_b < 0)
+		return false;
+	return int_to_score(value_a + value_b, result);
+}
+
+bool
+subtract_scores(const int *a, const int *b, int *result)
+{
+	const int value_a = score_to_int(a);
+	const int value_b = score_to_int(b);
+	if (value_a < 0 || value_b < 0)
+		return false;
+	return int_to_score(value_a - value_b, result);
+}
+
+bool
+verify_scores(thread_pool& pool, std::string& errors)
+{
+	// Every score, in order, the slow way
+	std::vector<int> expected(NUM_SCORES * NUM_DIGITS);
+	int digits[NUM_DIGITS] = {};
+	for (int value = 0 ; value < NUM_SCORES ; ++value) {
+		memcpy(&expected[value * NUM_DIGITS], digits, sizeof(digits));
+		increment_score(digits, NUM_DIGITS);
+	}
+
+	std::mutex error_mutex;
+	std::atomic<int> valid_count(0);
+	auto fail = [&](const std::string& message) {
+		std::lock_guard<std::mutex> lock(error_mutex);
+		if (errors.size() < 4096)
+			errors.append(message + "\n");
+	};
+	auto score_string = [](const int *score) {
+		std::string text;
+		for (int i = 0 ; i < NUM_DIGITS ; ++i)
+			text += (char)('0' + score[i]);
+		return text;
+	};
+
+	// Every digit sequence, one job per value of the top two digits
+	pool.parallel_for(NUM_SHAPES * NUM_SHAPES, [&](int job) {
+		int total = 1;
+		for (int i = 0 ; i < NUM_DIGITS - 2 ; ++i)
+			total *= NUM_SHAPES;
+		int valid = 0;
+		for (int n = 0 ; n < total ; ++n) {
+			int score[NUM_DIGITS];
+			for (int i = 0, rest = n ; i < NUM_DIGITS - 2 ; ++i) {
+				score[i] = rest % NUM_SHAPES;
+				rest /= NUM_SHAPES;
+			}
+			score[NUM_DIGITS - 2] = job % NUM_SHAPES;
+			score[NUM_DIGITS - 1] = job / NUM_SHAPES;
+			const int value = score_to_int(score);
+			if (value < 0)
+				continue;
+			++valid;
+			int back[NUM_DIGITS];
+			if (value >= NUM_SCORES ||
+				memcmp(&expected[value * NUM_DIGITS], score, sizeof(score)) ||
+				!int_to_score(value, back) ||
+				memcmp(back, score, sizeof(score)))
+				fail("wrong value " + std::to_string(value) + " for " +
+					score_string(score));
+		}
+		valid_count += valid;
+	});
+	if (valid_count != NUM_SCORES)
+		fail(std::to_string(valid_count) + " valid scores, expected " +
+			std::to_string(NUM_SCORES));
+
+	// Ordering and arithmetic against the values, for every pair of scores,
+	// packed as well as not
+	typedef packed_score<NUM_DIGITS, NUM_SHAPES> packed;
+	std::vector<packed> packed_scores(NUM_SCORES);
+	for (int value = 0 ; value < NUM_SCORES ; ++value)
+		packed_scores[value] =
+			packed::from_digits(&expected[value * NUM_DIGITS]);
+	pool.parallel_for(NUM_SCORES, [&](int a) {
+		const int *score_a = &expected[a * NUM_DIGITS];
+		packed next = packed_scores[a];
+		next.increment();
+		if (a + 1 < NUM_SCORES && !(next == packed_scores[a + 1]))
+			fail("packed increment is wrong after " + score_string(score_a));
+		// Jumping ahead, past the end and round the clamped cycle, has to
+		// land where counting does
+		int counted[NUM_DIGITS];
+		memcpy(counted, score_a, sizeof(counted));
+		for (int count = 1 ; count <= 2 * NUM_SCORES ; ++count) {
+			increment_score(counted, NUM_DIGITS);
+			for (int& digit : counted)
+				digit = std::min(digit, NUM_SHAPES-1);
+			if (count % 97 && count != NUM_SCORES - a)
+				continue;
+			int jumped[NUM_DIGITS];
+			memcpy(jumped, score_a, sizeof(jumped));
+			advance_score(jumped, count);
+			if (memcmp(jumped, counted, sizeof(jumped)))
+				fail("advancing " + score_string(score_a) + " by " +
+					std::to_string(count) + " is wrong");
+		}
+		for (int b = 0 ; b < NUM_SCORES ; ++b) {
+			const int *score_b = &expected[b * NUM_DIGITS];
+			const int order = compare_scores(score_a, score_b);
+			if (order != (a < b ? -1 : a > b ? 1 : 0) ||
+				packed_scores[a].compare(packed_scores[b]) != order)
+				fail("wrong order for " + score_string(score_a) + " and " +
+					score_string(score_b));
+			int result[NUM_DIGITS];
+			const bool added = add_scores(score_a, score_b, result);
+			if (added != (a + b < NUM_SCORES) || (added &&
+				memcmp(result, &expected[(a + b) * NUM_DIGITS],
+					sizeof(result))))
+				fail("wrong sum of " + score_string(score_a) + " and " +
+					score_string(score_b));
+			const bool subtracted = subtract_scores(score_a, score_b, result);
+			if (subtracted != (a >= b) || (subtracted &&
+				memcmp(result, &expected[(a - b) * NUM_DIGITS],
+					sizeof(result))))
+				fail("wrong difference of " + score_string(score_a) +
+					" and " + score_string(score_b));
+		}
+	});
+	return errors.empty();
+}
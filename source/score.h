@@ -0,0 +1,67 @@
+#ifndef SCORE_H
+#define SCORE_H
+
+#include <string>
+
+#include "shapes.h"
+
+class thread_pool;
+
+// Scores count up with increment_score, where a digit can only go up while
+// it's below the next, more significant one. So the scores it reaches are
+// exactly the digit sequences that never go down from least to most
+// significant, and counting them up is counting through combinations:
+// digit i plus i is a strictly increasing sequence, and a score's value is
+// that combination's rank in colexicographic order.
+
+// How many scores there are, from 0000000 to 8888888
+const int NUM_SCORES = 6435;	// C(NUM_DIGITS + NUM_SHAPES - 1, NUM_DIGITS)
+
+// Step "digits" (least significant first) on to the next score
+void
+increment_score(int *digits, int num_digits);
+
+// Where the viewer goes after the last score, 8888888: incrementing pushes
+// the top digit past the last shape and clamping brings it back, leaving
+// 0000008, so from then on scores cycle through the top ones.
+const int CLAMPED_SCORE = 3432;	// C(NUM_DIGITS + NUM_SHAPES - 2, NUM_DIGITS)
+
+// Step "digits" on "count" times, each an increment_score then clamping the
+// digits to the shapes, the way the viewer counts. Valid scores jump there
+// in one go, others step there one at a time.
+void
+advance_score(int *digits, long long count);
+
+// Whether "digits" is a score increment_score can reach from zero
+bool
+is_valid_score(const int *digits);
+
+// The integer value of a score, or -1 if it isn't valid
+int
+score_to_int(const int *digits);
+
+// Set "digits" to the score with integer value "value". Returns false and
+// leaves "digits" alone if "value" isn't in [0, NUM_SCORES).
+bool
+int_to_score(int value, int *digits);
+
+// -1, 0 or 1 as score "a" is below, equal to or above score "b". Only
+// meaningful for valid scores.
+int
+compare_scores(const int *a, const int *b);
+
+// Set "result" to "a" plus or minus "b". Returns false and leaves "result"
+// alone if either score is invalid, or the result would be out of range.
+bool
+add_scores(const int *a, const int *b, int *result);
+
+bool
+subtract_scores(const int *a, const int *b, int *result);
+
+// Check conversion, ordering and arithmetic against increment_score over
+// every possible digit sequence, spread across "pool". Returns false and
+// gives error messages in "errors" if anything disagrees.
+bool
+verify_scores(thread_pool& pool, std::string& errors);
+
+#endif
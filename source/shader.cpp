@@ -8,11 +8,19 @@
 #include <GLFW/glfw3native.h>
 #endif
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <vector>
 
+#include "embedded_shaders.h"
 #include "shader.h"
+#include "startup_cache.h"
+
+shader_program_stats shader_stats;
 
 static bool
 load_text_file(const char *filename,
@@ -35,16 +43,37 @@ load_text_file(const char *filename,
 	return true;
 }
 
+// find the source of shader "name": in $VRVIZ_SHADER_DIR if that's set,
+// otherwise built in, or failing that in the working directory
+static bool
+load_shader_source(const char *name,
+				   std::string& text,
+				   std::string& errors)
+{
+	if(!name){
+		errors.append("filename was NULL\n");
+		return false;
+	}
+	const char *dir=getenv("VRVIZ_SHADER_DIR");
+	if(dir && *dir)
+		return load_text_file((std::string(dir)+"/"+name).c_str(), text,
+							  errors);
+	for(const embedded_shader *shader=EMBEDDED_SHADERS; shader->name;
+		++shader)
+		if(!strcmp(shader->name, name)){
+			text=shader->source;
+			return true;
+		}
+	return load_text_file(name, text, errors);
+}
+
 static bool
 compile_shader(GLenum shader_type,
 			   const char *filename,
+			   const std::string& shader_src,
 			   GLuint& shader,
 			   std::string& errors)
 {
-	// load in source code for vertex shader
-	std::string shader_src;
-	if(!load_text_file(filename, shader_src, errors))
-		return false;
 	// create a shader for it in OpenGL
 	shader=glCreateShader(shader_type);
 	if(shader==0){
@@ -70,19 +99,114 @@ compile_shader(GLenum shader_type,
 	return true;
 }
 
-bool
-make_shader_program(const char *vertex_shader_filename,
-					const char *fragment_shader_filename,
-					GLuint& program,
-					std::string& errors)
+// work out the startup cache file and key for a program linked from these
+// sources by this driver, or return false if GL can't give programs back
+static bool
+program_cache_key(const std::string& vertex_src,
+				  const std::string& fragment_src,
+				  std::string& name,
+				  uint64_t& key)
 {
-	// first attempt to load and compile vertex and fragment shaders
+	if(!GLEW_ARB_get_program_binary)
+		return false;
+	GLint formats=0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if(formats<=0)
+		return false;
+	// a binary is only any good to the same driver on the same GPU
+	const GLenum driver[]={GL_VENDOR, GL_RENDERER, GL_VERSION,
+						   GL_SHADING_LANGUAGE_VERSION};
+	key=HASH_START;
+	for(GLenum string : driver){
+		const char *text=(const char*)glGetString(string);
+		if(text)
+			key=hash_bytes(text, strlen(text)+1, key);
+	}
+	key=hash_bytes(vertex_src.c_str(), vertex_src.size()+1, key);
+	key=hash_bytes(fragment_src.c_str(), fragment_src.size()+1, key);
+	char filename[40];
+	snprintf(filename, sizeof(filename), "program-%016llx.bin",
+			 (unsigned long long)key);
+	name=filename;
+	return true;
+}
+
+// try to load a program from the startup cache; the driver can still turn
+// the binary down (after an update that kept its version string, say)
+static bool
+load_cached_program(const std::string& name,
+					uint64_t key,
+					GLuint& program)
+{
+	// the binary's format, then the binary
+	std::vector<unsigned char> bytes;
+	if(!read_cache_file(name.c_str(), key, bytes) ||
+	   bytes.size()<=sizeof(GLenum))
+		return false;
+	GLenum format;
+	memcpy(&format, &bytes[0], sizeof(format));
+	program=glCreateProgram();
+	glProgramBinary(program, format, &bytes[sizeof(format)],
+					(GLsizei)(bytes.size()-sizeof(format)));
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if(status==GL_FALSE){
+		glDeleteProgram(program);
+		// an unknown format is also a GL error, which isn't ours to leave
+		glGetError();
+		return false;
+	}
+	return true;
+}
+
+static void
+save_cached_program(const std::string& name,
+					uint64_t key,
+					GLuint program)
+{
+	GLint length=0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length<=0)
+		return;
+	std::vector<unsigned char> bytes(sizeof(GLenum)+length);
+	GLenum format;
+	glGetProgramBinary(program, length, &length, &format,
+					   &bytes[sizeof(format)]);
+	memcpy(&bytes[0], &format, sizeof(format));
+	bytes.resize(sizeof(format)+length);
+	write_cache_file(name.c_str(), key, &bytes[0], bytes.size());
+}
+
+static bool
+make_program(const char *vertex_shader_filename,
+			 const char *fragment_shader_filename,
+			 bool cacheable,
+			 GLuint& program,
+			 std::string& errors)
+{
+	const auto start=std::chrono::steady_clock::now();
+	std::string vertex_src, fragment_src;
+	if(!load_shader_source(vertex_shader_filename, vertex_src, errors) ||
+	   !load_shader_source(fragment_shader_filename, fragment_src, errors))
+		return false;
+	std::string cache_name;
+	uint64_t cache_key=0;
+	cacheable=cacheable && program_cache_key(vertex_src, fragment_src,
+											 cache_name, cache_key);
+	if(cacheable && load_cached_program(cache_name, cache_key, program)){
+		++shader_stats.cached;
+		shader_stats.seconds+=std::chrono::duration<double>(
+			std::chrono::steady_clock::now()-start).count();
+		return true;
+	}
+
+	// first attempt to compile vertex and fragment shaders
 	GLuint vshader, fshader;
-	if(!compile_shader(GL_VERTEX_SHADER, vertex_shader_filename, vshader,
-					   errors))
+	if(!compile_shader(GL_VERTEX_SHADER, vertex_shader_filename, vertex_src,
+					   vshader, errors))
 		return false;
-	if(!compile_shader(GL_FRAGMENT_SHADER, fragment_shader_filename, fshader,
-					   errors))
+	if(!compile_shader(GL_FRAGMENT_SHADER, fragment_shader_filename,
+					   fragment_src, fshader, errors))
 		return false; // ideally should clean up vertex shader too...
 
 	// now set up the program
@@ -93,6 +217,9 @@ make_shader_program(const char *vertex_shader_filename,
 	}
 	glAttachShader(program, vshader);
 	glAttachShader(program, fshader);
+	if(cacheable)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+							GL_TRUE);
 
 	// link the program
 	glLinkProgram(program);
@@ -102,7 +229,32 @@ make_shader_program(const char *vertex_shader_filename,
 		errors.append("Error when linking shader program\n");
 		return false; // ideally should clean up here...
 	}
+	if(cacheable)
+		save_cached_program(cache_name, cache_key, program);
 
 	// we're done!
+	++shader_stats.compiled;
+	shader_stats.seconds+=std::chrono::duration<double>(
+		std::chrono::steady_clock::now()-start).count();
 	return true;
 }
+
+bool
+make_shader_program(const char *vertex_shader_filename,
+					const char *fragment_shader_filename,
+					GLuint& program,
+					std::string& errors)
+{
+	return make_program(vertex_shader_filename, fragment_shader_filename,
+						true, program, errors);
+}
+
+bool
+make_relinkable_shader_program(const char *vertex_shader_filename,
+							   const char *fragment_shader_filename,
+							   GLuint& program,
+							   std::string& errors)
+{
+	return make_program(vertex_shader_filename, fragment_shader_filename,
+						false, program, errors);
+}
@@ -3,14 +3,36 @@
 
 #include <string>
 
-// Attempt to load a vertex shader and fragment shader from files, compile
-// and link into a shader program. Only call this after OpenGL has started.
-// Returns true and sets "program" to the linked program, otherwise
-// returns false and gives error messages in "errors".
+// How the shader programs made so far came about, to time startup with
+struct shader_program_stats {
+	int cached;			// loaded as binaries from the startup cache
+	int compiled;		// compiled and linked from source
+	double seconds;		// spent making them all
+};
+
+extern shader_program_stats shader_stats;
+
+// Attempt to load a vertex shader and fragment shader, compile and link
+// into a shader program. Only call this after OpenGL has started. Shaders
+// are built into the program, unless $VRVIZ_SHADER_DIR names a directory
+// to read them from instead (or one isn't built in, when it's read from
+// the working directory). Where GL can hand linked programs back, they're
+// kept in the startup cache and loaded from there while the sources and
+// driver stay the same. Returns true and sets "program" to the linked
+// program, otherwise returns false and gives error messages in "errors".
 bool
 make_shader_program(const char *vertex_shader_filename,
                     const char *fragment_shader_filename,
                     GLuint& program,
                     std::string& errors);
 
+// As make_shader_program, but always compiled from source, keeping the
+// shaders attached so the program can be changed and linked again (which
+// one loaded as a binary can't)
+bool
+make_relinkable_shader_program(const char *vertex_shader_filename,
+                               const char *fragment_shader_filename,
+                               GLuint& program,
+                               std::string& errors);
+
 #endif
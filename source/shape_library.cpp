@@ -0,0 +1,388 @@
+#include <errno.h>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "shape_library.h"
+
+static const char LIBRARY_MAGIC[4] = {'v', 'r', 's', 'l'};
+static const uint32_t LIBRARY_VERSION = 1;
+// Indices are 16-bit and counted from each shape's first vertex
+static const size_t MAX_SHAPE_VERTICES = 65536;
+
+// One shape while it's being compiled
+struct shape_source {
+	std::vector<float> vertices;
+	std::vector<uint16_t> indices;
+};
+
+// Read vertex numbers to the end of "line" into "numbers", checking each is
+// one of the shape's vertices
+static bool
+read_vertex_numbers(std::istringstream& line,
+					const shape_source& shape,
+					std::vector<uint16_t>& numbers,
+					std::string& problem)
+{
+	long number;
+	while (line >> number) {
+		if (number < 0 || (size_t)number >= shape.vertices.size() / 3) {
+			problem = "no vertex " + std::to_string(number) + " yet";
+			return false;
+		}
+		numbers.push_back((uint16_t)number);
+	}
+	if (!line.eof()) {
+		problem = "expected vertex numbers";
+		return false;
+	}
+	return true;
+}
+
+// Check the shape just finished has something to draw
+static bool
+finish_shape(const std::vector<shape_source>& shapes, std::string& problem)
+{
+	if (!shapes.empty() && shapes.back().indices.empty()) {
+		problem = "the shape before has no lines";
+		return false;
+	}
+	return true;
+}
+
+// Parse one line of text into "shapes", or set "problem"
+static bool
+parse_shape_line(const std::string& text,
+				 std::vector<shape_source>& shapes,
+				 std::string& problem)
+{
+	// Anything after a # is a comment
+	std::istringstream line(text.substr(0, text.find('#')));
+	std::string command;
+	if (!(line >> command))
+		return true;
+	if (command == "shape") {
+		if (!finish_shape(shapes, problem))
+			return false;
+		shapes.push_back(shape_source());
+		return true;
+	}
+	if (shapes.empty()) {
+		problem = "expected \"shape\" first";
+		return false;
+	}
+	shape_source& shape = shapes.back();
+	if (command == "v") {
+		float point[3] = {0.f, 0.f, 0.f};
+		std::string rest;
+		if (!(line >> point[0] >> point[1]) ||
+			(!(line >> point[2]) && !line.eof()) || (line >> rest)) {
+			problem = "expected v x y, or v x y z";
+			return false;
+		}
+		if (shape.vertices.size() / 3 == MAX_SHAPE_VERTICES) {
+			problem = "more than " + std::to_string(MAX_SHAPE_VERTICES) +
+				" vertices in one shape";
+			return false;
+		}
+		shape.vertices.insert(shape.vertices.end(), point, point + 3);
+		return true;
+	}
+	std::vector<uint16_t> numbers;
+	if (command == "l") {
+		if (!read_vertex_numbers(line, shape, numbers, problem))
+			return false;
+		if (numbers.empty() || numbers.size() % 2) {
+			problem = "expected pairs of vertex numbers";
+			return false;
+		}
+		shape.indices.insert(shape.indices.end(), numbers.begin(),
+			numbers.end());
+		return true;
+	}
+	if (command == "loop") {
+		if (!read_vertex_numbers(line, shape, numbers, problem))
+			return false;
+		if (numbers.size() < 2) {
+			problem = "expected two or more vertex numbers";
+			return false;
+		}
+		for (size_t i = 0 ; i < numbers.size() ; ++i) {
+			shape.indices.push_back(numbers[i]);
+			shape.indices.push_back(numbers[(i + 1) % numbers.size()]);
+		}
+		return true;
+	}
+	problem = "unknown command \"" + command + "\"";
+	return false;
+}
+
+static void
+append_bytes(std::vector<unsigned char>& bytes, const void *data, size_t size)
+{
+	const unsigned char *from = (const unsigned char*)data;
+	bytes.insert(bytes.end(), from, from + size);
+}
+
+bool
+compile_shape_library(const std::string& text,
+					  const char *name,
+					  std::vector<unsigned char>& library,
+					  std::string& errors)
+{
+	std::vector<shape_source> shapes;
+	std::istringstream in(text);
+	std::string line;
+	int line_number = 0;
+	bool good = true;
+	while (std::getline(in, line)) {
+		++line_number;
+		std::string problem;
+		if (!parse_shape_line(line, shapes, problem)) {
+			errors.append(std::string(name) + ":" +
+				std::to_string(line_number) + ": " + problem + "\n");
+			good = false;
+		}
+	}
+	std::string problem;
+	if (!finish_shape(shapes, problem) || shapes.empty()) {
+		errors.append(std::string(name) + ": " +
+			(shapes.empty() ? "no shapes" : "the last shape has no lines") +
+			"\n");
+		return false;
+	}
+	if (!good)
+		return false;
+
+	shape_library_header header;
+	memcpy(header.magic, LIBRARY_MAGIC, sizeof(LIBRARY_MAGIC));
+	header.version = LIBRARY_VERSION;
+	header.num_shapes = (uint32_t)shapes.size();
+	header.num_vertices = 0;
+	header.num_indices = 0;
+	header.reserved = 0;
+	std::vector<shape_library_entry> entries(shapes.size());
+	for (size_t i = 0 ; i < shapes.size() ; ++i) {
+		entries[i].first_vertex = header.num_vertices;
+		entries[i].num_vertices = (uint32_t)shapes[i].vertices.size() / 3;
+		entries[i].first_index = header.num_indices;
+		entries[i].num_indices = (uint32_t)shapes[i].indices.size();
+		header.num_vertices += entries[i].num_vertices;
+		header.num_indices += entries[i].num_indices;
+	}
+	library.clear();
+	library.reserve(sizeof(header) + entries.size() * sizeof(entries[0]) +
+		header.num_vertices * 3 * sizeof(float) +
+		header.num_indices * sizeof(uint16_t) + 2);
+	append_bytes(library, &header, sizeof(header));
+	append_bytes(library, &entries[0], entries.size() * sizeof(entries[0]));
+	for (const shape_source& shape : shapes)
+		append_bytes(library, &shape.vertices[0],
+			shape.vertices.size() * sizeof(float));
+	for (const shape_source& shape : shapes)
+		append_bytes(library, &shape.indices[0],
+			shape.indices.size() * sizeof(uint16_t));
+	// Whole words, to map
+	library.resize((library.size() + 3) & ~(size_t)3);
+	return true;
+}
+
+bool
+compile_shape_file(const char *text_path,
+				   const char *library_path,
+				   std::string& errors)
+{
+	std::ifstream in(text_path);
+	if (!in) {
+		errors.append(std::string("couldn't open ") + text_path + "\n");
+		return false;
+	}
+	std::stringstream text;
+	text << in.rdbuf();
+	std::vector<unsigned char> library;
+	if (!compile_shape_library(text.str(), text_path, library, errors))
+		return false;
+	FILE *out = fopen(library_path, "wb");
+	if (!out) {
+		errors.append(std::string("failed to open ") + library_path + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	const bool written =
+		fwrite(&library[0], 1, library.size(), out) == library.size();
+	if (fclose(out) || !written) {
+		errors.append(std::string("failed to write ") + library_path + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	return true;
+}
+
+// Bring the whole file into memory, mapped if the system can
+static bool
+map_library_file(shape_library& library,
+				 const char *path,
+				 std::string& errors)
+{
+#ifdef _WIN32
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		errors.append(std::string("couldn't open ") + path + "\n");
+		return false;
+	}
+	library.copy.assign(std::istreambuf_iterator<char>(in),
+		std::istreambuf_iterator<char>());
+	library.data = library.copy.empty() ? 0 : &library.copy[0];
+	library.size = library.copy.size();
+	library.mapped = false;
+	return true;
+#else
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		errors.append(std::string("couldn't open ") + path + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	struct stat status;
+	void *memory = MAP_FAILED;
+	if (fstat(fd, &status))
+		status.st_size = 0;
+	else if (status.st_size > 0)
+		memory = mmap(0, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd,
+			0);
+	const int mapping_error = errno;
+	close(fd);
+	if (memory == MAP_FAILED) {
+		errors.append(std::string("couldn't map ") + path + ": " +
+			(status.st_size > 0 ? strerror(mapping_error) : "it's empty") +
+			"\n");
+		return false;
+	}
+	library.data = (const unsigned char*)memory;
+	library.size = (size_t)status.st_size;
+	library.mapped = true;
+	return true;
+#endif
+}
+
+// Check the library's table and indices against its size, so nothing
+// reading its shapes can go outside it
+static bool
+check_library(const shape_library& library, std::string& problem)
+{
+	shape_library_header header;
+	if (library.size < sizeof(header)) {
+		problem = "too short to be a shape library";
+		return false;
+	}
+	memcpy(&header, library.data, sizeof(header));
+	if (memcmp(header.magic, LIBRARY_MAGIC, sizeof(LIBRARY_MAGIC)) ||
+		header.version != LIBRARY_VERSION) {
+		problem = "not a shape library this version can read";
+		return false;
+	}
+	const uint64_t vertices_start = sizeof(header) +
+		(uint64_t)header.num_shapes * sizeof(shape_library_entry);
+	const uint64_t indices_start = vertices_start +
+		(uint64_t)header.num_vertices * 3 * sizeof(float);
+	const uint64_t end = indices_start +
+		(uint64_t)header.num_indices * sizeof(uint16_t);
+	if (end > library.size || header.num_shapes > 0x7fffffff) {
+		problem = "cut short";
+		return false;
+	}
+	const shape_library_entry *entries =
+		(const shape_library_entry*)(library.data + sizeof(header));
+	const uint16_t *indices =
+		(const uint16_t*)(library.data + indices_start);
+	for (uint32_t i = 0 ; i < header.num_shapes ; ++i) {
+		const shape_library_entry& entry = entries[i];
+		if (!entry.num_vertices || !entry.num_indices ||
+			entry.num_indices % 2 ||
+			entry.num_vertices > MAX_SHAPE_VERTICES ||
+			entry.first_vertex > header.num_vertices ||
+			entry.num_vertices > header.num_vertices - entry.first_vertex ||
+			entry.first_index > header.num_indices ||
+			entry.num_indices > header.num_indices - entry.first_index) {
+			problem = "shape " + std::to_string(i) + " is out of bounds";
+			return false;
+		}
+		for (uint32_t j = 0 ; j < entry.num_indices ; ++j)
+			if (indices[entry.first_index + j] >= entry.num_vertices) {
+				problem = "shape " + std::to_string(i) +
+					" has an index past its vertices";
+				return false;
+			}
+	}
+	return true;
+}
+
+bool
+open_shape_library(shape_library& library,
+				   const char *path,
+				   std::string& errors)
+{
+	library = shape_library();
+	if (!map_library_file(library, path, errors))
+		return false;
+	std::string problem;
+	if (!check_library(library, problem)) {
+		errors.append(std::string(path) + ": " + problem + "\n");
+		close_shape_library(library);
+		return false;
+	}
+	shape_library_header header;
+	memcpy(&header, library.data, sizeof(header));
+	library.num_shapes = (int)header.num_shapes;
+	library.entries =
+		(const shape_library_entry*)(library.data + sizeof(header));
+	library.vertices = (const float*)(library.entries + header.num_shapes);
+	library.indices =
+		(const uint16_t*)(library.vertices + header.num_vertices * 3);
+	return true;
+}
+
+void
+close_shape_library(shape_library& library)
+{
+#ifndef _WIN32
+	if (library.mapped)
+		munmap((void*)library.data, library.size);
+#endif
+	library = shape_library();
+}
+
+shape_geometry
+library_shape(const shape_library& library, int index)
+{
+	const shape_library_entry& entry = library.entries[index];
+	const shape_geometry shape = {
+		library.vertices + entry.first_vertex * 3,
+		(int)entry.num_vertices,
+		library.indices + entry.first_index,
+		(int)entry.num_indices};
+	return shape;
+}
+
+int
+num_shape_sets(const shape_library& library)
+{
+	return library.num_shapes / NUM_SHAPES;
+}
+
+bool
+use_shape_set(const shape_library& library, int set)
+{
+	if (set < 0 || set >= num_shape_sets(library))
+		return false;
+	for (int i = 0 ; i < NUM_SHAPES ; ++i)
+		shapes[i] = library_shape(library, set * NUM_SHAPES + i);
+	return true;
+}
@@ -0,0 +1,88 @@
+#ifndef SHAPE_LIBRARY_H
+#define SHAPE_LIBRARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "shapes.h"
+
+// Shapes compiled from a text file (see shapes/vib_ribbon.shapes) into one
+// binary file that's mapped into memory as it is and never copied: a
+// header, a table of where each shape is, every shape's x,y,z vertices,
+// then every shape's 16-bit indices, counted from its own first vertex.
+// Shapes are taken NUM_SHAPES at a time as glyph sets, the first in each
+// set drawn for 0, to swap in for the built in ones. The file is in the
+// byte order of the machine that compiled it.
+
+struct shape_library_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t num_shapes;
+	uint32_t num_vertices;
+	uint32_t num_indices;
+	uint32_t reserved;
+};
+
+struct shape_library_entry {
+	uint32_t first_vertex;
+	uint32_t num_vertices;
+	uint32_t first_index;
+	uint32_t num_indices;
+};
+
+struct shape_library {
+	const unsigned char *data;		// the whole file
+	size_t size;
+	int num_shapes;
+	const shape_library_entry *entries;
+	const float *vertices;
+	const uint16_t *indices;
+	bool mapped;					// else "data" is in "copy"
+	std::vector<unsigned char> copy;
+};
+
+// Compile shape library text into "library". "name" is the text's file,
+// for messages. Returns false and gives error messages in "errors" if
+// there's anything wrong with it.
+bool
+compile_shape_library(const std::string& text,
+                      const char *name,
+                      std::vector<unsigned char>& library,
+                      std::string& errors);
+
+// Compile the text file "text_path" into the library file "library_path".
+// Returns false and gives error messages in "errors" on failure.
+bool
+compile_shape_file(const char *text_path,
+                   const char *library_path,
+                   std::string& errors);
+
+// Map the library file "path" into memory, checking every shape's indices
+// stay within its vertices. Returns false and gives error messages in
+// "errors" if it can't be read or isn't a good library.
+bool
+open_shape_library(shape_library& library,
+                   const char *path,
+                   std::string& errors);
+
+// Unmap it. Anything still pointing into it, like "shapes" after
+// use_shape_set, has to be changed first.
+void
+close_shape_library(shape_library& library);
+
+// Shape "index" of the library, pointing into it
+shape_geometry
+library_shape(const shape_library& library, int index);
+
+// How many whole glyph sets the library has
+int
+num_shape_sets(const shape_library& library);
+
+// Draw glyph set "set" of the library in place of "shapes". Returns false
+// if there's no such set.
+bool
+use_shape_set(const shape_library& library, int set);
+
+#endif
@@ -0,0 +1,153 @@
+#include "shapes.h"
+
+// 0 - line
+static const float line_vertices[] = {
+	-1.f,0.f,0.f,
+	1.f,0.f,0.f};
+static const uint16_t line_indices[] = {0,1};
+// 1 - 3 pointed line
+static const float three_line_vertices[] = {
+	0.f,0.f,0.f,
+	-1.f,0.f,0.f,
+	0.5,0.866,0.f,
+	0.5,-0.866,0.f};
+static const uint16_t three_line_indices[] = {0,1, 0,2, 0,3};
+// 2 - cross
+static const float cross_vertices[] = {
+	0.f,0.f,0.f,
+	-1.f,0.f,0.f,
+	0.f,1.f,0.f,
+	1.f,0.f,0.f,
+	0.f,-1.f,0.f};
+static const uint16_t cross_indices[] = {0,1, 0,2, 0,3, 0,4};
+// 3 - fat line
+static const float fat_line_vertices[] = {
+	-1.f,0.2f,0.f,
+	1.f,0.2f,0.f,
+	1.f,-0.2f,0.f,
+	-1.f,-0.2f,0.f
+};
+static const uint16_t fat_line_indices[] = {0,1, 1,2, 2,3, 3,0};
+// 4 - fat 3-line
+static const float fat_three_line_vertices[] = {
+	-1.f,		-0.2f,		0.f,
+	-1.f,		0.2f,		0.f,
+	-0.115f,	0.2f,		0.f,
+	0.316f,		0.949f,		0.f,
+	0.663f,		0.748f,		0.f,
+	0.3f,		0.f,		0.f,
+	0.663f,		-0.748f,	0.f,
+	0.316f,		-0.949f,	0.f,
+	-0.115f,	-0.2f,		0.f
+};
+static const uint16_t fat_three_line_indices[] =
+	{0,1, 1,2, 2,3, 3,4, 4,5, 5,6, 6,7, 7,8, 8,0};
+// 5 - fat cross
+static const float fat_cross_vertices[] = {
+	-1.f,0.2f,0.f,
+	-0.2f,0.2f,0.f,
+	-0.2f,1.f,0.f,
+	0.2f,1.f,0.f,
+	0.2f,0.2f,0.f,
+	1.f,0.2f,0.f,
+	1.f,-0.2f,0.f,
+	0.2f,-0.2f,0.f,
+	0.2f,-1.f,0.f,
+	-0.2f,-1.f,0.f,
+	-0.2f,-0.2f,0.f,
+	-1.f,-0.2f,0.f
+};
+static const uint16_t fat_cross_indices[] =
+	{0,1, 1,2, 2,3, 3,4, 4,5, 5,6, 6,7, 7,8, 8,9, 9,10, 10,11, 11,0};
+// 6 - triangle
+static const float triangle_vertices[] = {
+	-1.f,-0.866f,0.f,
+	1.f,-0.866f,0.f,
+	0.f,0.866f,0.f,
+};
+static const uint16_t triangle_indices[] = {0,1, 1,2, 2,0};
+// 7 - square
+static const float square_vertices[] = {
+	-0.707f,	-0.707f,	0.f,
+	0.707f,		-0.707f,	0.f,
+	0.707f,		0.707f,		0.f,
+	-0.707f,	0.707f,		0.f
+};
+static const uint16_t square_indices[] = {0,1, 1,2, 2,3, 3,0};
+// 8 - pentagon
+static const float pentagon_vertices[] = {
+	1.f,		0.f,		0.f,
+	0.309f,		-0.951f,	0.f,
+	-0.809f,	-0.588f,	0.f,
+	-0.809f,	0.588f,		0.f,
+	0.309f,		0.951f,		0.f
+};
+static const uint16_t pentagon_indices[] = {0,1, 1,2, 2,3, 3,4, 4,0};
+
+#define SHAPE(name) { \
+	name##_vertices, sizeof(name##_vertices)/sizeof(float)/3, \
+	name##_indices, sizeof(name##_indices)/sizeof(uint16_t) }
+
+// In digit order
+#define BUILTIN_SHAPE_LIST \
+	SHAPE(line), \
+	SHAPE(three_line), \
+	SHAPE(cross), \
+	SHAPE(fat_line), \
+	SHAPE(fat_three_line), \
+	SHAPE(fat_cross), \
+	SHAPE(triangle), \
+	SHAPE(square), \
+	SHAPE(pentagon)
+
+const shape_geometry BUILTIN_SHAPES[NUM_SHAPES] = {BUILTIN_SHAPE_LIST};
+
+shape_geometry shapes[NUM_SHAPES] = {BUILTIN_SHAPE_LIST};
+
+void
+use_builtin_shapes()
+{
+	for (int i = 0 ; i < NUM_SHAPES ; ++i)
+		shapes[i] = BUILTIN_SHAPES[i];
+}
+
+void
+build_shape_arena(shape_arena& arena)
+{
+	arena.vertices.clear();
+	arena.indices.clear();
+	arena.max_segments = 0;
+	for (int i = 0 ; i < NUM_SHAPES ; ++i) {
+		const shape_geometry& shape = shapes[i];
+		const unsigned first_vertex = (unsigned)arena.vertices.size() / 3;
+		arena.vertices.insert(arena.vertices.end(), shape.vertices,
+			shape.vertices + shape.num_vertices * 3);
+		arena.first_index[i] = (int)arena.indices.size();
+		arena.index_counts[i] = shape.num_indices;
+		for (int j = 0 ; j < shape.num_indices ; ++j)
+			arena.indices.push_back(first_vertex + shape.indices[j]);
+		if (shape.num_indices / 2 > arena.max_segments)
+			arena.max_segments = shape.num_indices / 2;
+	}
+}
+
+void
+shape_color(int digit, float *rgb)
+{
+	// Keep in step with line.frag
+	if (digit <= 2) {
+		rgb[0] = float(2-digit)*0.5f;
+		rgb[1] = float(digit)*0.5f;
+		rgb[2] = 1.f;
+	}
+	else if (digit <= 5) {
+		rgb[0] = 1.f;
+		rgb[1] = float(5-digit)*0.5f;
+		rgb[2] = float(digit-3)*0.5f;
+	}
+	else {
+		rgb[0] = float(digit-6)*0.5f;
+		rgb[1] = float(8-digit)*0.5f;
+		rgb[2] = 1.f;
+	}
+}
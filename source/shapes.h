@@ -0,0 +1,48 @@
+#ifndef SHAPES_H
+#define SHAPES_H
+
+#include <stdint.h>
+#include <vector>
+
+const int NUM_DIGITS = 7;
+const int NUM_SHAPES = 9;
+
+// Line-list geometry for one of the score shapes, in its own unit space
+struct shape_geometry {
+	const float *vertices;		// x,y,z for each vertex
+	int num_vertices;
+	const uint16_t *indices;	// pairs of vertex indices, one pair per line
+	int num_indices;
+};
+
+// The game's own shapes
+extern const shape_geometry BUILTIN_SHAPES[NUM_SHAPES];
+
+// The shape drawn for each digit value: the built in ones, unless another
+// set has been swapped in from a shape library (see shape_library.h).
+// Anything built from these, like a renderer's buffers or a wall, has to be
+// updated after a swap.
+extern shape_geometry shapes[NUM_SHAPES];
+
+// Go back to drawing BUILTIN_SHAPES
+void
+use_builtin_shapes();
+
+// Every shape's geometry packed together, with the indices rebased onto the
+// shared vertex list so all the shapes can live in one pair of buffers
+struct shape_arena {
+	std::vector<float> vertices;		// x,y,z for each vertex
+	std::vector<unsigned> indices;
+	int first_index[NUM_SHAPES];
+	int index_counts[NUM_SHAPES];
+	int max_segments;					// most lines in any one shape
+};
+
+void
+build_shape_arena(shape_arena& arena);
+
+// The colour line.frag gives a digit, as red/green/blue in [0, 1]
+void
+shape_color(int digit, float *rgb);
+
+#endif
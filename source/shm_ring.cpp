@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "shm_ring.h"
+
+shm_ring_sink::shm_ring_sink() :
+	header(0),
+	size(0),
+	num_digits(0)
+{
+	std::fill(score_frames, score_frames + SCORE_HISTORY, -1LL);
+}
+
+shm_ring_sink::~shm_ring_sink()
+{
+	if (!header)
+		return;
+	munmap(header, size);
+	shm_unlink(name.c_str());
+}
+
+bool
+shm_ring_sink::open(const char *ring_name,
+					int width,
+					int height,
+					std::string& errors)
+{
+	name = ring_name;
+	// Pixels start on a cache line, and so does every slot
+	const uint64_t pixel_offset = (sizeof(shm_ring_slot) + 63) & ~63ULL;
+	const uint64_t slot_size = (pixel_offset + (uint64_t)width * height * 3 +
+		63) & ~63ULL;
+	size = SHM_RING_HEADER_SIZE + SHM_RING_SLOTS * slot_size;
+	const int fd = shm_open(ring_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0) {
+		errors.append("failed to create shared memory " + name + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	void *memory = MAP_FAILED;
+	if (!ftruncate(fd, size))
+		memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		errors.append("failed to map shared memory " + name + ": " +
+			strerror(errno) + "\n");
+		shm_unlink(ring_name);
+		return false;
+	}
+	header = new(memory) shm_ring_header;
+	header->magic = SHM_RING_MAGIC;
+	header->version = SHM_RING_VERSION;
+	header->width = width;
+	header->height = height;
+	header->num_slots = SHM_RING_SLOTS;
+	header->num_digits = 0;
+	header->slot_size = slot_size;
+	header->pixel_offset = pixel_offset;
+	header->published.store(0);
+	header->closed.store(0);
+	for (int i = 0 ; i < SHM_RING_SLOTS ; ++i)
+		new(shm_ring_get_slot(header, i)) shm_ring_slot();
+	return true;
+}
+
+void
+shm_ring_sink::note_score(long long frame, const int *digits, int count)
+{
+	const int i = (int)(frame % SCORE_HISTORY);
+	num_digits = std::min(count, SHM_RING_MAX_DIGITS);
+	score_frames[i] = frame;
+	std::copy(digits, digits + num_digits, scores[i]);
+}
+
+bool
+shm_ring_sink::write_frame(const unsigned char *rgb,
+						   int width,
+						   int height,
+						   long long frame,
+						   std::string& errors)
+{
+	if (width != header->width || height != header->height) {
+		errors.append("frame " + std::to_string(frame) + " isn't the size "
+			"of the shared memory ring\n");
+		return false;
+	}
+	const uint64_t sequence = header->published.load(
+		std::memory_order_relaxed);
+	shm_ring_slot *slot = shm_ring_get_slot(header, sequence);
+	slot->state.store(2 * sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	// Frames come bottom row first
+	const size_t row_size = width * 3;
+	unsigned char *to = (unsigned char*)shm_ring_get_pixels(slot, header);
+	for (int row = height - 1 ; row >= 0 ; --row, to += row_size)
+		memcpy(to, rgb + row * row_size, row_size);
+	slot->frame = frame;
+	const int i = (int)(frame % SCORE_HISTORY);
+	std::fill(slot->digits, slot->digits + SHM_RING_MAX_DIGITS, 0);
+	if (score_frames[i] == frame)
+		std::copy(scores[i], scores[i] + num_digits, slot->digits);
+	header->num_digits = num_digits;
+	slot->publish_nanoseconds = std::chrono::duration_cast<
+		std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+		.time_since_epoch()).count();
+	slot->state.store(2 * (sequence + 1), std::memory_order_release);
+	header->published.store(sequence + 1, std::memory_order_release);
+	return true;
+}
+
+bool
+shm_ring_sink::finish(std::string& errors)
+{
+	header->closed.store(1, std::memory_order_release);
+	return true;
+}
@@ -0,0 +1,103 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+#include "frame_sink.h"
+
+// A ring of frames in POSIX shared memory, for other processes on the same
+// machine to show. Only this header is needed to read one; see
+// examples/shm_reader.cpp.
+//
+// The shared memory starts with a shm_ring_header, followed by num_slots
+// slots of slot_size bytes, each a shm_ring_slot with the frame's 8-bit RGB
+// pixels, top row first, after it at pixel_offset. Frames go in slot
+// (sequence % num_slots), where the first frame published has sequence 0.
+//
+// Nothing is locked. Each slot's "state" is odd while the slot is being
+// written and 2 * (sequence + 1) once it holds that frame, and "published"
+// in the header counts the frames finished. A reader takes the slot for
+// published - 1, checks its state, reads it in place, then checks the state
+// again to be sure it wasn't overwritten underneath, as with a seqlock.
+// Steady state reads make no system calls and copy nothing.
+
+static const uint32_t SHM_RING_MAGIC = 0x52525a56;	// "VZRR"
+static const uint32_t SHM_RING_VERSION = 1;
+static const int SHM_RING_SLOTS = 4;
+static const int SHM_RING_MAX_DIGITS = 16;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+	"the shared memory ring needs lock free 64-bit atomics");
+
+struct shm_ring_header {
+	uint32_t magic;
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	int32_t num_slots;
+	int32_t num_digits;
+	uint64_t slot_size;
+	uint64_t pixel_offset;				// from the start of a slot
+	alignas(64) std::atomic<uint64_t> published;
+	std::atomic<uint32_t> closed;		// set once no more frames will come
+};
+
+struct shm_ring_slot {
+	std::atomic<uint64_t> state;
+	int64_t frame;						// animation frame number
+	int64_t publish_nanoseconds;		// steady clock, when it was published
+	int32_t digits[SHM_RING_MAX_DIGITS];	// score, least significant first
+};
+
+static const uint64_t SHM_RING_HEADER_SIZE = 128;
+
+static_assert(sizeof(shm_ring_header) <= SHM_RING_HEADER_SIZE,
+	"shm_ring_header has outgrown its space");
+
+inline shm_ring_slot*
+shm_ring_get_slot(shm_ring_header *header, uint64_t sequence)
+{
+	return (shm_ring_slot*)((char*)header + SHM_RING_HEADER_SIZE +
+		(sequence % header->num_slots) * header->slot_size);
+}
+
+inline const unsigned char*
+shm_ring_get_pixels(const shm_ring_slot *slot, const shm_ring_header *header)
+{
+	return (const unsigned char*)slot + header->pixel_offset;
+}
+
+// Publishes frames to a ring named "name" (a name for shm_open, like
+// "/vrviz"), which is removed again when the sink is destroyed
+class shm_ring_sink : public frame_sink {
+public:
+	shm_ring_sink();
+	~shm_ring_sink();
+
+	// Create the ring for frames of "width" by "height". Returns false and
+	// gives error messages in "errors" on failure.
+	bool open(const char *name, int width, int height, std::string& errors);
+
+	void note_score(long long frame, const int *digits, int num_digits);
+	bool write_frame(const unsigned char *rgb,
+	                 int width,
+	                 int height,
+	                 long long frame,
+	                 std::string& errors);
+	bool finish(std::string& errors);
+
+private:
+	// Scores of frames not yet written, which can be behind the readback
+	static const int SCORE_HISTORY = 16;
+
+	std::string name;
+	shm_ring_header *header;
+	size_t size;
+	int num_digits;
+	long long score_frames[SCORE_HISTORY];
+	int scores[SCORE_HISTORY][SHM_RING_MAX_DIGITS];
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "line_transform.h"
+#include "score.h"
+#include "sim_clock.h"
+
+static const double STEP_SECONDS = 1.0 / SIM_FRAMES_PER_SECOND;
+
+void
+init_sim_clock(sim_clock& clock)
+{
+	clock.frame = 0;
+	clock.lag = 0.0;
+	clock.dropped_frames = 0;
+}
+
+int
+advance_sim_clock(sim_clock& clock, double seconds)
+{
+	clock.lag += seconds;
+	int steps = 0;
+	while (clock.lag >= STEP_SECONDS && steps < SIM_MAX_STEPS) {
+		clock.lag -= STEP_SECONDS;
+		++clock.frame;
+		++steps;
+	}
+	if (clock.lag >= STEP_SECONDS) {
+		const long long dropped = (long long)(clock.lag / STEP_SECONDS);
+		clock.dropped_frames += dropped;
+		clock.lag -= dropped * STEP_SECONDS;
+	}
+	return steps;
+}
+
+float
+sim_clock_fraction(const sim_clock& clock)
+{
+	return (float)(clock.lag / STEP_SECONDS);
+}
+
+float
+sim_clock_animation_frame(const sim_clock& clock)
+{
+	return (float)(clock.frame % ANIMATION_PERIOD) + sim_clock_fraction(clock);
+}
+
+void
+step_score(int *digits, long long frame, bool auto_increment)
+{
+	if (auto_increment && frame && frame % INCREMENT_FRAMES == 0)
+		advance_score(digits, 1);
+}
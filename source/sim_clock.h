@@ -0,0 +1,44 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+// The animation moves on in fixed steps of simulated time, one animation
+// frame each, however fast frames are drawn. Drawing can fall between two
+// steps, and the shaders take the fraction.
+
+const int SIM_FRAMES_PER_SECOND = 60;
+// Most steps taken to catch up at once. Past that a stall is dropped, so a
+// slow frame can't make the next one slower still.
+const int SIM_MAX_STEPS = 8;
+// The viewer counts up every this many frames
+const int INCREMENT_FRAMES = 30;
+
+struct sim_clock {
+	long long frame;			// steps taken, the animation frame
+	double lag;					// real time not yet stepped, in seconds
+	long long dropped_frames;	// steps dropped after stalls
+};
+
+void
+init_sim_clock(sim_clock& clock);
+
+// Let "seconds" of real time pass, stepping the clock on for each whole
+// step that's due. Returns how many steps were taken.
+int
+advance_sim_clock(sim_clock& clock, double seconds);
+
+// How far from the last step to the next, from 0 to 1
+float
+sim_clock_fraction(const sim_clock& clock);
+
+// The frame to draw: the last step plus the fraction, within the
+// animation's period so it stays exact as a float
+float
+sim_clock_animation_frame(const sim_clock& clock);
+
+// Take the score on to "frame" from the frame before, counting up every
+// INCREMENT_FRAMES if "auto_increment". Stepping frame by frame this way
+// gives the same scores whether frames are drawn in real time or offline.
+void
+step_score(int *digits, long long frame, bool auto_increment);
+
+#endif
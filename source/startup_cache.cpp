@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include "startup_cache.h"
+
+// Written before every cache file's contents
+struct cache_header {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint64_t size;
+	uint64_t checksum;
+};
+
+static const char CACHE_MAGIC[4] = {'v', 'r', 'v', 'c'};
+// Bump to drop every file written by older builds
+static const uint32_t CACHE_VERSION = 1;
+
+static bool cache_dir_chosen = false;
+static std::string cache_dir;
+
+uint64_t
+hash_bytes(const void *data, size_t size, uint64_t hash)
+{
+	const unsigned char *bytes = (const unsigned char*)data;
+	for (size_t i = 0 ; i < size ; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+std::string
+default_cache_dir()
+{
+	const char *dir = getenv("VRVIZ_CACHE_DIR");
+	if (dir)
+		return dir;
+#ifdef _WIN32
+	dir = getenv("LOCALAPPDATA");
+	if (dir && *dir)
+		return std::string(dir) + "\\vrviz";
+#else
+	dir = getenv("XDG_CACHE_HOME");
+	if (dir && *dir)
+		return std::string(dir) + "/vrviz";
+	dir = getenv("HOME");
+	if (dir && *dir)
+		return std::string(dir) + "/.cache/vrviz";
+#endif
+	return "";
+}
+
+void
+set_cache_dir(const std::string& dir)
+{
+	cache_dir = dir;
+	cache_dir_chosen = true;
+}
+
+static const std::string&
+get_cache_dir()
+{
+	if (!cache_dir_chosen)
+		set_cache_dir(default_cache_dir());
+	return cache_dir;
+}
+
+static void
+make_dir(const std::string& path)
+{
+#ifdef _WIN32
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), 0777);
+#endif
+}
+
+// Make "dir" and any directories above it that aren't there yet
+static void
+make_dirs(const std::string& dir)
+{
+	for (size_t i = 1 ; i < dir.size() ; ++i)
+		if (dir[i] == '/' || dir[i] == '\\')
+			make_dir(dir.substr(0, i));
+	make_dir(dir);
+}
+
+bool
+read_cache_file(const char *name, uint64_t key,
+				std::vector<unsigned char>& bytes)
+{
+	const std::string& dir = get_cache_dir();
+	if (dir.empty())
+		return false;
+	FILE *in = fopen((dir + "/" + name).c_str(), "rb");
+	if (!in)
+		return false;
+	// The header's size is only believed if the file really is that long,
+	// so a damaged one can't ask for more memory than it holds
+	long file_size = -1;
+	if (!fseek(in, 0, SEEK_END))
+		file_size = ftell(in);
+	rewind(in);
+	cache_header header;
+	bool good = file_size >= (long)sizeof(header) &&
+		fread(&header, sizeof(header), 1, in) == 1 &&
+		!memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) &&
+		header.version == CACHE_VERSION && header.key == key &&
+		header.size == (uint64_t)file_size - sizeof(header);
+	if (good) {
+		bytes.resize((size_t)header.size);
+		good = fread(bytes.data(), 1, bytes.size(), in) == bytes.size() &&
+			getc(in) == EOF &&
+			hash_bytes(bytes.data(), bytes.size(), HASH_START) ==
+				header.checksum;
+	}
+	fclose(in);
+	return good;
+}
+
+void
+write_cache_file(const char *name, uint64_t key,
+				 const void *data, size_t size)
+{
+	const std::string& dir = get_cache_dir();
+	if (dir.empty())
+		return;
+	make_dirs(dir);
+	const std::string path = dir + "/" + name;
+	// Two starts at once can write the same file; the loser's rename just
+	// replaces it with the same thing, and a mix fails the checksum
+	const std::string temporary = path + ".tmp";
+	FILE *out = fopen(temporary.c_str(), "wb");
+	if (!out)
+		return;
+	cache_header header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.size = size;
+	header.checksum = hash_bytes(data, size, HASH_START);
+	const bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+		fwrite(data, 1, size, out) == size;
+	if (fclose(out) || !written) {
+		remove(temporary.c_str());
+		return;
+	}
+#ifdef _WIN32
+	// Windows won't rename over a file that's there
+	remove(path.c_str());
+#endif
+	if (rename(temporary.c_str(), path.c_str()))
+		remove(temporary.c_str());
+}
@@ -0,0 +1,46 @@
+#ifndef STARTUP_CACHE_H
+#define STARTUP_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Files kept between runs so later starts can skip work, like decoding the
+// font or compiling shaders. Each is written under a key hashed from
+// whatever it was made from, and only read back if the key and a checksum
+// of its contents still match, so a stale or damaged file is just made
+// again. Failing to read or write one only makes a start slower, so nothing
+// here is reported as an error.
+
+// Start of a 64-bit FNV-1a hash
+const uint64_t HASH_START = 14695981039346656037ULL;
+
+// Carry on hashing "hash" over "size" bytes
+uint64_t
+hash_bytes(const void *data, size_t size, uint64_t hash);
+
+// Where the cache is kept by default: $VRVIZ_CACHE_DIR if it's set, else
+// vrviz under $XDG_CACHE_HOME or ~/.cache (%LOCALAPPDATA% on Windows).
+// Empty if there's nowhere.
+std::string
+default_cache_dir();
+
+// Keep the cache in "dir" instead, or nowhere if it's empty
+void
+set_cache_dir(const std::string& dir);
+
+// Read cache file "name" into "bytes" if it was written with "key".
+// Returns false if there's no such file or it doesn't check out.
+bool
+read_cache_file(const char *name, uint64_t key,
+                std::vector<unsigned char>& bytes);
+
+// Write "size" bytes to cache file "name" with "key", making the cache's
+// directory if need be. The file is replaced whole, so a reader never sees
+// it half written.
+void
+write_cache_file(const char *name, uint64_t key,
+                 const void *data, size_t size);
+
+#endif
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "line_transform.h"
+#include "score.h"
+#include "sim_clock.h"
+#include "svg.h"
+
+// Frames transformed at once, which fixes the memory used
+static const int RUN_FRAMES = 240;
+static const size_t BUFFER_SIZE = 1 << 16;
+// Longest single piece of text put at once
+static const size_t MAX_PUT = 256;
+
+// Text going to a file through a fixed buffer, so nothing is allocated
+// however much is written
+struct svg_writer {
+	FILE *out;
+	char buffer[BUFFER_SIZE];
+	size_t used;
+	long long bytes;
+	bool failed;
+};
+
+static void
+flush_writer(svg_writer& writer)
+{
+	if (writer.used && fwrite(writer.buffer, 1, writer.used, writer.out) !=
+		writer.used)
+		writer.failed = true;
+	writer.bytes += writer.used;
+	writer.used = 0;
+}
+
+static inline char*
+reserve(svg_writer& writer, size_t size)
+{
+	if (writer.used + size > BUFFER_SIZE)
+		flush_writer(writer);
+	return writer.buffer + writer.used;
+}
+
+static void
+put(svg_writer& writer, const char *text)
+{
+	const size_t size = strlen(text);
+	memcpy(reserve(writer, size), text, size);
+	writer.used += size;
+}
+
+static void
+put_format(svg_writer& writer, const char *format, ...)
+{
+	char *to = reserve(writer, MAX_PUT);
+	va_list args;
+	va_start(args, format);
+	const int size = vsnprintf(to, MAX_PUT, format, args);
+	va_end(args);
+	writer.used += std::min((size_t)std::max(size, 0), MAX_PUT - 1);
+}
+
+// Write "value" to a tenth of a pixel, without a trailing ".0"
+static inline char*
+format_tenths(char *to, float value)
+{
+	int tenths = (int)lrintf(value * 10.f);
+	if (tenths < 0) {
+		*to++ = '-';
+		tenths = -tenths;
+	}
+	char digits[12];
+	int count = 0;
+	int whole = tenths / 10;
+	do {
+		digits[count++] = (char)('0' + whole % 10);
+		whole /= 10;
+	} while (whole);
+	while (count)
+		*to++ = digits[--count];
+	if (tenths % 10) {
+		*to++ = '.';
+		*to++ = (char)('0' + tenths % 10);
+	}
+	return to;
+}
+
+static void
+put_document_start(svg_writer& writer, int width, int height)
+{
+	put_format(writer, "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+		"width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n"
+		"<rect width=\"%d\" height=\"%d\"/>\n"
+		"<g fill=\"none\" stroke-width=\"1\" stroke-linecap=\"round\">\n",
+		width, height, width, height, width, height);
+}
+
+// One frame's lines, a path per digit, in pixels with y going down
+static void
+put_frame_lines(svg_writer& writer,
+				const shape_segments& shapes,
+				const score_segments& lines,
+				int run_frame,
+				const int *digits,
+				const char (*colors)[8],
+				int width,
+				int height)
+{
+	const float half_width = width * 0.5f;
+	const float half_height = height * 0.5f;
+	int segment = 0;
+	for (int i = 0 ; i < NUM_DIGITS ; ++i) {
+		put_format(writer, "<path stroke=\"%s\" d=\"", colors[digits[i]]);
+		const int count = shapes.segment_counts[digits[i]];
+		for (int j = 0 ; j < count ; ++j, ++segment) {
+			const int at = segment * lines.stride + run_frame;
+			char *to = reserve(writer, 64);
+			const char *start = to;
+			*to++ = 'M';
+			to = format_tenths(to, (lines.x0[at] + 1.f) * half_width);
+			*to++ = ' ';
+			to = format_tenths(to, (1.f - lines.y0[at]) * half_height);
+			*to++ = 'L';
+			to = format_tenths(to, (lines.x1[at] + 1.f) * half_width);
+			*to++ = ' ';
+			to = format_tenths(to, (1.f - lines.y1[at]) * half_height);
+			writer.used += to - start;
+		}
+		put(writer, "\"/>\n");
+	}
+}
+
+// Whether "pattern" holds exactly one frame number conversion, %d or %0Nd
+// with up to two digits of width, and nothing else for printf but %%, so
+// it's safe to hand to snprintf with the frame number
+static bool
+is_frame_pattern(const char *pattern)
+{
+	int conversions = 0;
+	for (const char *at = pattern ; (at = strchr(at, '%')) ; ) {
+		++at;
+		if (*at == '%') {
+			++at;
+			continue;
+		}
+		if (*at == '0')
+			++at;
+		for (int digits = 0 ; digits < 2 && *at >= '0' && *at <= '9' ;
+			++digits)
+			++at;
+		if (*at++ != 'd')
+			return false;
+		++conversions;
+	}
+	return conversions == 1;
+}
+
+bool
+export_svg(const svg_job& job,
+		   svg_stats& stats,
+		   std::string& errors)
+{
+	stats = svg_stats();
+	const auto start = std::chrono::steady_clock::now();
+	const bool per_frame = strchr(job.output, '%') != 0;
+	const bool to_stdout = !strcmp(job.output, "-");
+	if (per_frame && !is_frame_pattern(job.output)) {
+		errors.append(std::string("expected one %d or %05d like pattern for "
+			"the frame number in ") + job.output + " (%% for a %)\n");
+		return false;
+	}
+	svg_writer writer;
+	writer.out = 0;
+	writer.used = 0;
+	writer.bytes = 0;
+	writer.failed = false;
+	if (!per_frame) {
+		writer.out = to_stdout ? stdout : fopen(job.output, "wb");
+		if (!writer.out) {
+			errors.append(std::string("failed to open ") + job.output + "\n");
+			return false;
+		}
+		put_document_start(writer, job.width, job.height);
+	}
+
+	char colors[NUM_SHAPES][8];
+	for (int i = 0 ; i < NUM_SHAPES ; ++i) {
+		float rgb[3];
+		shape_color(i, rgb);
+		snprintf(colors[i], sizeof(colors[i]), "#%02x%02x%02x",
+			(int)(rgb[0] * 255.f + 0.5f), (int)(rgb[1] * 255.f + 0.5f),
+			(int)(rgb[2] * 255.f + 0.5f));
+	}
+	shape_segments shapes;
+	build_shape_segments(shapes);
+	score_segments lines;
+	const float aspect = (float)job.width / job.height;
+	// Frame times as fractions of the whole animation
+	const double duration = (double)job.num_frames / job.frames_per_second;
+	int digits[NUM_DIGITS];
+	memcpy(digits, job.digits, sizeof(digits));
+	// Runs end where the score changes, so each has a single score
+	const int run_frames = job.auto_increment ? INCREMENT_FRAMES : RUN_FRAMES;
+	for (long long run_start = 0 ; run_start < job.num_frames ;
+		run_start += run_frames) {
+		if (job.auto_increment && run_start)
+			advance_score(digits, 1);
+		const int num_frames = (int)std::min((long long)run_frames,
+			job.num_frames - run_start);
+		transform_score(shapes, digits, NUM_DIGITS,
+			(int)(run_start % ANIMATION_PERIOD), num_frames, aspect, lines);
+		for (int f = 0 ; f < num_frames ; ++f) {
+			const long long frame = run_start + f;
+			if (per_frame) {
+				char name[1024];
+				snprintf(name, sizeof(name), job.output, (int)frame);
+				writer.out = fopen(name, "wb");
+				if (!writer.out) {
+					errors.append(std::string("failed to open ") + name +
+						": " + strerror(errno) + "\n");
+					return false;
+				}
+				put_document_start(writer, job.width, job.height);
+				put(writer, "<g>\n");
+			}
+			else if (frame == 0) {
+				put_format(writer, "<g display=\"none\"><animate "
+					"attributeName=\"display\" values=\"inline;none\" "
+					"keyTimes=\"0;%.9f\" dur=\"%.6fs\" calcMode=\"discrete\" "
+					"repeatCount=\"indefinite\"/>\n", 1.0 / job.num_frames,
+					duration);
+			}
+			else {
+				put_format(writer, "<g display=\"none\"><animate "
+					"attributeName=\"display\" values=\"none;inline;none\" "
+					"keyTimes=\"0;%.9f;%.9f\" dur=\"%.6fs\" "
+					"calcMode=\"discrete\" repeatCount=\"indefinite\"/>\n",
+					(double)frame / job.num_frames,
+					(double)(frame + 1) / job.num_frames, duration);
+			}
+			put_frame_lines(writer, shapes, lines, f, digits, colors,
+				job.width, job.height);
+			put(writer, "</g>\n");
+			stats.segments += lines.num_segments;
+			++stats.frames;
+			if (per_frame) {
+				put(writer, "</g>\n</svg>\n");
+				flush_writer(writer);
+				if (fclose(writer.out))
+					writer.failed = true;
+			}
+			if (writer.failed) {
+				errors.append(std::string("failed to write SVG: ") +
+					strerror(errno) + "\n");
+				if (!per_frame && !to_stdout)
+					fclose(writer.out);
+				return false;
+			}
+		}
+	}
+	if (!per_frame) {
+		put(writer, "</g>\n</svg>\n");
+		flush_writer(writer);
+		if ((to_stdout ? fflush(writer.out) : fclose(writer.out)) ||
+			writer.failed) {
+			errors.append(std::string("failed to write SVG: ") +
+				strerror(errno) + "\n");
+			return false;
+		}
+	}
+	stats.bytes = writer.bytes;
+	stats.seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	return true;
+}
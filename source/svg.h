@@ -0,0 +1,38 @@
+#ifndef SVG_H
+#define SVG_H
+
+#include <string>
+
+#include "shapes.h"
+
+// What to export as vector graphics
+struct svg_job {
+	int digits[NUM_DIGITS];		// score at frame 0
+	bool auto_increment;		// count up every 30 frames like the viewer
+	long long num_frames;
+	int width;					// size frames are drawn at, in pixels
+	int height;
+	int frames_per_second;		// for the animation
+	// A file name with one %d or %0Nd pattern like "frame%05d.svg" for an
+	// SVG per frame (%% for a %), otherwise one animated SVG, "-" for stdout
+	const char *output;
+};
+
+struct svg_stats {
+	long long frames;
+	long long segments;
+	long long bytes;
+	double seconds;
+};
+
+// Write every frame of "job" as lines transformed on the CPU like
+// line.vert does it, a run of frames at a time. The animated SVG shows
+// each frame's group in turn. Text goes through one fixed buffer, so
+// memory stays the same however many frames there are. Returns false and
+// gives error messages in "errors" if the output couldn't be written.
+bool
+export_svg(const svg_job& job,
+           svg_stats& stats,
+           std::string& errors);
+
+#endif
@@ -0,0 +1,85 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+thread_pool::thread_pool(int num_threads)
+	: current_job(0), job_count(0), next_index(0), generation(0),
+	  busy_workers(0), stopping(false)
+{
+	if (num_threads <= 0)
+		num_threads = std::max((int)std::thread::hardware_concurrency(), 1);
+	// The calling thread does its share too, so start one less
+	for (int i = 1 ; i < num_threads ; ++i)
+		workers.push_back(std::thread(&thread_pool::worker_loop, this));
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	start_cv.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void
+thread_pool::parallel_for(int count, const std::function<void(int)>& job)
+{
+	if (count <= 0)
+		return;
+	if (workers.empty() || count == 1) {
+		for (int i = 0 ; i < count ; ++i)
+			job(i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		current_job = &job;
+		job_count = count;
+		next_index = 0;
+		busy_workers = (int)workers.size();
+		++generation;
+	}
+	start_cv.notify_all();
+	run_jobs(job, count);
+	// Every worker has to check in, so none of them is still looking at
+	// this job when the next one starts
+	std::unique_lock<std::mutex> lock(mutex);
+	done_cv.wait(lock, [this]{ return busy_workers == 0; });
+	current_job = 0;
+}
+
+void
+thread_pool::worker_loop()
+{
+	unsigned seen_generation = 0;
+	for (;;) {
+		const std::function<void(int)> *job;
+		int count;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			start_cv.wait(lock, [&]{
+				return stopping || generation != seen_generation; });
+			if (stopping)
+				return;
+			seen_generation = generation;
+			job = current_job;
+			count = job_count;
+		}
+		run_jobs(*job, count);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busy_workers == 0)
+				done_cv.notify_one();
+		}
+	}
+}
+
+void
+thread_pool::run_jobs(const std::function<void(int)>& job, int count)
+{
+	for (int i = next_index++ ; i < count ; i = next_index++)
+		job(i);
+}
@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for splitting work into independent jobs.
+// Only one thread should hand work to a pool at a time.
+class thread_pool {
+public:
+	// Use "num_threads" threads in total (including the one calling
+	// parallel_for), or one per hardware thread if it's 0
+	explicit thread_pool(int num_threads = 0);
+	~thread_pool();
+
+	// Number of threads jobs are spread across
+	int size() const { return (int)workers.size() + 1; }
+
+	// Call job(i) for every i in [0, count) across the pool's threads, and
+	// return once they've all finished
+	void parallel_for(int count, const std::function<void(int)>& job);
+
+private:
+	void worker_loop();
+	void run_jobs(const std::function<void(int)>& job, int count);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+	const std::function<void(int)> *current_job;
+	int job_count;
+	std::atomic<int> next_index;
+	unsigned generation;
+	int busy_workers;
+	bool stopping;
+};
+
+#endif
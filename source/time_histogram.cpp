@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "time_histogram.h"
+
+// Longest time counted, in us; anything longer goes in the last bucket
+static const uint32_t MAX_MICROSECONDS = 0x7fffffff;
+
+static int
+bucket_index(uint32_t microseconds)
+{
+	if (microseconds < (uint32_t)HISTOGRAM_SUB_BUCKETS)
+		return (int)microseconds;
+	int top_bit = 31;
+	while (!(microseconds >> top_bit))
+		--top_bit;
+	const int shift = top_bit - HISTOGRAM_SUB_BITS;
+	return HISTOGRAM_SUB_BUCKETS * (shift + 1) +
+		(int)(microseconds >> shift) - HISTOGRAM_SUB_BUCKETS;
+}
+
+// Shortest time in bucket "index", in us
+static double
+bucket_start(int index)
+{
+	if (index < HISTOGRAM_SUB_BUCKETS)
+		return index;
+	const int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+	return (double)((uint64_t)(HISTOGRAM_SUB_BUCKETS +
+		index % HISTOGRAM_SUB_BUCKETS) << shift);
+}
+
+static double
+bucket_end(int index)
+{
+	return index + 1 < HISTOGRAM_BUCKETS ? bucket_start(index + 1) :
+		(double)MAX_MICROSECONDS + 1;
+}
+
+void
+init_time_histogram(time_histogram& histogram, const char *name)
+{
+	memset(&histogram, 0, sizeof(histogram));
+	histogram.name = name;
+}
+
+void
+add_time(time_histogram& histogram, double seconds)
+{
+	const double microseconds = std::min(std::max(seconds * 1e6, 0.0),
+		(double)MAX_MICROSECONDS);
+	const int index = bucket_index((uint32_t)microseconds);
+	const float ms = (float)(microseconds * 1e-3);
+	if (histogram.window_size == HISTOGRAM_WINDOW)
+		--histogram.window_counts[histogram.recent_buckets[histogram.next]];
+	else
+		++histogram.window_size;
+	++histogram.window_counts[index];
+	++histogram.run_counts[index];
+	++histogram.run_size;
+	histogram.run_max = std::max(histogram.run_max, ms);
+	histogram.recent[histogram.next] = ms;
+	histogram.recent_buckets[histogram.next] = (uint16_t)index;
+	histogram.next = (histogram.next + 1) % HISTOGRAM_WINDOW;
+}
+
+void
+add_lap(time_histogram& histogram,
+		std::chrono::steady_clock::time_point& since)
+{
+	const auto now = std::chrono::steady_clock::now();
+	add_time(histogram, std::chrono::duration<double>(now - since).count());
+	since = now;
+}
+
+// The top of the bucket where "percentile" of "total" counts is reached, in
+// ms, but no more than "max"
+template <typename count>
+static float
+percentile_of(const count *counts,
+			  long long total,
+			  double percentile,
+			  float max)
+{
+	if (!total)
+		return 0.f;
+	// The rank of the sample wanted, counting from 1
+	const long long rank = std::max(1LL,
+		(long long)(percentile / 100.0 * total + 0.999999));
+	long long seen = 0;
+	for (int i = 0 ; i < HISTOGRAM_BUCKETS ; ++i) {
+		seen += counts[i];
+		if (seen >= rank)
+			return std::min((float)(bucket_end(i) * 1e-3), max);
+	}
+	return max;
+}
+
+float
+window_percentile(const time_histogram& histogram, double percentile)
+{
+	return percentile_of(histogram.window_counts, histogram.window_size,
+		percentile, window_max(histogram));
+}
+
+float
+window_max(const time_histogram& histogram)
+{
+	float max = 0.f;
+	for (int i = 0 ; i < histogram.window_size ; ++i)
+		max = std::max(max, histogram.recent[i]);
+	return max;
+}
+
+bool
+write_time_histograms(const char *path,
+					  const time_histogram *histograms,
+					  int count,
+					  std::string& errors)
+{
+	FILE *out = fopen(path, "w");
+	if (!out) {
+		errors.append(std::string("failed to open ") + path + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	for (int h = 0 ; h < count ; ++h) {
+		const time_histogram& histogram = histograms[h];
+		fprintf(out, "# %s: %lld samples, p50 %.3f ms, p90 %.3f ms, "
+			"p95 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n",
+			histogram.name, histogram.run_size,
+			percentile_of(histogram.run_counts, histogram.run_size, 50.0,
+				histogram.run_max),
+			percentile_of(histogram.run_counts, histogram.run_size, 90.0,
+				histogram.run_max),
+			percentile_of(histogram.run_counts, histogram.run_size, 95.0,
+				histogram.run_max),
+			percentile_of(histogram.run_counts, histogram.run_size, 99.0,
+				histogram.run_max),
+			percentile_of(histogram.run_counts, histogram.run_size, 99.9,
+				histogram.run_max),
+			histogram.run_max);
+		// Name, bucket from and to in ms, count in it
+		for (int i = 0 ; i < HISTOGRAM_BUCKETS ; ++i)
+			if (histogram.run_counts[i])
+				fprintf(out, "%s\t%.3f\t%.3f\t%llu\n", histogram.name,
+					bucket_start(i) * 1e-3, bucket_end(i) * 1e-3,
+					(unsigned long long)histogram.run_counts[i]);
+	}
+	if (fclose(out)) {
+		errors.append(std::string("failed to write ") + path + ": " +
+			strerror(errno) + "\n");
+		return false;
+	}
+	return true;
+}
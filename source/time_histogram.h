@@ -0,0 +1,63 @@
+#ifndef TIME_HISTOGRAM_H
+#define TIME_HISTOGRAM_H
+
+#include <chrono>
+#include <stdint.h>
+#include <string>
+
+// Times are counted in buckets to the microsecond up to 32 us, then 32
+// buckets to each doubling, so any time is within about 3% of its
+// bucket's, from 1 us to over half an hour, in a fixed few kilobytes.
+const int HISTOGRAM_SUB_BITS = 5;
+const int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+const int HISTOGRAM_BUCKETS = HISTOGRAM_SUB_BUCKETS * (32 - HISTOGRAM_SUB_BITS);
+// Frames the sliding window covers, 10 seconds at 60 a second
+const int HISTOGRAM_WINDOW = 600;
+
+// Counts of one kind of time both over the last HISTOGRAM_WINDOW samples,
+// which come out again as they drop out of the window, and over the whole
+// run
+struct time_histogram {
+	const char *name;
+	uint32_t window_counts[HISTOGRAM_BUCKETS];
+	uint64_t run_counts[HISTOGRAM_BUCKETS];
+	float recent[HISTOGRAM_WINDOW];		// in ms, oldest at "next" once full
+	uint16_t recent_buckets[HISTOGRAM_WINDOW];
+	int next;
+	int window_size;
+	long long run_size;
+	float run_max;						// in ms
+};
+
+void
+init_time_histogram(time_histogram& histogram, const char *name);
+
+// Count a time of "seconds"
+void
+add_time(time_histogram& histogram, double seconds);
+
+// Count the time since "since", and move "since" on to now, to time one
+// phase after another
+void
+add_lap(time_histogram& histogram,
+        std::chrono::steady_clock::time_point& since);
+
+// The time "percentile" percent of the window's samples are at or under,
+// in ms, to the top of its bucket. 0 if there are none.
+float
+window_percentile(const time_histogram& histogram, double percentile);
+
+// The longest time in the window, in ms
+float
+window_max(const time_histogram& histogram);
+
+// Write each histogram's whole run as a line of percentiles, then a line
+// per bucket with anything in it. Returns false and gives error messages
+// in "errors" if it couldn't be written.
+bool
+write_time_histograms(const char *path,
+                      const time_histogram *histograms,
+                      int count,
+                      std::string& errors);
+
+#endif
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "decoder.h"
+#include "timeline.h"
+
+// Frames are decoded at the size the renderer makes them
+static const int DECODE_WIDTH = 300;
+static const int DECODE_HEIGHT = 150;
+// Frames that can be in flight at once, which fixes the memory used
+static const int POOL_SIZE = 16;
+static const int QUEUE_SIZE = 4;
+// A new score has to be seen in this many frames in a row before it counts,
+// so a single bad decode doesn't show up as two changes
+static const int STABLE_FRAMES = 3;
+// Decodes less sure than this are treated as not finding a score
+static const float MIN_CONFIDENCE = 0.5f;
+
+enum chroma_format {
+	CHROMA_420,
+	CHROMA_444,
+	CHROMA_MONO,
+};
+
+struct capture_info {
+	capture_format format;
+	chroma_format chroma;
+	int width;
+	int height;
+	size_t frame_size;
+};
+
+struct capture_frame {
+	long long index;
+	std::vector<unsigned char> raw;
+	std::vector<unsigned char> rgb;		// decode sized, bottom row first
+};
+
+struct decoded_frame {
+	long long index;
+	bool found;
+	decode_result result;
+};
+
+static bool
+read_line(FILE *in, std::string& line)
+{
+	line.clear();
+	for (int c = getc(in) ; c != '\n' ; c = getc(in)) {
+		if (c == EOF || line.size() > 1024)
+			return false;
+		line.push_back((char)c);
+	}
+	return true;
+}
+
+static bool
+read_y4m_header(FILE *in, capture_info& info, std::string& errors)
+{
+	std::string line;
+	if (!read_line(in, line) || line.compare(0, 9, "YUV4MPEG2")) {
+		errors.append("input isn't a y4m stream\n");
+		return false;
+	}
+	info.width = info.height = 0;
+	info.chroma = CHROMA_420;
+	size_t pos = 9;
+	while (pos < line.size()) {
+		while (pos < line.size() && line[pos] == ' ')
+			++pos;
+		const size_t end = std::min(line.find(' ', pos), line.size());
+		const std::string token = line.substr(pos, end - pos);
+		pos = end;
+		if (token.empty())
+			continue;
+		if (token[0] == 'W')
+			info.width = atoi(token.c_str() + 1);
+		else if (token[0] == 'H')
+			info.height = atoi(token.c_str() + 1);
+		else if (token[0] == 'C') {
+			if (!token.compare(1, 3, "420"))
+				info.chroma = CHROMA_420;
+			else if (token == "C444")
+				info.chroma = CHROMA_444;
+			else if (token == "Cmono")
+				info.chroma = CHROMA_MONO;
+			else {
+				errors.append("unsupported y4m colour space " + token + "\n");
+				return false;
+			}
+		}
+	}
+	if (info.width <= 0 || info.height <= 0) {
+		errors.append("y4m header has no frame size\n");
+		return false;
+	}
+	const size_t luma = (size_t)info.width * info.height;
+	const size_t chroma = info.chroma == CHROMA_420 ?
+		(size_t)((info.width + 1) / 2) * ((info.height + 1) / 2) :
+		info.chroma == CHROMA_444 ? luma : 0;
+	info.frame_size = luma + 2 * chroma;
+	return true;
+}
+
+static bool
+read_frame(FILE *in, const capture_info& info, capture_frame& frame)
+{
+	if (info.format == CAPTURE_Y4M) {
+		std::string line;
+		if (!read_line(in, line) || line.compare(0, 5, "FRAME"))
+			return false;
+	}
+	frame.raw.resize(info.frame_size);
+	return fread(&frame.raw[0], 1, info.frame_size, in) == info.frame_size;
+}
+
+static inline unsigned char
+clamp_byte(int value)
+{
+	return (unsigned char)std::min(std::max(value, 0), 255);
+}
+
+// Scale to the decode size (nearest neighbour), flip so the bottom row is
+// first and convert to RGB. Only the pixels that get used are converted.
+static void
+preprocess_frame(const capture_info& info,
+				 const std::vector<int>& src_x,
+				 const std::vector<int>& src_y,
+				 capture_frame& frame)
+{
+	frame.rgb.resize(DECODE_WIDTH * DECODE_HEIGHT * 3);
+	unsigned char *out = &frame.rgb[0];
+	const unsigned char *raw = &frame.raw[0];
+	const int w = info.width;
+	for (int y = 0 ; y < DECODE_HEIGHT ; ++y) {
+		const int sy = src_y[y];
+		if (info.format == CAPTURE_RGB) {
+			const unsigned char *row = raw + (size_t)sy * w * 3;
+			for (int x = 0 ; x < DECODE_WIDTH ; ++x, out += 3)
+				memcpy(out, row + src_x[x] * 3, 3);
+			continue;
+		}
+		// BT.601 limited range, in 16.16 fixed point
+		const unsigned char *luma = raw + (size_t)sy * w;
+		const unsigned char *u_plane = 0;
+		const unsigned char *v_plane = 0;
+		int chroma_w = 0;
+		int chroma_y = 0;
+		int shift = 0;
+		if (info.chroma == CHROMA_420) {
+			chroma_w = (w + 1) / 2;
+			chroma_y = sy / 2;
+			shift = 1;
+			const size_t plane = (size_t)chroma_w * ((info.height + 1) / 2);
+			u_plane = raw + (size_t)w * info.height;
+			v_plane = u_plane + plane;
+		}
+		else if (info.chroma == CHROMA_444) {
+			chroma_w = w;
+			chroma_y = sy;
+			u_plane = raw + (size_t)w * info.height;
+			v_plane = u_plane + (size_t)w * info.height;
+		}
+		for (int x = 0 ; x < DECODE_WIDTH ; ++x, out += 3) {
+			const int sx = src_x[x];
+			const int c = 76309 * (luma[sx] - 16);
+			int u = 0, v = 0;
+			if (u_plane) {
+				const size_t i = (size_t)chroma_y * chroma_w + (sx >> shift);
+				u = u_plane[i] - 128;
+				v = v_plane[i] - 128;
+			}
+			out[0] = clamp_byte((c + 104597 * v + 32768) >> 16);
+			out[1] = clamp_byte((c - 25675 * u - 53279 * v + 32768) >> 16);
+			out[2] = clamp_byte((c + 132201 * u + 32768) >> 16);
+		}
+	}
+}
+
+bool
+run_timeline(FILE *in,
+			 capture_format format,
+			 int width,
+			 int height,
+			 FILE *out,
+			 timeline_stats& stats,
+			 std::string& errors)
+{
+	capture_info info;
+	info.format = format;
+	if (format == CAPTURE_Y4M) {
+		if (!read_y4m_header(in, info, errors))
+			return false;
+	}
+	else {
+		if (width <= 0 || height <= 0) {
+			errors.append("rgb captures need a frame size\n");
+			return false;
+		}
+		info.width = width;
+		info.height = height;
+		info.frame_size = (size_t)width * height * 3;
+	}
+	std::vector<int> src_x(DECODE_WIDTH);
+	std::vector<int> src_y(DECODE_HEIGHT);
+	for (int x = 0 ; x < DECODE_WIDTH ; ++x)
+		src_x[x] = (int)(((long long)x * 2 + 1) * info.width / (DECODE_WIDTH * 2));
+	for (int y = 0 ; y < DECODE_HEIGHT ; ++y)
+		src_y[y] = (int)(((long long)(DECODE_HEIGHT - 1 - y) * 2 + 1) *
+			info.height / (DECODE_HEIGHT * 2));
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<capture_frame> pool(POOL_SIZE);
+	bounded_queue<capture_frame*> free_frames(POOL_SIZE);
+	bounded_queue<capture_frame*> to_preprocess(QUEUE_SIZE);
+	bounded_queue<capture_frame*> to_decode(QUEUE_SIZE);
+	bounded_queue<decoded_frame> decoded(QUEUE_SIZE * 4);
+	for (capture_frame& frame : pool)
+		free_frames.push(&frame);
+
+	std::thread reader([&]{
+		capture_frame *frame;
+		for (long long index = 0 ; free_frames.pop(frame) ; ++index) {
+			frame->index = index;
+			if (!read_frame(in, info, *frame))
+				break;
+			to_preprocess.push(frame);
+		}
+		to_preprocess.close();
+	});
+	std::thread preprocessor([&]{
+		capture_frame *frame;
+		while (to_preprocess.pop(frame)) {
+			preprocess_frame(info, src_x, src_y, *frame);
+			to_decode.push(frame);
+		}
+		to_decode.close();
+	});
+	std::thread decode_thread([&]{
+		score_decoder decoder;
+		init_score_decoder(decoder, DECODE_WIDTH, DECODE_HEIGHT);
+		capture_frame *frame;
+		bool tracking = false;
+		int next_frame = 0;
+		while (to_decode.pop(frame)) {
+			decoded_frame d;
+			d.index = frame->index;
+			// While the animation is running smoothly, the next frame is a
+			// cheap check. Only search for it when that fails.
+			d.found = tracking &&
+				decode_score(decoder, &frame->rgb[0], next_frame, d.result) &&
+				d.result.confidence >= MIN_CONFIDENCE;
+			if (!d.found)
+				d.found = decode_score(decoder, &frame->rgb[0], -1, d.result) &&
+					d.result.confidence >= MIN_CONFIDENCE;
+			tracking = d.found;
+			next_frame = (d.result.frame + 1) % ANIMATION_PERIOD;
+			free_frames.push(frame);
+			decoded.push(d);
+		}
+		decoded.close();
+	});
+
+	// De-duplicate on this thread
+	stats.frames = stats.decoded = stats.events = 0;
+	int shown[NUM_DIGITS];
+	bool have_shown = false;
+	int candidate[NUM_DIGITS];
+	long long candidate_start = 0;
+	int candidate_count = 0;
+	decoded_frame d;
+	while (decoded.pop(d)) {
+		++stats.frames;
+		if (!d.found)
+			continue;
+		++stats.decoded;
+		if (candidate_count && !memcmp(candidate, d.result.digits,
+			sizeof(candidate)))
+			++candidate_count;
+		else {
+			memcpy(candidate, d.result.digits, sizeof(candidate));
+			candidate_start = d.index;
+			candidate_count = 1;
+		}
+		if (candidate_count == STABLE_FRAMES &&
+			(!have_shown || memcmp(shown, candidate, sizeof(shown)))) {
+			memcpy(shown, candidate, sizeof(shown));
+			have_shown = true;
+			++stats.events;
+			fprintf(out, "%lld ", candidate_start);
+			for (int i = 0 ; i < NUM_DIGITS ; ++i)
+				fputc('0' + shown[i], out);
+			fputc('\n', out);
+		}
+	}
+	reader.join();
+	preprocessor.join();
+	decode_thread.join();
+	fflush(out);
+	stats.seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	return true;
+}
@@ -0,0 +1,35 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdio.h>
+#include <string>
+
+enum capture_format {
+	CAPTURE_RGB,	// raw 8-bit RGB, top row first
+	CAPTURE_Y4M,	// YUV4MPEG2, 4:2:0, 4:4:4 or mono
+};
+
+struct timeline_stats {
+	long long frames;		// frames read
+	long long decoded;		// frames a score was found in
+	long long events;		// score changes written out
+	double seconds;
+};
+
+// Read a video capture from "in" and write a line "<frame> <digits>" to
+// "out" every time the score shown changes, where frames count from 0 and
+// digits are least significant first. Raw RGB captures are "width" by
+// "height"; y4m ones give their own size. Reading, converting, decoding and
+// de-duplicating each get their own thread, with a small fixed number of
+// frames in flight between them. Returns false and gives error messages in
+// "errors" if the capture couldn't be read.
+bool
+run_timeline(FILE *in,
+             capture_format format,
+             int width,
+             int height,
+             FILE *out,
+             timeline_stats& stats,
+             std::string& errors);
+
+#endif
@@ -0,0 +1,316 @@
+// glew
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+#include "shader.h"
+#include "ui_render.h"
+
+// Vertices per frame to start with; the Info window needs a few thousand
+static const int MIN_CAPACITY = 1 << 14;
+
+static double
+seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+static bool
+same_rect(const ImVec4& a, const ImVec4& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+static void
+set_scissor(const ImVec4& clip_rect, float height)
+{
+	glScissor((int)clip_rect.x, (int)(height - clip_rect.w),
+		(int)(clip_rect.z - clip_rect.x), (int)(clip_rect.w - clip_rect.y));
+}
+
+// Make a buffer for "capacity" vertices a frame, mapping the whole ring if
+// it's persistent. Returns false if it couldn't be mapped.
+static bool
+make_vertex_buffer(ui_renderer& renderer, int capacity)
+{
+	renderer.capacity = capacity;
+	glGenBuffers(1, &renderer.vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.vertex_buffer);
+	bool success = true;
+	if (renderer.persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+			GL_MAP_COHERENT_BIT;
+		const GLsizeiptr size = (GLsizeiptr)capacity * UI_RING_FRAMES *
+			sizeof(ImDrawVert);
+		glBufferStorage(GL_ARRAY_BUFFER, size, 0, flags);
+		renderer.mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0,
+			size, flags);
+		success = renderer.mapped != 0;
+	}
+	else {
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(ImDrawVert), 0,
+			GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return success;
+}
+
+static void
+delete_vertex_buffer(ui_renderer& renderer)
+{
+	// Everything still being drawn from it has to finish first
+	for (GLsync& fence : renderer.fences) {
+		if (!fence)
+			continue;
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+		glDeleteSync(fence);
+		fence = 0;
+	}
+	if (renderer.mapped) {
+		glBindBuffer(GL_ARRAY_BUFFER, renderer.vertex_buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		renderer.mapped = 0;
+	}
+	glDeleteBuffers(1, &renderer.vertex_buffer);
+	renderer.vertex_buffer = 0;
+}
+
+// Make room for "vertices" a frame, going back to orphaning if a bigger
+// persistent ring can't be mapped
+static void
+grow_vertex_buffer(ui_renderer& renderer, int vertices)
+{
+	int capacity = renderer.capacity;
+	while (capacity < vertices)
+		capacity *= 2;
+	delete_vertex_buffer(renderer);
+	if (!make_vertex_buffer(renderer, capacity)) {
+		delete_vertex_buffer(renderer);
+		renderer.persistent = false;
+		make_vertex_buffer(renderer, capacity);
+	}
+	renderer.ring_frame = 0;
+}
+
+bool
+init_ui_renderer(ui_renderer& renderer,
+				 GLuint font_texture,
+				 std::string& errors)
+{
+	if (!make_shader_program("ui.vert", "ui.frag", renderer.shader, errors))
+		return false;
+	renderer.scale_location = glGetUniformLocation(renderer.shader, "scale");
+	renderer.position_attribute = glGetAttribLocation(renderer.shader,
+		"position");
+	renderer.uv_attribute = glGetAttribLocation(renderer.shader, "uv");
+	renderer.color_attribute = glGetAttribLocation(renderer.shader, "color");
+	glUseProgram(renderer.shader);
+	glUniform1i(glGetUniformLocation(renderer.shader, "fontTexture"), 0);
+	glUseProgram(0);
+	renderer.font_texture = font_texture;
+	renderer.persistent = GLEW_ARB_buffer_storage && GLEW_ARB_sync;
+	renderer.mapped = 0;
+	renderer.ring_frame = 0;
+	std::fill(renderer.fences, renderer.fences + UI_RING_FRAMES, (GLsync)0);
+	renderer.stats = ui_render_stats();
+	if (!make_vertex_buffer(renderer, MIN_CAPACITY)) {
+		delete_vertex_buffer(renderer);
+		renderer.persistent = false;
+		make_vertex_buffer(renderer, MIN_CAPACITY);
+	}
+	return true;
+}
+
+void
+render_ui_lists(ui_renderer& renderer,
+				ImDrawList** const lists,
+				int count,
+				float width,
+				float height)
+{
+	const auto start = std::chrono::steady_clock::now();
+	ui_render_stats& stats = renderer.stats;
+	stats = ui_render_stats();
+	int total = 0;
+	for (int n = 0 ; n < count ; ++n)
+		total += (int)lists[n]->vtx_buffer.size();
+	if (!total)
+		return;
+	if (total > renderer.capacity)
+		grow_vertex_buffer(renderer, total);
+
+	// Copy every list's vertices in, one after another
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.vertex_buffer);
+	ImDrawVert *to;
+	int first_vertex = 0;
+	if (renderer.persistent) {
+		renderer.ring_frame = (renderer.ring_frame + 1) % UI_RING_FRAMES;
+		GLsync& fence = renderer.fences[renderer.ring_frame];
+		if (fence) {
+			const auto wait_start = std::chrono::steady_clock::now();
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+				1000000000ULL) == GL_TIMEOUT_EXPIRED)
+				;
+			glDeleteSync(fence);
+			fence = 0;
+			stats.wait_seconds = seconds_since(wait_start);
+		}
+		first_vertex = renderer.ring_frame * renderer.capacity;
+		to = (ImDrawVert*)renderer.mapped + first_vertex;
+	}
+	else {
+		// Orphan last frame's storage rather than wait for it
+		glBufferData(GL_ARRAY_BUFFER, renderer.capacity * sizeof(ImDrawVert),
+			0, GL_STREAM_DRAW);
+		to = (ImDrawVert*)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+		if (!to) {
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return;
+		}
+	}
+	for (int n = 0 ; n < count ; ++n) {
+		const ImVector<ImDrawVert>& vertices = lists[n]->vtx_buffer;
+		memcpy(to, vertices.begin(), vertices.size() * sizeof(ImDrawVert));
+		to += vertices.size();
+	}
+	if (!renderer.persistent)
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+
+	// Alpha blending, no culling or depth, clipped by scissor
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_SCISSOR_TEST);
+	glUseProgram(renderer.shader);
+	glUniform2f(renderer.scale_location, 2.f / width, -2.f / height);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, renderer.font_texture);
+	const GLsizei stride = sizeof(ImDrawVert);
+	glEnableVertexAttribArray(renderer.position_attribute);
+	glEnableVertexAttribArray(renderer.uv_attribute);
+	glEnableVertexAttribArray(renderer.color_attribute);
+	glVertexAttribPointer(renderer.position_attribute, 2, GL_FLOAT, GL_FALSE,
+		stride, (void*)0);
+	glVertexAttribPointer(renderer.uv_attribute, 2, GL_FLOAT, GL_FALSE,
+		stride, (void*)8);
+	glVertexAttribPointer(renderer.color_attribute, 4, GL_UNSIGNED_BYTE,
+		GL_TRUE, stride, (void*)16);
+
+	// Commands in a row with the same clip rectangle are one draw, even
+	// across lists, and the scissor is only set when it changes
+	ImVec4 scissor;
+	bool scissor_set = false;
+	ImVec4 run_clip;
+	int run_start = first_vertex;
+	int run_count = 0;
+	auto draw_run = [&]() {
+		if (!run_count)
+			return;
+		if (!scissor_set || !same_rect(scissor, run_clip)) {
+			set_scissor(run_clip, height);
+			scissor = run_clip;
+			scissor_set = true;
+			++stats.scissor_changes;
+		}
+		glDrawArrays(GL_TRIANGLES, run_start, run_count);
+		++stats.draw_calls;
+	};
+	int vertex = first_vertex;
+	for (int n = 0 ; n < count ; ++n) {
+		const ImDrawList *list = lists[n];
+		for (const ImDrawCmd *cmd = list->commands.begin() ;
+			cmd != list->commands.end() ; ++cmd) {
+			if (run_count && same_rect(cmd->clip_rect, run_clip)) {
+				run_count += cmd->vtx_count;
+			}
+			else {
+				draw_run();
+				run_clip = cmd->clip_rect;
+				run_start = vertex;
+				run_count = cmd->vtx_count;
+			}
+			vertex += cmd->vtx_count;
+		}
+	}
+	draw_run();
+
+	glDisableVertexAttribArray(renderer.position_attribute);
+	glDisableVertexAttribArray(renderer.uv_attribute);
+	glDisableVertexAttribArray(renderer.color_attribute);
+	glDisable(GL_SCISSOR_TEST);
+	glUseProgram(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (renderer.persistent)
+		renderer.fences[renderer.ring_frame] =
+			glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stats.vertices = total;
+	stats.seconds = seconds_since(start);
+}
+
+void
+render_ui_lists_fixed(ImDrawList** const lists,
+					  int count,
+					  float width,
+					  float height,
+					  GLuint font_texture,
+					  ui_render_stats& stats)
+{
+	const auto start = std::chrono::steady_clock::now();
+	stats = ui_render_stats();
+	if (count == 0)
+		return;
+
+	// Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled, vertex/texcoord/color pointers.
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_SCISSOR_TEST);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	// Setup texture
+	glBindTexture(GL_TEXTURE_2D, font_texture);
+	glEnable(GL_TEXTURE_2D);
+
+	// Setup orthographic projection matrix
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(0.0f, width, height, 0.0f, -1.0f, +1.0f);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+
+	// Render command lists
+	for (int n = 0; n < count; n++)
+	{
+		const ImDrawList* cmd_list = lists[n];
+		const unsigned char* vtx_buffer = (const unsigned char*)cmd_list->vtx_buffer.begin();
+		glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), (void*)(vtx_buffer));
+		glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), (void*)(vtx_buffer+8));
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImDrawVert), (void*)(vtx_buffer+16));
+
+		int vtx_offset = 0;
+		const ImDrawCmd* pcmd_end = cmd_list->commands.end();
+		for (const ImDrawCmd* pcmd = cmd_list->commands.begin(); pcmd != pcmd_end; pcmd++)
+		{
+			set_scissor(pcmd->clip_rect, height);
+			glDrawArrays(GL_TRIANGLES, vtx_offset, pcmd->vtx_count);
+			vtx_offset += pcmd->vtx_count;
+			++stats.draw_calls;
+			++stats.scissor_changes;
+		}
+		stats.vertices += vtx_offset;
+	}
+	glDisable(GL_SCISSOR_TEST);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	stats.seconds = seconds_since(start);
+}
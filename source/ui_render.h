@@ -0,0 +1,69 @@
+#ifndef UI_RENDER_H
+#define UI_RENDER_H
+
+#include <string>
+
+#include "imgui.h"
+
+// Frames of UI vertices the persistent ring holds, so the GPU can still be
+// reading the last ones while the next are written
+const int UI_RING_FRAMES = 3;
+
+// What drawing the UI cost, for the last frame
+struct ui_render_stats {
+	int draw_calls;
+	int scissor_changes;
+	int vertices;
+	double seconds;			// on the CPU, issuing it all
+	double wait_seconds;	// of that, waiting for a ring frame to come free
+};
+
+// Draws ImGui's lists with a small shader from one streamed vertex buffer.
+// Where GL has buffer storage the buffer is mapped once and written as a
+// ring of UI_RING_FRAMES frames, fenced so a frame isn't overwritten while
+// it's drawn. Otherwise the buffer is orphaned and mapped again each frame.
+// Either way every list is copied in with one pass, and commands sharing a
+// clip rectangle are drawn together.
+struct ui_renderer {
+	GLuint shader;
+	GLint scale_location;
+	GLint position_attribute;
+	GLint uv_attribute;
+	GLint color_attribute;
+	GLuint font_texture;
+	GLuint vertex_buffer;
+	int capacity;				// vertices per frame the buffer holds
+	bool persistent;
+	unsigned char *mapped;		// the whole ring, if persistent
+	int ring_frame;				// ring frame last written
+	GLsync fences[UI_RING_FRAMES];
+	ui_render_stats stats;
+};
+
+// Make the UI shader and vertex buffer, drawing with "font_texture". Only
+// call this after OpenGL has started. Returns false and gives error
+// messages in "errors" on failure.
+bool
+init_ui_renderer(ui_renderer& renderer,
+                 GLuint font_texture,
+                 std::string& errors);
+
+// Draw "count" lists to a "width" by "height" framebuffer
+void
+render_ui_lists(ui_renderer& renderer,
+                ImDrawList** const lists,
+                int count,
+                float width,
+                float height);
+
+// The way ImGui's example draws them: fixed function, from client memory,
+// a draw per command. Kept to compare against.
+void
+render_ui_lists_fixed(ImDrawList** const lists,
+                      int count,
+                      float width,
+                      float height,
+                      GLuint font_texture,
+                      ui_render_stats& stats);
+
+#endif
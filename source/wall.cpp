@@ -0,0 +1,222 @@
+// glew & glfw
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <math.h>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+
+#include "line_transform.h"
+#include "render.h"
+#include "shader.h"
+#include "shapes.h"
+#include "wall.h"
+
+// Spread phases by the golden ratio, so neighbouring scores are always well
+// out of step however many there are
+static int
+spread_phase(int index)
+{
+	const double golden = 0.6180339887498949;
+	const double fraction = fmod(index * golden, 1.0);
+	return (int)(fraction * ANIMATION_PERIOD);
+}
+
+bool
+read_score_list(FILE *in, score_list& scores, std::string& errors)
+{
+	char line[256];
+	int line_number = 0;
+	while (fgets(line, sizeof(line), in)) {
+		++line_number;
+		char *text = line;
+		while (*text == ' ' || *text == '\t')
+			++text;
+		if (*text == '#' || *text == '\n' || *text == '\r' || !*text)
+			continue;
+		int digits[NUM_DIGITS] = {};
+		int length = 0;
+		for ( ; text[length] >= '0' && text[length] <= '9' ; ++length) {
+			const int digit = text[length] - '0';
+			if (length >= NUM_DIGITS || digit >= NUM_SHAPES) {
+				errors.append("bad score on line " +
+					std::to_string(line_number) + "\n");
+				return false;
+			}
+			digits[length] = digit;
+		}
+		if (!length) {
+			errors.append("no score on line " + std::to_string(line_number) +
+				"\n");
+			return false;
+		}
+		char *end;
+		const long phase = strtol(text + length, &end, 10);
+		const int index = (int)scores.phases.size();
+		scores.digits.insert(scores.digits.end(), digits, digits + NUM_DIGITS);
+		scores.phases.push_back(end != text + length ?
+			(int)((phase % ANIMATION_PERIOD + ANIMATION_PERIOD) %
+				ANIMATION_PERIOD) : spread_phase(index));
+	}
+	if (ferror(in)) {
+		errors.append("failed to read scores\n");
+		return false;
+	}
+	return true;
+}
+
+void
+random_score_list(score_list& scores, int count, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	scores.digits.resize(count * NUM_DIGITS);
+	scores.phases.resize(count);
+	for (int i = 0 ; i < count ; ++i) {
+		for (int j = 0 ; j < NUM_DIGITS ; ++j)
+			scores.digits[i * NUM_DIGITS + j] = rng() % NUM_SHAPES;
+		scores.phases[i] = spread_phase(i);
+	}
+}
+
+bool
+init_score_wall(score_wall& wall,
+				int width,
+				int height,
+				float aspect,
+				std::string& errors)
+{
+	wall.width = width;
+	wall.height = height;
+	wall.aspect = aspect;
+	if (!make_shader_program("wall.vert", "score.frag", wall.shader, errors))
+		return false;
+	glUseProgram(wall.shader);
+	glUniform1f(GL_LOOKUP(glGetUniformLocation(wall.shader, "aspect")),
+		aspect);
+	glUseProgram(0);
+	wall.frame_location = GL_LOOKUP(glGetUniformLocation(wall.shader,
+		"frame"));
+	wall.cell_scale_location = GL_LOOKUP(glGetUniformLocation(wall.shader,
+		"cell_scale"));
+	wall.point_location = glGetAttribLocation(wall.shader, "point");
+	wall.glyph_location = glGetAttribLocation(wall.shader, "glyph");
+	wall.cell_location = glGetAttribLocation(wall.shader, "cell");
+	if (!create_render_target(width, height, wall.frame_buffer,
+		wall.rendered_texture, errors))
+		return false;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glGenBuffers(1, &wall.vertex_buffer);
+	wall.num_vertices = 0;
+	wall.num_scores = 0;
+	wall.columns = 0;
+	wall.rows = 0;
+	wall.use_points = false;
+	return true;
+}
+
+// Digits smaller than this across are drawn as points
+static const float MIN_GLYPH_PIXELS = 3.f;
+
+// What wall.vert gets for each end of each line
+struct wall_vertex {
+	GLfloat point[2];
+	GLfloat glyph[3];
+	GLfloat cell[2];
+};
+
+void
+set_wall_scores(score_wall& wall, const score_list& scores)
+{
+	const int count = (int)scores.phases.size();
+	const int slots = std::max(count, 1);
+	// Try every column count, keeping whichever gives the widest cells
+	int columns = 1;
+	float cell_width = 0.f;
+	for (int c = 1 ; c <= slots ; ++c) {
+		const int r = (slots + c - 1) / c;
+		const float width = std::min((float)wall.width / c,
+			wall.height * wall.aspect / r);
+		if (width > cell_width) {
+			cell_width = width;
+			columns = c;
+		}
+	}
+	const int rows = (slots + columns - 1) / columns;
+	const float cell_height = cell_width / wall.aspect;
+	const float left = (wall.width - columns * cell_width) / 2;
+	const float top = (wall.height - rows * cell_height) / 2;
+	wall.num_scores = count;
+	wall.columns = columns;
+	wall.rows = rows;
+	// Digits grow to 0.08 of their cell's width across, and once they're
+	// too small to make out their lines just cost time to rasterize
+	wall.use_points = cell_width * 0.08f < MIN_GLYPH_PIXELS;
+
+	// Every line of every digit, or one point per digit, scores in order
+	// from the top left
+	std::vector<wall_vertex> vertices;
+	for (int i = 0 ; i < count ; ++i) {
+		const float x = left + (i % columns + 0.5f) * cell_width;
+		const float y = top + (i / columns + 0.5f) * cell_height;
+		for (int j = 0 ; j < NUM_DIGITS ; ++j) {
+			const int digit = scores.digits[i * NUM_DIGITS + j];
+			const shape_geometry& shape = shapes[digit];
+			if (wall.use_points) {
+				const wall_vertex vertex = {
+					{0.f, 0.f},
+					{(GLfloat)j, (GLfloat)digit, (GLfloat)scores.phases[i]},
+					{x / wall.width * 2.f - 1.f, 1.f - y / wall.height * 2.f}};
+				vertices.push_back(vertex);
+				continue;
+			}
+			for (int k = 0 ; k < shape.num_indices ; ++k) {
+				const float *point = &shape.vertices[shape.indices[k] * 3];
+				const wall_vertex vertex = {
+					{point[0], point[1]},
+					{(GLfloat)j, (GLfloat)digit, (GLfloat)scores.phases[i]},
+					{x / wall.width * 2.f - 1.f, 1.f - y / wall.height * 2.f}};
+				vertices.push_back(vertex);
+			}
+		}
+	}
+	wall.num_vertices = (int)vertices.size();
+	glUseProgram(wall.shader);
+	glUniform2f(wall.cell_scale_location, cell_width / wall.width,
+		cell_height / wall.height);
+	glUseProgram(0);
+	glBindBuffer(GL_ARRAY_BUFFER, wall.vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(wall_vertex),
+		vertices.empty() ? 0 : &vertices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void
+render_wall(const score_wall& wall, float frame)
+{
+	GL_STATE(glBindFramebuffer(GL_FRAMEBUFFER, wall.frame_buffer));
+	GL_STATE(glViewport(0, 0, wall.width, wall.height));
+	GL_STATE(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
+	glClear(GL_COLOR_BUFFER_BIT);
+	GL_STATE(glUseProgram(wall.shader));
+	GL_STATE(glUniform1f(wall.frame_location, frame));
+	GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, wall.vertex_buffer));
+	const GLint locations[] = {
+		wall.point_location, wall.glyph_location, wall.cell_location};
+	const GLint sizes[] = {2, 3, 2};
+	const size_t offsets[] = {offsetof(wall_vertex, point),
+		offsetof(wall_vertex, glyph), offsetof(wall_vertex, cell)};
+	for (int i = 0 ; i < 3 ; ++i) {
+		GL_STATE(glEnableVertexAttribArray(locations[i]));
+		GL_STATE(glVertexAttribPointer(locations[i], sizes[i], GL_FLOAT,
+			GL_FALSE, sizeof(wall_vertex), (void*)offsets[i]));
+	}
+	GL_DRAW(glDrawArrays(wall.use_points ? GL_POINTS : GL_LINES, 0,
+		wall.num_vertices));
+	for (int i = 0 ; i < 3 ; ++i)
+		GL_STATE(glDisableVertexAttribArray(locations[i]));
+	GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	GL_STATE(glUseProgram(0));
+}
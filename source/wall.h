@@ -0,0 +1,71 @@
+#ifndef WALL_H
+#define WALL_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// A leaderboard of scores, each animating with its own phase offset.
+struct score_list {
+	std::vector<int> digits;	// NUM_DIGITS per score, least significant first
+	std::vector<int> phases;	// frames each score's animation is ahead by
+};
+
+// Read scores from "in", one per line as digits least significant first
+// (like --digits), each optionally followed by a phase in frames. Scores
+// without one get phases spread over the animation. Blank lines and lines
+// starting with # are skipped. Returns false and gives error messages in
+// "errors" on failure.
+bool
+read_score_list(FILE *in, score_list& scores, std::string& errors);
+
+// Fill "scores" with "count" random scores, with phases spread out
+void
+random_score_list(score_list& scores, int count, unsigned seed);
+
+// Draws a score_list as a grid into an offscreen texture. Every line of
+// every score goes into one static buffer when the list is set, so a frame
+// is one draw however many scores there are.
+struct score_wall {
+	int width;
+	int height;
+	float aspect;			// of one score's cell
+	GLuint frame_buffer;
+	GLuint rendered_texture;
+	GLuint shader;
+	GLint frame_location;
+	GLint cell_scale_location;
+	GLint point_location;
+	GLint glyph_location;
+	GLint cell_location;
+	GLuint vertex_buffer;
+	int num_vertices;
+	bool use_points;		// digits too small to see are drawn as points
+	int num_scores;
+	int columns;
+	int rows;
+};
+
+// Create the wall's shader, and its "width" by "height" framebuffer, with
+// cells "aspect" times as wide as they are high. Only call this after
+// OpenGL has started. Returns false and gives error messages in "errors" on
+// failure.
+bool
+init_score_wall(score_wall& wall,
+                int width,
+                int height,
+                float aspect,
+                std::string& errors);
+
+// Lay "scores" out in a grid, with the biggest cells that fit, and build
+// their lines, or just a point per digit if the cells are too small for
+// the lines to show. Only needed when the scores change.
+void
+set_wall_scores(score_wall& wall, const score_list& scores);
+
+// Render every score at animation frame "frame" plus its own phase into the
+// wall's texture. Leaves the wall's framebuffer bound.
+void
+render_wall(const score_wall& wall, float frame);
+
+#endif